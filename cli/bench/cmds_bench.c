@@ -0,0 +1,189 @@
+/**
+ * COPYRIGHT 2024 Flirc, Inc. All rights reserved.
+ *
+ * This copyright notice is Copyright Management Information under 17 USC 1202
+ * and is included to protect this work and deter copyright infringement.
+ * Removal or alteration of this Copyright Management Information without
+ * the express written permission of Flirc, Inc. is prohibited, and any
+ * such unauthorized removal or alteration will be a violation of federal law.
+ */
+
+/*
+ * cmds_bench.c - Measures command dispatch through the `script' command.
+ *
+ * A set of do-nothing commands, each taking a handful of options, is
+ * registered next to the real ones. A script of N lines calling them with
+ * short and long options is written to a temp file and run through
+ * `script', so the numbers include reading, tokenizing, lookup, option
+ * parsing and dictionary setup, but no device I/O.
+ *
+ * When linked with --wrap=malloc (everywhere but Darwin, see the target
+ * makefile) it also reports heap allocations made while the script runs.
+ *
+ * usage: cmds_bench [lines] [commands]
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <cmds.h>
+#include <logging.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define DEFAULT_LINES		(100000)
+#define DEFAULT_CMDS		(64)
+#define NAME_LEN		(16)
+
+static unsigned long calls;
+static unsigned long mallocs;
+
+#ifdef CMDS_BENCH_WRAP_MALLOC
+void *__real_malloc(size_t size);
+
+void *__wrap_malloc(size_t size)
+{
+	mallocs++;
+	return __real_malloc(size);
+}
+#endif /* CMDS_BENCH_WRAP_MALLOC */
+
+CMDHANDLER(nop_handler)
+{
+	calls++;
+	return argc;
+}
+
+START_CMD_OPTS(nop_opts)
+	CMD_OPT(alpha,   'a', "alpha",   "first option")
+	CMD_OPT(bravo,   'b', "bravo",   "second option")
+	CMD_OPT(charlie, 'c', "charlie", "third option")
+	CMD_OPT(delta,   'd', "delta",   "fourth option")
+	CMD_OPT(echo,    'e', "echo",    "fifth option")
+	CMD_OPT(repeat,  'r', "repeat",  "number of repeats")
+END_CMD_OPTS;
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int register_nops(unsigned int n)
+{
+	struct cmd_mgr *mgr;
+	struct cmd *c;
+	char *names;
+	unsigned int i;
+
+	mgr = calloc(n, sizeof(*mgr));
+	c = calloc(n, sizeof(*c));
+	names = calloc(n, NAME_LEN);
+	if(!mgr || !c || !names)
+		return -1;
+
+	for(i = 0; i < n; i++) {
+		snprintf(&names[i * NAME_LEN], NAME_LEN, "nop%04u", i);
+		c[i].name = &names[i * NAME_LEN];
+		c[i].handler = &nop_handler;
+		c[i].summary = "does nothing";
+		c[i].help = "usage: nopNNNN [opts] [args]";
+		c[i].options = nop_opts;
+		mgr[i].cmd = &c[i];
+		_register_cmd(&mgr[i]);
+	}
+
+	return 0;
+}
+
+static int write_script(const char *path, unsigned long lines,
+		unsigned int ncmds)
+{
+	static const char * const fmt[] = {
+		"nop%04u\n",
+		"nop%04u -ab --repeat=4 arg\n",
+		"nop%04u --alpha --charlie=3 -r 2 one two three\n",
+		"# comment line for nop%04u\n",
+		"nop%04u -e --delta=\"quoted value\" --bravo\n",
+	};
+	unsigned long i;
+	FILE *fp;
+
+	if((fp = fopen(path, "w")) == NULL)
+		return -1;
+
+	for(i = 0; i < lines; i++) {
+		fprintf(fp, fmt[i % ARRAY_SIZE(fmt)],
+				(unsigned int)((i * 2654435761u) % ncmds));
+	}
+
+	return fclose(fp);
+}
+
+int main(int argc, const char *argv[])
+{
+	unsigned long lines = DEFAULT_LINES;
+	unsigned int ncmds = DEFAULT_CMDS;
+	char path[] = "/tmp/cmds_benchXXXXXX";
+	const char *args[] = { "script", path };
+	unsigned long m0;
+	double t0, t1;
+	int fd, ret;
+
+	if(argc > 1)
+		lines = strtoul(argv[1], NULL, 0);
+	if(argc > 2)
+		ncmds = strtoul(argv[2], NULL, 0);
+	if(!lines || !ncmds) {
+		fprintf(stderr, "usage: cmds_bench [lines] [commands]\n");
+		return 1;
+	}
+
+	set_log_level(LOGLEVEL_ERROR);
+
+	if(register_nops(ncmds) < 0) {
+		fprintf(stderr, "could not register commands\n");
+		return 1;
+	}
+
+	if((fd = mkstemp(path)) < 0) {
+		perror("could not create script");
+		return 1;
+	}
+	close(fd);
+
+	if(write_script(path, lines, ncmds) != 0) {
+		perror("could not write script");
+		remove(path);
+		return 1;
+	}
+
+	m0 = mallocs;
+	t0 = now();
+	ret = run_cmds(ARRAY_SIZE(args), args, NULL);
+	t1 = now();
+	m0 = mallocs - m0;
+
+	remove(path);
+
+	if(ret != 0) {
+		fprintf(stderr, "script failed: %d\n", ret);
+		return 1;
+	}
+
+	printf("lines:     %lu\n", lines);
+	printf("commands:  %u\n", ncmds);
+	printf("calls:     %lu\n", calls);
+	printf("elapsed:   %.3f s\n", t1 - t0);
+	printf("lines/sec: %.0f\n", lines / (t1 - t0));
+	printf("ns/line:   %.0f\n", (t1 - t0) * 1e9 / lines);
+#ifdef CMDS_BENCH_WRAP_MALLOC
+	printf("mallocs:   %lu\n", m0);
+#endif /* CMDS_BENCH_WRAP_MALLOC */
+
+	return 0;
+}
@@ -0,0 +1,251 @@
+/**
+ * COPYRIGHT 2024 Flirc, Inc. All rights reserved.
+ *
+ * This copyright notice is Copyright Management Information under 17 USC 1202
+ * and is included to protect this work and deter copyright infringement.
+ * Removal or alteration of this Copyright Management Information without
+ * the express written permission of Flirc, Inc. is prohibited, and any
+ * such unauthorized removal or alteration will be a violation of federal law.
+ */
+
+/*
+ * dict_bench.c - Insert, lookup and remove timings for the dictionary.
+ *
+ * For each size the same keys are inserted into a fresh dictionary, looked
+ * up (hits), looked up with keys that aren't present (misses) and removed.
+ * Small sizes are repeated so every row covers roughly the same number of
+ * operations. Results are in ns per operation.
+ *
+ * A second table compares loading a serialized dictionary from a file with
+ * dict_deserialize against mapping an indexed one with dict_view_map, and
+ * lookups through the view.
+ *
+ * usage: dict_bench [size ...]
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <dict.h>
+#include <dict_view.h>
+#include <logging.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define KEY_LEN			(24)
+#define OPS_PER_ROW		(200000)
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static char *make_keys(unsigned long n, const char *prefix)
+{
+	char *keys;
+	unsigned long i;
+
+	if((keys = malloc(n * KEY_LEN)) == NULL)
+		return NULL;
+
+	for(i = 0; i < n; i++)
+		snprintf(&keys[i * KEY_LEN], KEY_LEN, "%s.%08lx", prefix,
+				(i * 2654435761ul) & 0xffffffff);
+
+	return keys;
+}
+
+static int run(unsigned long n)
+{
+	unsigned long reps = OPS_PER_ROW / n, r, i, found = 0;
+	double t_add = 0, t_hit = 0, t_miss = 0, t_del = 0, t;
+	char *keys = make_keys(n, "device.meta");
+	char *miss = make_keys(n, "device.none");
+	struct dictionary *d;
+
+	if(!keys || !miss)
+		return -1;
+	if(!reps)
+		reps = 1;
+
+	for(r = 0; r < reps; r++) {
+		if((d = new_dict()) == NULL)
+			return -1;
+
+		t = now();
+		for(i = 0; i < n; i++)
+			dict_add_key(d, &keys[i * KEY_LEN], &i, sizeof(i));
+		t_add += now() - t;
+
+		t = now();
+		for(i = 0; i < n; i++)
+			found += dict_has_key(d, &keys[i * KEY_LEN]);
+		t_hit += now() - t;
+
+		t = now();
+		for(i = 0; i < n; i++)
+			found += dict_has_key(d, &miss[i * KEY_LEN]);
+		t_miss += now() - t;
+
+		t = now();
+		for(i = 0; i < n; i++)
+			dict_remove_key(d, &keys[i * KEY_LEN]);
+		t_del += now() - t;
+
+		delete_dict(d);
+	}
+
+	if(found != n * reps) {
+		fprintf(stderr, "lookup mismatch: %lu != %lu\n", found,
+				n * reps);
+		return -1;
+	}
+
+	t = 1e9 / (n * reps);
+	printf("%8lu %10.1f %10.1f %10.1f %10.1f\n", n, t_add * t, t_hit * t,
+			t_miss * t, t_del * t);
+
+	free(keys);
+	free(miss);
+
+	return 0;
+}
+
+static int write_file(const char *path, const void *buf, size_t size)
+{
+	FILE *fp;
+	int ret = 0;
+
+	if((fp = fopen(path, "wb")) == NULL)
+		return -1;
+	if(fwrite(buf, 1, size, fp) != size)
+		ret = -1;
+	if(fclose(fp) != 0)
+		ret = -1;
+
+	return ret;
+}
+
+static void *read_file(const char *path, size_t size)
+{
+	FILE *fp;
+	void *buf;
+
+	if((fp = fopen(path, "rb")) == NULL)
+		return NULL;
+	if(((buf = malloc(size)) != NULL) && (fread(buf, 1, size, fp) != size)) {
+		free(buf);
+		buf = NULL;
+	}
+	fclose(fp);
+
+	return buf;
+}
+
+static int run_view(unsigned long n)
+{
+	char flat[] = "/tmp/dict_benchXXXXXX";
+	char indexed[] = "/tmp/dict_benchXXXXXX";
+	char *keys = make_keys(n, "device.meta");
+	struct dictionary *d, *d2;
+	struct dict_view v;
+	void *blob, *buf;
+	size_t fsize, isize;
+	unsigned long i, found = 0;
+	double t, t_deser, t_open, t_hit;
+	int fd;
+
+	if(!keys || ((d = new_dict()) == NULL))
+		return -1;
+	for(i = 0; i < n; i++)
+		dict_add_key(d, &keys[i * KEY_LEN], &i, sizeof(i));
+
+	if(((fd = mkstemp(flat)) < 0) || (close(fd) < 0) ||
+			((fd = mkstemp(indexed)) < 0) || (close(fd) < 0))
+		return -1;
+
+	blob = dict_serialize(d, &fsize);
+	write_file(flat, blob, fsize);
+	free(blob);
+	blob = dict_serialize_indexed(d, &isize);
+	write_file(indexed, blob, isize);
+	free(blob);
+	delete_dict(d);
+
+	t = now();
+	buf = read_file(flat, fsize);
+	d2 = buf ? dict_deserialize(buf, fsize) : NULL;
+	t_deser = now() - t;
+
+	t = now();
+	if(dict_view_map(&v, indexed) < 0)
+		return -1;
+	t_open = now() - t;
+
+	t = now();
+	for(i = 0; i < n; i++)
+		found += dict_view_has_key(&v, &keys[i * KEY_LEN]);
+	t_hit = now() - t;
+
+	if(!d2 || (found != n) || (d2->entries != dict_view_entries(&v))) {
+		fprintf(stderr, "view mismatch\n");
+		return -1;
+	}
+
+	printf("%8lu %12.1f %12.1f %10.1f\n", n, t_deser * 1e6,
+			t_open * 1e6, t_hit * 1e9 / n);
+
+	dict_view_close(&v);
+	delete_dict(d2);
+	free(buf);
+	free(keys);
+	remove(flat);
+	remove(indexed);
+
+	return 0;
+}
+
+int main(int argc, const char *argv[])
+{
+	static const unsigned long sizes[] = { 10, 1000, 100000 };
+	int i;
+
+	set_log_level(LOGLEVEL_ERROR);
+
+	printf("%8s %10s %10s %10s %10s   (ns/op)\n", "entries", "add",
+			"hit", "miss", "remove");
+
+	if(argc > 1) {
+		for(i = 1; i < argc; i++) {
+			if(run(strtoul(argv[i], NULL, 0)) < 0)
+				return 1;
+		}
+	} else {
+		for(i = 0; i < ARRAY_SIZE(sizes); i++) {
+			if(run(sizes[i]) < 0)
+				return 1;
+		}
+	}
+
+	printf("\n%8s %12s %12s %10s\n", "entries", "deser (us)",
+			"view (us)", "view hit (ns/op)");
+
+	if(argc > 1) {
+		for(i = 1; i < argc; i++) {
+			if(run_view(strtoul(argv[i], NULL, 0)) < 0)
+				return 1;
+		}
+	} else {
+		for(i = 0; i < ARRAY_SIZE(sizes); i++) {
+			if(run_view(sizes[i]) < 0)
+				return 1;
+		}
+	}
+
+	return 0;
+}
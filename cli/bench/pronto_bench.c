@@ -0,0 +1,191 @@
+/**
+ * COPYRIGHT 2024 Flirc, Inc. All rights reserved.
+ *
+ * This copyright notice is Copyright Management Information under 17 USC 1202
+ * and is included to protect this work and deter copyright infringement.
+ * Removal or alteration of this Copyright Management Information without
+ * the express written permission of Flirc, Inc. is prohibited, and any
+ * such unauthorized removal or alteration will be a violation of federal law.
+ */
+
+/*
+ * pronto_bench.c - Pronto conversion timings.
+ *
+ * A library of NEC style codes, a frame and a repeat frame each, is made at
+ * a spread of carriers with ir_raw_to_pronto(). Every code is checked to
+ * come back from ir_pronto_to_raw() and go round again to the same words.
+ *
+ * Then, per library size, in ns per code: converting the codes one at a
+ * time, and converting them with ir_pronto_to_raw_batch().
+ *
+ * usage: pronto_bench [size ...]
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <pronto.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define OPS_PER_ROW		(2000000)
+
+static const uint32_t carriers[] = { 36000, 38000, 40000, 56000 };
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static uint32_t rng(uint32_t *s)
+{
+	/* xorshift32 */
+	*s ^= *s << 13;
+	*s ^= *s >> 17;
+	*s ^= *s << 5;
+	return *s;
+}
+
+/* 9000/4500 header, 32 bits, stop mark and gap, then a repeat frame */
+static void nec_raw(struct pronto_raw *r, uint32_t code, uint32_t carrier)
+{
+	uint32_t *p = r->buf;
+	int i;
+
+	r->carrier = carrier;
+
+	*p++ = 9000;
+	*p++ = 4500;
+	for (i = 0; i < 32; i++) {
+		*p++ = 560;
+		*p++ = (code >> i) & 1 ? 1690 : 560;
+	}
+	*p++ = 560;
+	*p++ = 40000;
+	r->once = p - r->buf;
+
+	*p++ = 9000;
+	*p++ = 2250;
+	*p++ = 560;
+	*p++ = 96000;
+	r->repeat = p - r->buf - r->once;
+}
+
+struct library {
+	uint16_t *words;
+	struct pronto_code *codes;
+	unsigned long n;
+};
+
+static int make_library(struct library *lib, unsigned long n)
+{
+	uint16_t back[PRONTO_MAX_WORDS];
+	struct pronto_raw raw, conv;
+	uint32_t seed = 0x1F1C;
+	unsigned long i;
+	int len;
+
+	lib->n = n;
+	lib->words = malloc(n * PRONTO_MAX_WORDS * sizeof(*lib->words));
+	lib->codes = malloc(n * sizeof(*lib->codes));
+	if (!lib->words || !lib->codes)
+		return -1;
+
+	for (i = 0; i < n; i++) {
+		uint16_t *w = &lib->words[i * PRONTO_MAX_WORDS];
+
+		nec_raw(&raw, rng(&seed), carriers[i % 4]);
+		if ((len = ir_raw_to_pronto(&raw, w, PRONTO_MAX_WORDS)) < 0) {
+			printf("code %lu: ir_raw_to_pronto failed\n", i);
+			return -1;
+		}
+		lib->codes[i].words = w;
+		lib->codes[i].len = len;
+
+		/* a tick is far longer than a microsecond, so the trip
+		 * through microseconds must not lose anything */
+		if (ir_pronto_to_raw(w, len, &conv) < 0 ||
+				ir_raw_to_pronto(&conv, back, PRONTO_MAX_WORDS)
+					!= len ||
+				memcmp(back, w, len * sizeof(*w))) {
+			printf("code %lu: doesn't survive a round trip\n", i);
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+static int run(unsigned long n)
+{
+	unsigned long reps = OPS_PER_ROW / n, r, i;
+	double t_one, t_batch, t;
+	struct pronto_raw *raw;
+	struct library lib;
+	uint64_t sum = 0;
+
+	if (!reps)
+		reps = 1;
+
+	if (make_library(&lib, n) < 0 ||
+			(raw = malloc(n * sizeof(*raw))) == NULL)
+		return -1;
+
+	t = now();
+	for (r = 0; r < reps; r++) {
+		for (i = 0; i < n; i++) {
+			ir_pronto_to_raw(lib.codes[i].words, lib.codes[i].len,
+					&raw[i]);
+			sum += raw[i].buf[1];
+		}
+	}
+	t_one = now() - t;
+
+	t = now();
+	for (r = 0; r < reps; r++) {
+		if (ir_pronto_to_raw_batch(lib.codes, raw, n) != n)
+			return -1;
+		sum += raw[n - 1].buf[1];
+	}
+	t_batch = now() - t;
+
+	printf("%8lu %10.1f %10.1f\n", n, t_one * 1e9 / (reps * n),
+			t_batch * 1e9 / (reps * n));
+
+	/* keep the conversions from being optimized away */
+	if (sum == 0)
+		printf("\n");
+
+	free(raw);
+	free(lib.codes);
+	free(lib.words);
+
+	return 0;
+}
+
+int main(int argc, const char *argv[])
+{
+	static const unsigned long sizes[] = { 10, 1000, 20000 };
+	int i;
+
+	printf("%8s %10s %10s   (ns/code)\n", "codes", "single", "batch");
+
+	if (argc > 1) {
+		for (i = 1; i < argc; i++) {
+			if (run(strtoul(argv[i], NULL, 0)) < 0)
+				return 1;
+		}
+	} else {
+		for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+			if (run(sizes[i]) < 0)
+				return 1;
+		}
+	}
+
+	return 0;
+}
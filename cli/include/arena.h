@@ -0,0 +1,137 @@
+/**
+ * COPYRIGHT 2024 Flirc, Inc. All rights reserved.
+ *
+ * This copyright notice is Copyright Management Information under 17 USC 1202
+ * and is included to protect this work and deter copyright infringement.
+ * Removal or alteration of this Copyright Management Information without
+ * the express written permission of Flirc, Inc. is prohibited, and any
+ * such unauthorized removal or alteration will be a violation of federal law.
+ *
+ * @file
+ * @brief   Bump allocator for short lived, nested allocations
+ */
+
+#include <stddef.h>
+
+#ifndef I__ARENA_H__
+	#define I__ARENA_H__
+
+#ifndef ARENA_DEFAULT_CHUNK
+#define ARENA_DEFAULT_CHUNK	4096
+#endif /* ARENA_DEFAULT_CHUNK */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/****************************** Data Structures *****************************/
+struct arena_chunk;
+
+/* Arena Data Structure
+ * 	Allocations are carved out of a chain of chunks. Nothing is freed
+ * 	individually; instead a mark is taken and later restored, releasing
+ * 	everything allocated since. Chunks past the current one are kept
+ * 	for reuse, so once an arena has grown to its working size it stops
+ * 	calling malloc altogether.
+ */
+struct arena {
+	struct arena_chunk *head;
+	struct arena_chunk *cur;
+	size_t chunk_size;
+};
+
+/* Arena Mark
+ * 	Position in an arena, taken with arena_mark(). Marks nest like a
+ * 	stack and must be restored in reverse order.
+ */
+struct arena_mark {
+	struct arena_chunk *chunk;
+	size_t used;
+};
+
+#define ARENA_INIT(size)	{ NULL, NULL, (size) }
+
+
+/******************************* API Functions ******************************/
+/* FUNCTION:    arena_init
+ *
+ * + DESCRIPTION:
+ *   - initializes an empty arena. no memory is allocated until first use.
+ *
+ * + PARAMETERS:
+ *   + struct arena *a
+ *     - arena to initialize
+ *   + size_t chunk_size
+ *     - minimum chunk size, 0 for ARENA_DEFAULT_CHUNK
+ */
+void arena_init(struct arena *a, size_t chunk_size);
+
+/* FUNCTION:    arena_destroy
+ *
+ * + DESCRIPTION:
+ *   - frees all memory held by an arena
+ *
+ * + PARAMETERS:
+ *   + struct arena *a
+ *     - arena pointer
+ */
+void arena_destroy(struct arena *a);
+
+/* FUNCTION:    arena_alloc
+ *
+ * + DESCRIPTION:
+ *   - allocates suitably aligned memory from an arena
+ *
+ * + PARAMETERS:
+ *   + struct arena *a
+ *     - arena pointer
+ *   + size_t size
+ *     - number of bytes
+ *
+ * + RETURNS: void *
+ *   - pointer to memory, NULL on failure
+ */
+void *arena_alloc(struct arena *a, size_t size);
+
+/* FUNCTION:    arena_strdup
+ *
+ * + DESCRIPTION:
+ *   - copies a string into an arena
+ *
+ * + RETURNS: char *
+ *   - pointer to copy, NULL on failure
+ */
+char *arena_strdup(struct arena *a, const char *s);
+
+/* FUNCTION:    arena_mark
+ *
+ * + DESCRIPTION:
+ *   - returns the current position of an arena
+ *
+ * + PARAMETERS:
+ *   + struct arena *a
+ *     - arena pointer
+ *
+ * + RETURNS: struct arena_mark
+ *   - mark to pass to arena_restore
+ */
+struct arena_mark arena_mark(struct arena *a);
+
+/* FUNCTION:    arena_restore
+ *
+ * + DESCRIPTION:
+ *   - releases everything allocated since a mark was taken
+ *
+ * + PARAMETERS:
+ *   + struct arena *a
+ *     - arena pointer
+ *   + struct arena_mark m
+ *     - mark returned by arena_mark
+ */
+void arena_restore(struct arena *a, struct arena_mark m);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* I__ARENA_H__ */
@@ -62,6 +62,20 @@ struct cmd_opt {
 #define CMD_OPT(name, shorto, longo, desc)	{#name, desc, shorto, longo},
 #define END_CMD_OPTS			{NULL, NULL, 0, NULL}}
 
+/* Batched Call Data Structure
+ * 	One invocation of a command within a batch, see run_cmd_batch.
+ * 	int argc		- number of arguments, options already removed
+ * 	const char **argv	- arguments
+ * 	struct dictionary *opts	- parsed options
+ * 	int status		- set by the batch handler, negative for error
+ */
+struct cmd_call {
+	int argc;
+	const char **argv;
+	struct dictionary *opts;
+	int status;
+};
+
 /* Command Data Structure */
 struct cmd {
 	/* The name of the command */
@@ -87,26 +101,51 @@ struct cmd {
 
 	/* pointer to option list */
 	const struct cmd_opt *options;
+
+	/* Optional handler for running several consecutive invocations of the
+	 * command at once, so per-call device work (e.g. re-reading the
+	 * configuration) can be shared. NULL if not supported. Each call's
+	 * status is what handler would have returned for it, and the handler
+	 * stops at the first call that fails, leaving the rest unrun.
+	 * 	struct cmd_call *calls	- invocations, in order
+	 * 	int ncalls		- number of invocations
+	 * 	struct cmd *cmd		- pointer to command structure
+	 * 	void *appdata		- optional data passed by the application
+	 */
+	int (*batch)(struct cmd_call *calls, int ncalls,
+			const struct cmd *cmd, void *appdata);
 };
 
 struct cmd_mgr {
 	struct list_head node;
 	const struct cmd *cmd;
+
+	/* Option lookup tables. These are private to cmds.c and are filled in
+	 * when the command index is built.
+	 * 	shortopt	- index + 1 into cmd->options, by character
+	 * 	longopts	- options with a longopt, sorted by longopt
+	 */
+	uint8_t shortopt[128];
+	const struct cmd_opt **longopts;
+	unsigned int nlongopts;
 };
 
 /* Add a Command to Section - use this for defining commands */
 #define APPCMD(name,handler,summary,help,priv) \
-		_APPCMD(name,handler,summary,help,priv,NULL)
+		_APPCMD(name,handler,summary,help,priv,NULL,NULL)
 #define APPCMD_OPT(name,handler,summary,help,priv,opt) \
-		_APPCMD(name,handler,summary,help,priv,opt)
-#define _APPCMD(name,handler,summary,help,priv,opt) \
+		_APPCMD(name,handler,summary,help,priv,opt,NULL)
+#define APPCMD_BATCH(name,handler,batch,summary,help,priv,opt) \
+		_APPCMD(name,handler,summary,help,priv,opt,batch)
+#define _APPCMD(name,handler,summary,help,priv,opt,batch) \
 	static const struct cmd cmd_entry_ ## name = { \
 		#name, \
 		handler, \
 		summary, \
 		help, \
 		priv, \
-		opt }; \
+		opt, \
+		batch }; \
 	static void __constructor REGFUNC__ ## name(void) { \
 		static struct cmd_mgr c; \
 		c.cmd = &cmd_entry_ ## name; \
@@ -122,6 +161,13 @@ struct cmd_mgr {
 				const struct cmd *cmd, void *appdata, \
 				struct dictionary *opts)
 
+/* Batch handler prototype
+ * 	RETURN negative for error, otherwise 0. Set status for each call.
+ */
+#define CMDBATCH(name) \
+		static int name(struct cmd_call *calls, int ncalls, \
+				const struct cmd *cmd, void *appdata)
+
 #define THISCMD cmd->name
 /* Standard error print */
 #define pcmderr(fmt, args...) logerror("%s: " fmt, THISCMD, ## args)
@@ -191,6 +237,65 @@ int run_cmd(const char *name, int argc, const char **argv, void *appdata);
  */
 int run_cmd_line(const char *cmd_line, void *appdata);
 
+/* FUNCTION:    run_cmd_batch
+ *
+ * + DESCRIPTION:
+ *   - runs several invocations of the same command. options are parsed for
+ *   every call, then the command's batch handler is run once for all of
+ *   them. commands without a batch handler are run one call at a time.
+ *
+ * + PARAMETERS:
+ *   + const char *name
+ *     - name of command
+ *   + struct cmd_call *calls
+ *     - invocations, argc and argv filled in. status is set on return.
+ *   + int ncalls
+ *     - number of invocations
+ *   + void *appdata
+ *     - appdata pointer to pass to command
+ *
+ * + RETURNS: int
+ *   - 0 if every call succeeded, otherwise 1 + index of the first failed
+ *   call, the calls after it were not run. -EIO if the batch handler
+ *   failed as a whole, other negative values if the cmds framework
+ *   encountered an error.
+ */
+int run_cmd_batch(const char *name, struct cmd_call *calls, int ncalls,
+		void *appdata);
+
+/* FUNCTION:    cmd_can_batch
+ *
+ * + DESCRIPTION:
+ *   - returns true if a command has a batch handler
+ *
+ * + PARAMETERS:
+ *   + const char *name
+ *     - name of command
+ *
+ * + RETURNS: int
+ *   - boolean
+ */
+int cmd_can_batch(const char *name);
+
+/* FUNCTION:    tokenize_cmd_line
+ *
+ * + DESCRIPTION:
+ *   - splits a command line into arguments in place. spaces and tabs
+ *   separate arguments and may be escaped with a backslash.
+ *
+ * + PARAMETERS:
+ *   + char *cmd_line
+ *     - command line string, modified
+ *   + char **argv
+ *     - argument list to fill, NULL terminated
+ *   + size_t max_args
+ *     - size of argv
+ *
+ * + RETURNS: int
+ *   - number of arguments
+ */
+int tokenize_cmd_line(char *cmd_line, char **argv, size_t max_args);
+
 
 /* FUNCTION:    _register_cmd
  *
@@ -36,6 +36,7 @@
  */
 
 #include <ll.h>
+#include <arena.h>
 
 #include <sys/types.h>
 #include <stdint.h>
@@ -44,6 +45,7 @@
 #ifndef I__DICT_H__
 	#define I__DICT_H__
 
+/* initial table size, must be a power of two */
 #ifndef DICT_HASH_SIZE
 #define DICT_HASH_SIZE		16
 #endif /* DICT_HASH_SIZE */
@@ -80,10 +82,20 @@ static inline void *kvpair_value(struct kvpair *kvp, size_t *size)
 	return (void *)&kvp->kv[kvp->voffset];
 }
 
-/* Key/Value Pair Management Data Structure */
+/* Key/Value Pair Management Data Structure
+ * 	One slot of the open addressed table. The low bits of hash select the
+ * 	home slot, and keeping the hash and key length alongside the kvpair
+ * 	pointer means a probe only dereferences kvp on a likely match.
+ * 	Slots move when the table grows or an entry is removed, so pointers
+ * 	to them are only good until the next change to the dictionary. The
+ * 	kvpair itself, and so any value pointer, never moves.
+ */
 struct kvpair_mgr {
-	/* hash table node */
-	struct hlist_node node;
+	/* hash of the key, 0 for an empty slot */
+	uint32_t hash;
+
+	/* key length, not including the null terminator */
+	uint32_t keylen;
 
 	/* free handler - called when key/value is deleted */
 	void (*free)(struct kvpair *);
@@ -93,11 +105,17 @@ struct kvpair_mgr {
 
 /* Dictionary Data Structure */
 struct dictionary {
-	/* hash table */
-	struct hlist_head kvtable[DICT_HASH_SIZE];
+	/* open addressed table, linear probing */
+	struct kvpair_mgr *table;
+
+	/* table size - 1, the table size is a power of two */
+	uint32_t mask;
 
 	/* entry count */
 	unsigned int entries;
+
+	/* backing arena, NULL for heap allocated dictionaries */
+	struct arena *arena;
 };
 
 
@@ -112,6 +130,22 @@ struct dictionary {
  */
 struct dictionary *new_dict(void);
 
+/* FUNCTION:    new_dict_arena
+ *
+ * + DESCRIPTION:
+ *   - creates a new empty dictionary that allocates the dictionary and all
+ *   of its entries from an arena. delete_dict and dict_remove_key don't
+ *   release anything; the memory goes back when the arena is restored.
+ *
+ * + PARAMETERS:
+ *   + struct arena *arena
+ *     - arena to allocate from
+ *
+ * + RETURNS: struct dictionary *
+ *   - pointer to new dictionary, NULL on failure
+ */
+struct dictionary *new_dict_arena(struct arena *arena);
+
 /* FUNCTION:    delete_dict
  *
  * + DESCRIPTION:
@@ -327,9 +361,22 @@ static inline char *dict_str_for_key(struct dictionary *dict, const char *key)
 struct kvpair *new_kvpair(const char *key, const void *value, size_t size);
 void delete_kvpair(struct kvpair *kvp);
 
-struct kvpair_mgr *new_kvpair_mgr(struct kvpair *kvp,
-		void (*free_cb)(struct kvpair *));
-void delete_kvpair_mgr(struct kvpair_mgr *kvpair_mgr);
+
+/* FUNCTION:    dict_hash
+ *
+ * + DESCRIPTION:
+ *   - hashes a key. this is the hash used to place keys in the table.
+ *
+ * + PARAMETERS:
+ *   + const void *key
+ *     - key data
+ *   + size_t len
+ *     - key length
+ *
+ * + RETURNS: uint64_t
+ *   - 64 bit hash
+ */
+uint64_t dict_hash(const void *key, size_t len);
 
 struct kvpair_mgr *find_kvpair(struct dictionary *dict, const char *key);
 
@@ -0,0 +1,176 @@
+/**
+ * COPYRIGHT 2024 Flirc, Inc. All rights reserved.
+ *
+ * This copyright notice is Copyright Management Information under 17 USC 1202
+ * and is included to protect this work and deter copyright infringement.
+ * Removal or alteration of this Copyright Management Information without
+ * the express written permission of Flirc, Inc. is prohibited, and any
+ * such unauthorized removal or alteration will be a violation of federal law.
+ *
+ * @file
+ * @brief   Read only dictionary views over indexed serialized buffers
+ */
+
+#include <dict.h>
+
+#ifndef I__DICT_VIEW_H__
+	#define I__DICT_VIEW_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/****************************** Data Structures *****************************/
+/* Indexed Serialized Layout
+ * 	An indexed blob is a header, a hash index and then the same kvpair
+ * 	records dict_serialize produces, all in host byte order:
+ *
+ * 	struct dict_view_hdr	header
+ * 	struct dict_view_slot	index[nslots]
+ * 	struct kvpair		records...
+ *
+ * 	The index is an open addressed table using the dictionary's own
+ * 	hash, so looking a key up in a view costs the same probes as in a
+ * 	struct dictionary and touches nothing but the blob.
+ */
+#define DICT_VIEW_MAGIC		0x31564944	/* "DIV1" */
+
+struct dict_view_hdr {
+	uint32_t magic;
+	uint32_t entries;
+	uint32_t nslots;	/* power of two */
+	uint32_t data_size;	/* bytes of kvpair records */
+} __packed;
+
+struct dict_view_slot {
+	uint32_t hash;		/* 0 for an empty slot */
+	uint32_t offset;	/* record offset from the start of the records */
+} __packed;
+
+/* Dictionary View Data Structure */
+struct dict_view {
+	const struct dict_view_hdr *hdr;
+	const struct dict_view_slot *index;
+	const uint8_t *data;
+
+	/* set when the view owns a mapping, see dict_view_map */
+	void *map;
+	size_t map_size;
+};
+
+
+/******************************* API Functions ******************************/
+/* FUNCTION:    dict_serialize_indexed
+ *
+ * + DESCRIPTION:
+ *   - serializes a dictionary along with a hash index, for use with
+ *   dict_view_open or dict_view_map
+ *
+ * + PARAMETERS:
+ *   + struct dictionary *dict
+ *     - dictionary pointer
+ *   + size_t *size
+ *     - final size of serialized data
+ *
+ * + RETURNS: void *
+ *   - pointer to serialized data, NULL on failure
+ */
+void *dict_serialize_indexed(struct dictionary *dict, size_t *size);
+
+/* FUNCTION:    dict_view_open
+ *
+ * + DESCRIPTION:
+ *   - opens a view over an indexed buffer in place. only the header is
+ *   checked here, records are bounds checked as lookups reach them, so
+ *   opening is O(1) regardless of size. the buffer must outlive the view.
+ *
+ * + PARAMETERS:
+ *   + struct dict_view *view
+ *     - view to initialize
+ *   + const void *buf
+ *     - buffer from dict_serialize_indexed
+ *   + size_t size
+ *     - size of buffer
+ *
+ * + RETURNS: int
+ *   - 0 on success, negative on failure
+ */
+int dict_view_open(struct dict_view *view, const void *buf, size_t size);
+
+/* FUNCTION:    dict_view_map
+ *
+ * + DESCRIPTION:
+ *   - maps a file written from dict_serialize_indexed and opens a view
+ *   over it. on hosts without mmap the file is read into memory instead.
+ *
+ * + PARAMETERS:
+ *   + struct dict_view *view
+ *     - view to initialize
+ *   + const char *path
+ *     - file to map
+ *
+ * + RETURNS: int
+ *   - 0 on success, negative on failure
+ */
+int dict_view_map(struct dict_view *view, const char *path);
+
+/* FUNCTION:    dict_view_close
+ *
+ * + DESCRIPTION:
+ *   - releases a view, unmapping its file if it was opened with
+ *   dict_view_map
+ *
+ * + PARAMETERS:
+ *   + struct dict_view *view
+ *     - view pointer
+ */
+void dict_view_close(struct dict_view *view);
+
+/* FUNCTION:    dict_view_value_for_key
+ *
+ * + DESCRIPTION:
+ *   - look up a value for a key in a view
+ *
+ * + PARAMETERS:
+ *   + const struct dict_view *view
+ *     - view pointer
+ *   + const char *key
+ *     - key string
+ *   + size_t *size
+ *     - size of found value
+ *
+ * + RETURNS: const void *
+ *   - pointer to value within the buffer, NULL if not found
+ */
+const void *dict_view_value_for_key(const struct dict_view *view,
+		const char *key, size_t *size);
+
+/* FUNCTION:    dict_view_has_key
+ *
+ * + DESCRIPTION:
+ *   - returns true if a view has a key
+ *
+ * + RETURNS: int
+ *   - boolean
+ */
+static inline int dict_view_has_key(const struct dict_view *view,
+		const char *key)
+{
+	return dict_view_value_for_key(view, key, NULL) != NULL;
+}
+
+/* FUNCTION:    dict_view_entries
+ *
+ * + RETURNS: unsigned int
+ *   - number of entries in a view
+ */
+static inline unsigned int dict_view_entries(const struct dict_view *view)
+{
+	return view->hdr->entries;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* I__DICT_VIEW_H__ */
@@ -27,6 +27,17 @@
 #define HEXDUMP_WIDTH	16
 #endif /* HEXDUMP_WIDTH */
 
+/* lines rendered on the stack before each write */
+#ifndef HEXDUMP_CHUNK_LINES
+#define HEXDUMP_CHUNK_LINES	64
+#endif /* HEXDUMP_CHUNK_LINES */
+
+/* "xxxxxxxx: " + hex column + ' ' + ascii column + '\n' */
+#define HEXDUMP_LINE_MAX	(10 + 3 * HEXDUMP_WIDTH + 1 + HEXDUMP_WIDTH + 1)
+
+/* receives whole lines, text is not nul terminated */
+typedef void (*hexdump_sink_t)(void *ctx, const char *text, size_t len);
+
 /* FUNCTION:    hexdump
  *
  * + DESCRIPTION:
@@ -40,4 +51,22 @@
  */
 void hexdump(FILE *outf, void *buf, size_t size);
 
+/* FUNCTION:    hexdump_to
+ *
+ * + DESCRIPTION:
+ *   - same dump as hexdump, handed to a callback instead of a file, up to
+ *     HEXDUMP_CHUNK_LINES lines per call
+ *
+ * + PARAMETERS:
+ *   + hexdump_sink_t sink
+ *     - called with each chunk of formatted lines
+ *   + void *ctx
+ *     - passed through to sink
+ *   + const void *buf
+ *     - buffer to dump
+ *   + size_t size
+ *     - size of buffer
+ */
+void hexdump_to(hexdump_sink_t sink, void *ctx, const void *buf, size_t size);
+
 #endif /* I__HEXDUMP_H__ */
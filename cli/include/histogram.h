@@ -0,0 +1,217 @@
+/**
+ * COPYRIGHT 2024 Flirc, Inc. All rights reserved.
+ *
+ * This copyright notice is Copyright Management Information under 17 USC 1202
+ * and is included to protect this work and deter copyright infringement.
+ * Removal or alteration of this Copyright Management Information without
+ * the express written permission of Flirc, Inc. is prohibited, and any
+ * such unauthorized removal or alteration will be a violation of federal law.
+ *
+ * @file
+ * @brief   Fixed size latency histograms with percentile queries
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+
+#ifndef I__HISTOGRAM_H__
+	#define I__HISTOGRAM_H__
+
+/* Sub-bucket resolution. Every power of two range is split into
+ * 2^(HIST_SUB_BITS - 1) linear buckets, so any recorded value is reported
+ * to within 1 / 2^(HIST_SUB_BITS - 1) of what was recorded (1.6% at 7).
+ */
+#ifndef HIST_SUB_BITS
+#define HIST_SUB_BITS		7
+#endif /* HIST_SUB_BITS */
+
+#define HIST_SUB_COUNT		(1 << HIST_SUB_BITS)
+#define HIST_HALF_COUNT		(HIST_SUB_COUNT / 2)
+#define HIST_BUCKETS		(HIST_SUB_COUNT + \
+					(64 - HIST_SUB_BITS) * HIST_HALF_COUNT)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/****************************** Data Structures *****************************/
+/* Histogram Data Structure
+ * 	HDR style log-linear histogram over the full uint64_t range. Values
+ * 	below HIST_SUB_COUNT get a bucket each, above that every power of two
+ * 	gets HIST_HALF_COUNT buckets. Recording is a couple of shifts and an
+ * 	increment, nothing is allocated, and percentiles from p50 out to
+ * 	p99.99 come straight from the counts.
+ *
+ * 	A histogram is not locked. Record into it from one thread, or give
+ * 	each thread its own and hist_merge() them.
+ */
+struct histogram {
+	const char *name;
+	uint64_t count;
+	uint64_t sum;
+	uint64_t min;
+	uint64_t max;
+	uint64_t counts[HIST_BUCKETS];
+	struct histogram *next;
+};
+
+#define HISTOGRAM_INIT(n)	{ (n), 0, 0, UINT64_MAX, 0, { 0 }, NULL }
+
+
+/******************************* API Functions ******************************/
+/* FUNCTION:    hist_init
+ *
+ * + DESCRIPTION:
+ *   - clears a histogram and names it
+ *
+ * + PARAMETERS:
+ *   + struct histogram *h
+ *     - histogram to initialize
+ *   + const char *name
+ *     - label used when printing, not copied
+ */
+void hist_init(struct histogram *h, const char *name);
+
+/* FUNCTION:    hist_reset
+ *
+ * + DESCRIPTION:
+ *   - drops every recorded value, keeps the name and registration
+ *
+ * + PARAMETERS:
+ *   + struct histogram *h
+ *     - histogram pointer
+ */
+void hist_reset(struct histogram *h);
+
+/* FUNCTION:    hist_record
+ *
+ * + DESCRIPTION:
+ *   - adds one value to a histogram
+ *
+ * + PARAMETERS:
+ *   + struct histogram *h
+ *     - histogram pointer
+ *   + uint64_t v
+ *     - value, any unit as long as it's the same for every record
+ */
+void hist_record(struct histogram *h, uint64_t v);
+
+/* FUNCTION:    hist_merge
+ *
+ * + DESCRIPTION:
+ *   - adds everything recorded in one histogram to another
+ *
+ * + PARAMETERS:
+ *   + struct histogram *dst
+ *     - histogram to add into
+ *   + const struct histogram *src
+ *     - histogram to add, left unchanged
+ */
+void hist_merge(struct histogram *dst, const struct histogram *src);
+
+/* FUNCTION:    hist_percentile
+ *
+ * + DESCRIPTION:
+ *   - finds the value at or below which a given share of records fall
+ *
+ * + PARAMETERS:
+ *   + const struct histogram *h
+ *     - histogram pointer
+ *   + double pct
+ *     - percentile, 0.0 to 100.0
+ *
+ * + RETURNS: uint64_t
+ *   - highest value equivalent to the bucket holding the percentile,
+ *     clamped to the largest value recorded. 0 if nothing was recorded.
+ */
+uint64_t hist_percentile(const struct histogram *h, double pct);
+
+/* FUNCTION:    hist_mean
+ *
+ * + RETURNS: double
+ *   - average of every recorded value, 0 if nothing was recorded
+ */
+double hist_mean(const struct histogram *h);
+
+/* FUNCTION:    hist_print
+ *
+ * + DESCRIPTION:
+ *   - prints one summary line: count, min, p50, p90, p99, p99.9, p99.99
+ *     and max. values are divided by scale first, so a histogram of
+ *     nanoseconds can be shown in microseconds with a scale of 1000.
+ *
+ * + PARAMETERS:
+ *   + const struct histogram *h
+ *     - histogram pointer
+ *   + FILE *fp
+ *     - stream to print to
+ *   + double scale
+ *     - divisor applied to every value
+ */
+void hist_print(const struct histogram *h, FILE *fp, double scale);
+
+/* FUNCTION:    hist_print_header
+ *
+ * + DESCRIPTION:
+ *   - prints the column titles matching hist_print()
+ *
+ * + PARAMETERS:
+ *   + FILE *fp
+ *     - stream to print to
+ *   + const char *unit
+ *     - unit the values are shown in, e.g. "us"
+ */
+void hist_print_header(FILE *fp, const char *unit);
+
+/* FUNCTION:    hist_register
+ *
+ * + DESCRIPTION:
+ *   - adds a histogram to the process wide list shown by hist_print_all().
+ *     registering the same histogram twice has no effect.
+ *
+ * + PARAMETERS:
+ *   + struct histogram *h
+ *     - histogram to register, must outlive the program or be
+ *       unregistered
+ */
+void hist_register(struct histogram *h);
+
+/* FUNCTION:    hist_unregister
+ *
+ * + PARAMETERS:
+ *   + struct histogram *h
+ *     - histogram to remove from the process wide list
+ */
+void hist_unregister(struct histogram *h);
+
+/* FUNCTION:    hist_reset_all
+ *
+ * + DESCRIPTION:
+ *   - hist_reset() on every registered histogram
+ */
+void hist_reset_all(void);
+
+/* FUNCTION:    hist_print_all
+ *
+ * + DESCRIPTION:
+ *   - prints a header and one line per registered histogram that has
+ *     recorded anything, in registration order
+ *
+ * + PARAMETERS:
+ *   + FILE *fp
+ *     - stream to print to
+ *   + const char *unit
+ *     - unit label for the header
+ *   + double scale
+ *     - divisor applied to every value
+ *
+ * + RETURNS: int
+ *   - number of histograms printed
+ */
+int hist_print_all(FILE *fp, const char *unit, double scale);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* I__HISTOGRAM_H__ */
@@ -0,0 +1,89 @@
+/**
+ * COPYRIGHT 2024 Flirc, Inc. All rights reserved.
+ *
+ * This copyright notice is Copyright Management Information under 17 USC 1202
+ * and is included to protect this work and deter copyright infringement.
+ * Removal or alteration of this Copyright Management Information without
+ * the express written permission of Flirc, Inc. is prohibited, and any
+ * such unauthorized removal or alteration will be a violation of federal law.
+ *
+ * @file
+ * @brief   Binary log file format
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <prjutil.h>
+
+#ifndef I__LOGBIN_H__
+	#define I__LOGBIN_H__
+
+/* Binary Log Format
+ * 	A header followed by a stream of records, all in host byte order.
+ * 	Arguments are stored as logfmt_capture lays them out, so the file
+ * 	can only be decoded on a host with the same type sizes; the header
+ * 	records them and logdecode refuses files that don't match.
+ *
+ * 	A site is defined once, before its first message:
+ * 		struct logbin_define, file, func, fmt (no terminators)
+ * 	and each message is then:
+ * 		struct logbin_msg, args[len]
+ */
+#define LOGBIN_MAGIC		"FLOGBIN1"
+#define LOGBIN_MAGIC_LEN	(8)
+#define LOGBIN_ENDIAN		0x01020304
+
+enum {
+	LOGBIN_DEFINE = 1,
+	LOGBIN_MSG,
+	LOGBIN_DROP,
+};
+
+struct logbin_hdr {
+	char magic[LOGBIN_MAGIC_LEN];
+	uint32_t endian;
+	uint8_t sz_int;
+	uint8_t sz_long;
+	uint8_t sz_ptr;
+	uint8_t sz_ldouble;
+} __packed;
+
+struct logbin_define {
+	uint8_t type;
+	uint8_t level;
+	char tag;
+	uint8_t pad;
+	uint32_t id;
+	uint32_t line;
+	uint16_t file_len;
+	uint16_t func_len;
+	uint16_t fmt_len;
+} __packed;
+
+struct logbin_msg {
+	uint8_t type;
+	uint8_t flags;		/* LOGFMT_* */
+	uint16_t len;
+	uint32_t id;
+	uint64_t ts_ns;		/* CLOCK_MONOTONIC */
+} __packed;
+
+/* messages lost because the ring was full */
+struct logbin_drop {
+	uint8_t type;
+	uint8_t pad[3];
+	uint32_t count;
+	uint64_t ts_ns;
+} __packed;
+
+static inline void logbin_hdr_init(struct logbin_hdr *h)
+{
+	memcpy(h->magic, LOGBIN_MAGIC, LOGBIN_MAGIC_LEN);
+	h->endian = LOGBIN_ENDIAN;
+	h->sz_int = sizeof(int);
+	h->sz_long = sizeof(long);
+	h->sz_ptr = sizeof(void *);
+	h->sz_ldouble = sizeof(long double);
+}
+
+#endif /* I__LOGBIN_H__ */
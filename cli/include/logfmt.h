@@ -0,0 +1,124 @@
+/**
+ * COPYRIGHT 2024 Flirc, Inc. All rights reserved.
+ *
+ * This copyright notice is Copyright Management Information under 17 USC 1202
+ * and is included to protect this work and deter copyright infringement.
+ * Removal or alteration of this Copyright Management Information without
+ * the express written permission of Flirc, Inc. is prohibited, and any
+ * such unauthorized removal or alteration will be a violation of federal law.
+ *
+ * @file
+ * @brief   Deferred printf formatting
+ */
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifndef I__LOGFMT_H__
+	#define I__LOGFMT_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Deferred Formatting
+ * 	logfmt_capture walks a printf format string and copies each argument
+ * 	it names out of a va_list into a flat buffer: integers at their
+ * 	promoted width, floating point as double, pointers by value and
+ * 	strings by content. logfmt_render later walks the same format string
+ * 	and feeds the saved arguments back through snprintf, one conversion
+ * 	at a time. The format string itself is not copied, so it must live as
+ * 	long as the captured buffer does, i.e. be a string literal.
+ *
+ * 	%n is not supported and is skipped.
+ */
+
+/* set in logfmt_capture's return flags when something didn't fit */
+#define LOGFMT_TRUNCATED	0x1
+
+/* longest argument signature, a character per argument and the digits
+ * of any string precision */
+#ifndef LOGFMT_SIG_MAX
+#define LOGFMT_SIG_MAX		32
+#endif /* LOGFMT_SIG_MAX */
+
+/* FUNCTION:    logfmt_signature
+ *
+ * + DESCRIPTION:
+ *   - works out the argument types a format string takes, so they can be
+ *   captured repeatedly without parsing the format each time
+ *
+ * + PARAMETERS:
+ *   + const char *fmt
+ *     - printf format string
+ *   + char *sig
+ *     - signature string to fill
+ *   + size_t size
+ *     - size of sig, LOGFMT_SIG_MAX is always enough for the log macros
+ *
+ * + RETURNS: int
+ *   - number of arguments, negative if sig is too small
+ */
+int logfmt_signature(const char *fmt, char *sig, size_t size);
+
+/* FUNCTION:    logfmt_capture_sig
+ *
+ * + DESCRIPTION:
+ *   - same as logfmt_capture, from a signature made by logfmt_signature
+ */
+size_t logfmt_capture_sig(void *buf, size_t size, const char *sig,
+		va_list ap, int *flags);
+
+/* FUNCTION:    logfmt_capture
+ *
+ * + DESCRIPTION:
+ *   - copies the arguments of a format string into a buffer. strings that
+ *   don't fit are cut short rather than dropped.
+ *
+ * + PARAMETERS:
+ *   + void *buf
+ *     - destination buffer
+ *   + size_t size
+ *     - size of buffer
+ *   + const char *fmt
+ *     - printf format string
+ *   + va_list ap
+ *     - arguments for fmt
+ *   + int *flags
+ *     - set to LOGFMT_* flags, may be NULL
+ *
+ * + RETURNS: size_t
+ *   - number of bytes used in buf
+ */
+size_t logfmt_capture(void *buf, size_t size, const char *fmt, va_list ap,
+		int *flags);
+
+/* FUNCTION:    logfmt_render
+ *
+ * + DESCRIPTION:
+ *   - formats captured arguments
+ *
+ * + PARAMETERS:
+ *   + char *out
+ *     - output string, always null terminated
+ *   + size_t outsize
+ *     - size of out
+ *   + const char *fmt
+ *     - format string passed to logfmt_capture
+ *   + const void *args
+ *     - buffer filled by logfmt_capture
+ *   + size_t len
+ *     - bytes used in args
+ *
+ * + RETURNS: size_t
+ *   - length of the rendered string
+ */
+size_t logfmt_render(char *out, size_t outsize, const char *fmt,
+		const void *args, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* I__LOGFMT_H__ */
@@ -32,7 +32,9 @@
  */
 
 #include <stdio.h>
+#include <stdint.h>
 #include <prjutil.h>
+#include <logfmt.h>
 
 #ifndef I__LOGGING_H__
 	#define I__LOGGING_H__
@@ -52,13 +54,38 @@
 #define DEFAULT_LOGLEVEL	LOGLEVEL_WARNING
 #endif /* DEFAULT_LOGLEVEL */
 
+/* Log Call Sites
+ * 	Each log macro expands to a static descriptor for its call site, so
+ * 	everything that is fixed at compile time (level, location and format)
+ * 	is never passed or copied at run time. The async and binary backends
+ * 	refer to a message by its site; the binary log stores the site once
+ * 	and then just its id. id and sig are filled in on first use.
+ */
+struct log_site {
+	int level;
+	char tag;
+	int line;
+	const char *file;
+	const char *func;
+	const char *fmt;
+
+	/* private to logging.c */
+	uint32_t id;
+	int defined;
+	char sig[LOGFMT_SIG_MAX];
+};
+
+#define __LOG_SITE(lvl, t, fmt, args...) do { \
+		static struct log_site __log_site = \
+			{ lvl, t, __LINE__, __FILE__, __FUNCTION__, fmt }; \
+		if((lvl) <= __loglevel) \
+			__log_at(&__log_site, fmt, ## args); \
+	} while(0)
 
 /* LOGERROR */
 #if MAX_LOGLEVEL >= LOGLEVEL_ERROR
-#define logerror(fmt, args...)		__log(LOGLEVEL_ERROR, \
-						"[E] %s %s(%d): " fmt, \
-						__FILE__, \
-						__FUNCTION__, __LINE__, ## args)
+#define logerror(fmt, args...)		__LOG_SITE(LOGLEVEL_ERROR, 'E', \
+						fmt, ## args)
 
 #define log_error(fmt, args...)		logerror(fmt, ## args)
 #define log_err(fmt, args...)		logerror(fmt, ## args)
@@ -70,10 +97,8 @@
 
 /* LOGWARN */
 #if MAX_LOGLEVEL >= LOGLEVEL_WARNING
-#define logwarn(fmt, args...)		__log(LOGLEVEL_WARNING, \
-						"[W] %s %s(%d): " fmt, \
-						__FILE__, \
-						__FUNCTION__, __LINE__, ## args)
+#define logwarn(fmt, args...)		__LOG_SITE(LOGLEVEL_WARNING, 'W', \
+						fmt, ## args)
 #define log_warn(fmt, args...)		logwarn(fmt, ## args)
 #else
 #define logwarn(fmt, args...)
@@ -82,10 +107,8 @@
 
 /* LOGINFO */
 #if MAX_LOGLEVEL >= LOGLEVEL_INFO
-#define loginfo(fmt, args...)		__log(LOGLEVEL_INFO, \
-						"[I] %s %s(%d): " fmt, \
-						__FILE__, \
-						__FUNCTION__, __LINE__, ## args)
+#define loginfo(fmt, args...)		__LOG_SITE(LOGLEVEL_INFO, 'I', \
+						fmt, ## args)
 #define log_info(fmt, args...)		loginfo(fmt, ## args)
 #else
 #define loginfo(fmt, args...)
@@ -94,10 +117,8 @@
 
 /* LOGDEBUG */
 #if MAX_LOGLEVEL >= LOGLEVEL_DEBUG
-#define logdebug(fmt, args...)		__log(LOGLEVEL_DEBUG, \
-						"[D] %s %s(%d): " fmt, \
-						__FILE__, \
-						__FUNCTION__, __LINE__, ## args)
+#define logdebug(fmt, args...)		__LOG_SITE(LOGLEVEL_DEBUG, 'D', \
+						fmt, ## args)
 #define log_debug(fmt, args...)		logdebug(fmt, ## args)
 #else
 #define logdebug(fmt, args...)
@@ -106,10 +127,8 @@
 
 /* LOGVERBOSE */
 #if MAX_LOGLEVEL >= LOGLEVEL_VERBOSE
-#define logverbose(fmt, args...)	__log(LOGLEVEL_VERBOSE, \
-						"[V] %s %s(%d): " fmt, \
-						__FILE__, \
-						__FUNCTION__, __LINE__, ## args)
+#define logverbose(fmt, args...)	__LOG_SITE(LOGLEVEL_VERBOSE, 'V', \
+						fmt, ## args)
 #define log_verbose(fmt, args...)	logverbose(fmt, ## args)
 #else
 #define logverbose(fmt, args...)
@@ -120,9 +139,45 @@
 extern "C" {
 #endif
 
+extern int __loglevel;
+
 void __log(int level, const char *fmt, ...) __printf_check(2, 3);
+void __log_at(struct log_site *site, const char *fmt, ...)
+	__printf_check(2, 3);
 void set_log_level(int level);
 
+/* hexdump_to() sink that logs each chunk, ctx is the level to log at:
+ * 	hexdump_to(log_hexdump, (void *)LOGLEVEL_VERBOSE, buf, len);
+ * Check __loglevel first to skip formatting a dump nobody will see.
+ */
+void log_hexdump(void *ctx, const char *text, size_t len);
+
+/* Asynchronous and Binary Logging
+ * 	log_async_start moves formatting and writing to a background thread.
+ * 	Messages go through a bounded ring; when it is full they are dropped
+ * 	and counted rather than blocking the caller. fmt must then be a
+ * 	string literal, which the log macros always pass. Pending messages
+ * 	are flushed at exit; call log_flush before exiting any other way.
+ * 	log_flush is not async-signal-safe, call it from a thread that
+ * 	takes the signal with sigwait, as flirc_util does for SIGINT. It
+ * 	waits at most a second and stops at a message still being queued.
+ *
+ * 	log_binary_start does the same but, instead of formatting, writes each
+ * 	message as its site id, a monotonic timestamp and the raw arguments
+ * 	to a file (see logbin.h). Use the logdecode tool to read it.
+ */
+struct log_stats {
+	unsigned long logged;
+	unsigned long dropped;
+	unsigned long truncated;
+};
+
+int log_async_start(void);
+int log_binary_start(const char *path);
+void log_async_stop(void);
+void log_flush(void);
+void log_get_stats(struct log_stats *st);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,165 @@
+/**
+ * COPYRIGHT 2024 Flirc, Inc. All rights reserved.
+ *
+ * This copyright notice is Copyright Management Information under 17 USC 1202
+ * and is included to protect this work and deter copyright infringement.
+ * Removal or alteration of this Copyright Management Information without
+ * the express written permission of Flirc, Inc. is prohibited, and any
+ * such unauthorized removal or alteration will be a violation of federal law.
+ *
+ * @file
+ * @brief   Monotonic clock, deadline sleeps and scoped cycle timers
+ */
+
+#include <stdint.h>
+
+#ifndef I__MONOTIME_H__
+	#define I__MONOTIME_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/****************************** Data Structures *****************************/
+/* Scoped Timer
+ * 	Started with MONO_SCOPED_TIMER() and reported automatically when the
+ * 	enclosing block is left, however it is left. Timing is taken from
+ * 	the cycle counter so very short sections can be measured.
+ */
+struct mono_timer {
+	const char *name;
+	uint64_t start;
+};
+
+#define __MONO_CAT(a, b)	a ## b
+#define __MONO_TIMER(name, line) \
+	struct mono_timer __MONO_CAT(__mono_timer_, line) \
+		__attribute__((cleanup(mono_timer_report))) = \
+		{ (name), mono_cycles() }
+
+/* MACRO:       MONO_SCOPED_TIMER
+ *
+ * + DESCRIPTION:
+ *   - times the rest of the enclosing block and logs the result at debug
+ *     level when the block exits.
+ *
+ * + PARAMETERS:
+ *   + const char *name
+ *     - label printed with the result
+ */
+#define MONO_SCOPED_TIMER(name)	__MONO_TIMER(name, __LINE__)
+
+
+/******************************* API Functions ******************************/
+/* FUNCTION:    mono_now_ns
+ *
+ * + DESCRIPTION:
+ *   - reads the monotonic clock. unlike gettimeofday() it never jumps when
+ *     the wall clock is set or slewed, so differences are always valid.
+ *
+ * + RETURNS: uint64_t
+ *   - nanoseconds since an arbitrary fixed point
+ */
+uint64_t mono_now_ns(void);
+
+/* FUNCTION:    mono_elapsed_us
+ *
+ * + DESCRIPTION:
+ *   - returns the time passed since a mono_now_ns() timestamp
+ *
+ * + PARAMETERS:
+ *   + uint64_t start
+ *     - timestamp from mono_now_ns()
+ *
+ * + RETURNS: uint64_t
+ *   - microseconds elapsed
+ */
+uint64_t mono_elapsed_us(uint64_t start);
+
+/* FUNCTION:    mono_has_elapsed_us
+ *
+ * + DESCRIPTION:
+ *   - checks whether a timeout has expired
+ *
+ * + PARAMETERS:
+ *   + uint64_t start
+ *     - timestamp from mono_now_ns()
+ *   + uint64_t us
+ *     - timeout in microseconds
+ *
+ * + RETURNS: int
+ *   - non-zero once at least us microseconds have passed
+ */
+int mono_has_elapsed_us(uint64_t start, uint64_t us);
+
+/* FUNCTION:    mono_sleep_until
+ *
+ * + DESCRIPTION:
+ *   - blocks until the monotonic clock reaches a deadline, returns straight
+ *     away if it already has. sleeping to an absolute deadline rather than
+ *     for an interval keeps periodic loops from drifting by however long
+ *     each pass took.
+ *
+ * + PARAMETERS:
+ *   + uint64_t deadline
+ *     - mono_now_ns() value to wake at
+ */
+void mono_sleep_until(uint64_t deadline);
+
+/* FUNCTION:    mono_sleep_us
+ *
+ * + DESCRIPTION:
+ *   - blocks for an interval without spinning
+ *
+ * + PARAMETERS:
+ *   + uint64_t us
+ *     - microseconds to sleep
+ */
+void mono_sleep_us(uint64_t us);
+
+/* FUNCTION:    mono_cycles
+ *
+ * + DESCRIPTION:
+ *   - reads the cheapest fine grained counter available: the TSC on x86,
+ *     the virtual counter on arm64, mono_now_ns() anywhere else. only
+ *     differences are meaningful and only on the same machine.
+ *
+ * + RETURNS: uint64_t
+ *   - counter value
+ */
+uint64_t mono_cycles(void);
+
+/* FUNCTION:    mono_cycles_to_ns
+ *
+ * + DESCRIPTION:
+ *   - converts a mono_cycles() difference to nanoseconds. the counter rate
+ *     is calibrated against the monotonic clock on first call, which takes
+ *     a few milliseconds.
+ *
+ * + PARAMETERS:
+ *   + uint64_t cycles
+ *     - counter difference
+ *
+ * + RETURNS: uint64_t
+ *   - nanoseconds
+ */
+uint64_t mono_cycles_to_ns(uint64_t cycles);
+
+/* FUNCTION:    mono_timer_report
+ *
+ * + DESCRIPTION:
+ *   - logs the time since a scoped timer was started. called by the
+ *     compiler when a MONO_SCOPED_TIMER() goes out of scope. implemented
+ *     in logging.c, so only programs linking the logger can use it.
+ *
+ * + PARAMETERS:
+ *   + struct mono_timer *t
+ *     - timer to report
+ */
+void mono_timer_report(struct mono_timer *t);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* I__MONOTIME_H__ */
@@ -129,6 +129,17 @@
 #endif
 /******************************************************************************/
 
+/*******************************************************************************
+ * __aligned
+ * 	aligned attribute
+ */
+#ifndef __aligned
+#ifdef __GNUC__
+#define __aligned(x)	__attribute__((aligned(x)))
+#endif
+#endif
+/******************************************************************************/
+
 /*******************************************************************************
  * __unused
  * 	unused attribute
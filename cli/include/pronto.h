@@ -0,0 +1,136 @@
+/**
+ * COPYRIGHT 2024 Flirc, Inc. All rights reserved.
+ *
+ * This copyright notice is Copyright Management Information under 17 USC 1202
+ * and is included to protect this work and deter copyright infringement.
+ * Removal or alteration of this Copyright Management Information without
+ * the express written permission of Flirc, Inc. is prohibited, and any
+ * such unauthorized removal or alteration will be a violation of federal law.
+ *
+ * @file
+ * @brief   Pronto hex to and from raw timings
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifndef I__PRONTO_H__
+	#define I__PRONTO_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Pronto Format
+ * 	Four preamble words then the timings, all 16 bit:
+ *
+ * 	[0]  format, 0x0000 for a modulated code, 0x0100 for unmodulated
+ * 	[1]  carrier, as a period in units of the pronto clock
+ * 	[2]  mark/space pairs in the once sequence
+ * 	[3]  mark/space pairs in the repeat sequence
+ * 	[4-] the once sequence, then the repeat sequence, in carrier periods
+ *
+ * 	Only the learned formats are handled, not the predefined protocol
+ * 	ones (0x5000 and so on).
+ */
+#define PRONTO_CLOCK_HZ		4145146		/* 0.241246 us a tick */
+#define PRONTO_PREAMBLE		4
+#define PRONTO_MAX_TIMINGS	256
+#define PRONTO_MAX_WORDS	(PRONTO_PREAMBLE + PRONTO_MAX_TIMINGS)
+
+#define PRONTO_LEARNED		0x0000
+#define PRONTO_UNMODULATED	0x0100
+
+/****************************** Data Structures *****************************/
+/* Raw Code
+ * 	The timings of a pronto code in microseconds. Each sequence is mark,
+ * 	space pairs and so ends on the gap before whatever is sent next,
+ * 	which can be well over 16 bits worth of microseconds.
+ */
+struct pronto_raw {
+	uint32_t carrier;		/* Hz, 0 if unmodulated */
+	uint16_t once;			/* timings in the once sequence */
+	uint16_t repeat;		/* timings in the repeat sequence */
+	uint32_t buf[PRONTO_MAX_TIMINGS];	/* once, then repeat */
+};
+
+/* Batch Entry
+ * 	One code of a library handed to ir_pronto_to_raw_batch()
+ */
+struct pronto_code {
+	const uint16_t *words;
+	size_t len;
+};
+
+
+/******************************* API Functions ******************************/
+/* FUNCTION:    ir_pronto_to_raw
+ *
+ * + DESCRIPTION:
+ *   - converts a pronto code to microseconds. integer math only, each
+ *     timing is rounded to the nearest microsecond from the exact product
+ *     of its count and the carrier period rather than from a rounded
+ *     period, so long spaces don't pick up the period's rounding error.
+ *
+ * + PARAMETERS:
+ *   + const uint16_t *pronto
+ *     - the code, preamble first
+ *   + size_t len
+ *     - words in pronto, which must match the sequence lengths
+ *   + struct pronto_raw *raw
+ *     - filled in
+ *
+ * + RETURNS: int
+ *   - 0, or -1 if the code is malformed or in a format not handled
+ */
+int ir_pronto_to_raw(const uint16_t *pronto, size_t len,
+		struct pronto_raw *raw);
+
+/* FUNCTION:    ir_raw_to_pronto
+ *
+ * + DESCRIPTION:
+ *   - the reverse of ir_pronto_to_raw(). a carrier of 0 makes an
+ *     unmodulated code.
+ *
+ * + PARAMETERS:
+ *   + const struct pronto_raw *raw
+ *     - timings, each sequence an even number of them
+ *   + uint16_t *pronto
+ *     - receives the code
+ *   + size_t max
+ *     - room in pronto, in words
+ *
+ * + RETURNS: int
+ *   - words written, or -1 if the timings don't fit or can't be expressed
+ */
+int ir_raw_to_pronto(const struct pronto_raw *raw, uint16_t *pronto,
+		size_t max);
+
+/* FUNCTION:    ir_pronto_to_raw_batch
+ *
+ * + DESCRIPTION:
+ *   - converts a whole library in one call. a code that doesn't convert
+ *     is marked and the rest carry on. this is only a convenience wrapper
+ *     around ir_pronto_to_raw(), with no work shared between codes, and
+ *     costs the same per code as calling that in a loop. the carrier is
+ *     one division per code and the rest is per timing either way.
+ *
+ * + PARAMETERS:
+ *   + const struct pronto_code *codes
+ *     - the codes
+ *   + struct pronto_raw *raw
+ *     - one result per code, a code that fails gets zero length sequences
+ *   + size_t n
+ *     - number of codes
+ *
+ * + RETURNS: size_t
+ *   - codes converted
+ */
+size_t ir_pronto_to_raw_batch(const struct pronto_code *codes,
+		struct pronto_raw *raw, size_t n);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* I__PRONTO_H__ */
@@ -0,0 +1,150 @@
+/**
+ * COPYRIGHT 2024 Flirc, Inc. All rights reserved.
+ *
+ * This copyright notice is Copyright Management Information under 17 USC 1202
+ * and is included to protect this work and deter copyright infringement.
+ * Removal or alteration of this Copyright Management Information without
+ * the express written permission of Flirc, Inc. is prohibited, and any
+ * such unauthorized removal or alteration will be a violation of federal law.
+ *
+ * @file
+ * @brief   Instrumented IR transmit calls and usb counters
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <pronto.h>
+
+#ifndef I__TX_STATS_H__
+	#define I__TX_STATS_H__
+
+/* A transfer that failed with -LIBUSBERR never reached the device, so it is
+ * safe to send again. Timeouts are not retried, the device may well have
+ * transmitted and only the acknowledgement was lost.
+ */
+#ifndef TX_MAX_RETRIES
+#define TX_MAX_RETRIES		2
+#endif /* TX_MAX_RETRIES */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/****************************** Data Structures *****************************/
+/* Transmit Counters
+ * 	Cumulative since start up or the last tx_stats_reset(). Per call
+ * 	timings are kept in the tx.encode, tx.usb and tx.total histograms,
+ * 	which are registered for hist_print_all():
+ *
+ * 	tx.encode - host side work before the transfer, parsing a pattern
+ * 	            or encoding a scancode, as reported by the caller
+ * 	tx.usb    - the libflirc transmit call, i.e. usb submit and the
+ * 	            device's acknowledgement; retries included
+ * 	tx.total  - the two together
+ */
+struct tx_stats {
+	uint64_t calls;		/* transmit requests */
+	uint64_t sent;		/* requests the device accepted */
+	uint64_t bytes;		/* timing data handed to usb, retries too */
+	uint64_t retries;	/* transfers repeated after -LIBUSBERR */
+	uint64_t usb_errors;	/* -LIBUSBERR after the last retry */
+	uint64_t timeouts;	/* -ETIMEOUT */
+	uint64_t errors;	/* any other failure */
+	uint64_t usb_ns;	/* total time spent in the transmit call */
+	int last_error;		/* most recent failure code, 0 if none */
+};
+
+
+/******************************* API Functions ******************************/
+/* FUNCTION:    tx_raw
+ *
+ * + DESCRIPTION:
+ *   - fl_transmit_raw() with timing and counters. the signature matches,
+ *     so it can be handed to ir_register_tx() as is.
+ *
+ * + RETURNS: int
+ *   - same as fl_transmit_raw()
+ */
+int tx_raw(uint16_t *buf, uint16_t len, uint16_t ik, uint8_t repeat);
+
+/* FUNCTION:    tx_pronto
+ *
+ * + DESCRIPTION:
+ *   - flirc_send_pronto() with timing and counters
+ *
+ * + RETURNS: int
+ *   - same as flirc_send_pronto()
+ */
+int tx_pronto(uint16_t *buf, uint32_t len, uint8_t rep);
+
+/* FUNCTION:    tx_pronto_raw
+ *
+ * + DESCRIPTION:
+ *   - sends a pronto code already converted with ir_pronto_to_raw(), the
+ *     same way flirc_send_pronto() sends one: the once sequence if there
+ *     is one, then the repeat sequence rep times, or the once sequence
+ *     again if there's no repeat sequence. each sequence's last space is
+ *     its inter key delay, and is waited out before the next one goes.
+ *
+ * + PARAMETERS:
+ *   + const struct pronto_raw *raw
+ *     - the code
+ *   + uint8_t rep
+ *     - times to send the repeat sequence
+ *
+ * + RETURNS: int
+ *   - 0, or the error from fl_transmit_raw(), which stops the rest
+ */
+int tx_pronto_raw(const struct pronto_raw *raw, uint8_t rep);
+
+/* FUNCTION:    tx_stats_encode
+ *
+ * + DESCRIPTION:
+ *   - records how long the host spent preparing the next transmit. the
+ *     time is added to tx.encode straight away and to tx.total along with
+ *     the next transmit call.
+ *
+ * + PARAMETERS:
+ *   + uint64_t ns
+ *     - nanoseconds spent encoding
+ */
+void tx_stats_encode(uint64_t ns);
+
+/* FUNCTION:    tx_stats_get
+ *
+ * + DESCRIPTION:
+ *   - copies out the current counters
+ *
+ * + PARAMETERS:
+ *   + struct tx_stats *st
+ *     - filled in on return
+ */
+void tx_stats_get(struct tx_stats *st);
+
+/* FUNCTION:    tx_stats_reset
+ *
+ * + DESCRIPTION:
+ *   - zeroes the counters and the tx histograms
+ */
+void tx_stats_reset(void);
+
+/* FUNCTION:    tx_stats_print
+ *
+ * + DESCRIPTION:
+ *   - prints the counters, nothing if no transmit was made
+ *
+ * + PARAMETERS:
+ *   + FILE *fp
+ *     - stream to print to
+ *
+ * + RETURNS: int
+ *   - 1 if anything was printed, 0 otherwise
+ */
+int tx_stats_print(FILE *fp);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* I__TX_STATS_H__ */
@@ -0,0 +1,152 @@
+/**
+ * COPYRIGHT 2024 Flirc, Inc. All rights reserved.
+ *
+ * This copyright notice is Copyright Management Information under 17 USC 1202
+ * and is included to protect this work and deter copyright infringement.
+ * Removal or alteration of this Copyright Management Information without
+ * the express written permission of Flirc, Inc. is prohibited, and any
+ * such unauthorized removal or alteration will be a violation of federal law.
+ *
+ * @file
+ * @brief   Bump allocator for short lived, nested allocations
+ */
+
+#include <arena.h>
+#include <logging.h>
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ARENA_ALIGN		(sizeof(void *) > sizeof(uint64_t) ? \
+					sizeof(void *) : sizeof(uint64_t))
+#define ALIGN_UP(x, a)		(((x) + ((a) - 1)) & ~((a) - 1))
+
+struct arena_chunk {
+	struct arena_chunk *next;
+	size_t size;
+	size_t used;
+	uint64_t data[];
+};
+
+static struct arena_chunk *new_chunk(size_t size)
+{
+	struct arena_chunk *c;
+
+	if((c = malloc(sizeof(*c) + size)) == NULL) {
+		logerror("could not allocate arena chunk\n");
+		return NULL;
+	}
+
+	c->next = NULL;
+	c->size = size;
+	c->used = 0;
+
+	return c;
+}
+
+void arena_init(struct arena *a, size_t chunk_size)
+{
+	a->head = NULL;
+	a->cur = NULL;
+	a->chunk_size = chunk_size ? chunk_size : ARENA_DEFAULT_CHUNK;
+}
+
+void arena_destroy(struct arena *a)
+{
+	struct arena_chunk *c, *n;
+
+	for(c = a->head; c != NULL; c = n) {
+		n = c->next;
+		free(c);
+	}
+
+	a->head = NULL;
+	a->cur = NULL;
+}
+
+/* Moves to the next chunk that can hold size bytes. Spare chunks that are
+ * too small are dropped so the chain converges on chunks big enough for the
+ * workload.
+ */
+static struct arena_chunk *next_chunk(struct arena *a, size_t size)
+{
+	struct arena_chunk *prev = a->cur;
+	struct arena_chunk *c;
+	size_t csize;
+
+	while((c = prev ? prev->next : a->head) != NULL) {
+		if(c->size >= size) {
+			c->used = 0;
+			return c;
+		}
+		if(prev)
+			prev->next = c->next;
+		else
+			a->head = c->next;
+		free(c);
+	}
+
+	csize = a->chunk_size;
+	if(prev && (prev->size * 2) > csize)
+		csize = prev->size * 2;
+	if(size > csize)
+		csize = ALIGN_UP(size, ARENA_DEFAULT_CHUNK);
+
+	if((c = new_chunk(csize)) == NULL)
+		return NULL;
+
+	if(prev)
+		prev->next = c;
+	else
+		a->head = c;
+
+	return c;
+}
+
+void *arena_alloc(struct arena *a, size_t size)
+{
+	struct arena_chunk *c = a->cur;
+	void *p;
+
+	size = ALIGN_UP(size ? size : 1, ARENA_ALIGN);
+
+	if((c == NULL) || ((c->size - c->used) < size)) {
+		if((c = next_chunk(a, size)) == NULL)
+			return NULL;
+		a->cur = c;
+	}
+
+	p = (uint8_t *)c->data + c->used;
+	c->used += size;
+
+	return p;
+}
+
+char *arena_strdup(struct arena *a, const char *s)
+{
+	size_t len = strlen(s) + 1;
+	char *d;
+
+	if((d = arena_alloc(a, len)) != NULL)
+		memcpy(d, s, len);
+
+	return d;
+}
+
+struct arena_mark arena_mark(struct arena *a)
+{
+	struct arena_mark m;
+
+	m.chunk = a->cur;
+	m.used = a->cur ? a->cur->used : 0;
+
+	return m;
+}
+
+void arena_restore(struct arena *a, struct arena_mark m)
+{
+	a->cur = m.chunk;
+	if(m.chunk)
+		m.chunk->used = m.used;
+}
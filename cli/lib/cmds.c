@@ -36,6 +36,7 @@
  */
 
 #include <cmds.h>
+#include <arena.h>
 #include <prjutil.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -48,20 +49,128 @@
 
 LIST_HEAD(registered_cmds);
 
-static const struct cmd *lookup_cmd(const char *name,
-		struct list_head *cmd_list)
+/* Command Arena
+ * 	Everything needed to run one command line, the line copy, argv and the
+ * 	option dictionary, comes from this arena. Each run takes a mark and
+ * 	restores it when done, so nested runs (e.g. `script') stack and a
+ * 	long script reuses the same memory for every line.
+ */
+static struct arena cmd_arena = ARENA_INIT(ARENA_DEFAULT_CHUNK);
+
+/* Command Index
+ * 	Commands register themselves from constructors, one at a time and in
+ * 	link order. Rather than keeping the list sorted on every insert, the
+ * 	index is built once, on the first lookup after registration, as a
+ * 	sorted array searched with bsearch. Building it also sorts
+ * 	registered_cmds for `help' and fills in each command's option tables.
+ */
+static struct cmd_mgr **cmd_index;
+static size_t cmd_count;
+static int cmd_index_stale = 1;
+
+static int cmd_mgr_compare(const void *a, const void *b)
+{
+	const struct cmd_mgr *ca = *(const struct cmd_mgr * const *)a;
+	const struct cmd_mgr *cb = *(const struct cmd_mgr * const *)b;
+
+	return strcmp(ca->cmd->name, cb->cmd->name);
+}
+
+static int cmd_name_compare(const void *key, const void *elem)
+{
+	const struct cmd_mgr *c = *(const struct cmd_mgr * const *)elem;
+
+	return strcmp(key, c->cmd->name);
+}
+
+static int longopt_compare(const void *a, const void *b)
+{
+	const struct cmd_opt *oa = *(const struct cmd_opt * const *)a;
+	const struct cmd_opt *ob = *(const struct cmd_opt * const *)b;
+
+	return strcmp(oa->longopt, ob->longopt);
+}
+
+static void build_opt_tables(struct cmd_mgr *c)
+{
+	const struct cmd_opt *o;
+	unsigned int i, n = 0;
+
+	memset(c->shortopt, 0, sizeof(c->shortopt));
+	free(c->longopts);
+	c->longopts = NULL;
+	c->nlongopts = 0;
+
+	if(c->cmd->options == NULL)
+		return;
+
+	for(o = c->cmd->options, i = 0; o->name != NULL; o++, i++) {
+		unsigned char so = (unsigned char)o->shortopt;
+
+		/* the first definition wins, as with the old linear scan */
+		if(so && (so < ARRAY_SIZE(c->shortopt)) &&
+				!c->shortopt[so] && (i < UINT8_MAX))
+			c->shortopt[so] = i + 1;
+		if(o->longopt)
+			n++;
+	}
+
+	if(!n || (c->longopts = malloc(n * sizeof(*c->longopts))) == NULL)
+		return;
+
+	for(o = c->cmd->options; o->name != NULL; o++) {
+		if(o->longopt)
+			c->longopts[c->nlongopts++] = o;
+	}
+
+	qsort(c->longopts, c->nlongopts, sizeof(*c->longopts),
+			longopt_compare);
+}
+
+static int build_cmd_index(void)
 {
+	struct cmd_mgr **idx;
 	struct cmd_mgr *pos;
+	size_t i = 0;
 
-	list_for_each_entry(pos, cmd_list, node) {
-		if(strcmp(name, pos->cmd->name) == 0)
-			return pos->cmd;
+	if((idx = realloc(cmd_index, cmd_count * sizeof(*idx))) == NULL) {
+		logerror("could not allocate command index\n");
+		return -ENOMEM;
 	}
+	cmd_index = idx;
+
+	list_for_each_entry(pos, &registered_cmds, node) {
+		idx[i++] = pos;
+	}
+
+	qsort(idx, cmd_count, sizeof(*idx), cmd_mgr_compare);
+
+	/* relink in alphabetical order */
+	INIT_LIST_HEAD(&registered_cmds);
+	for(i = 0; i < cmd_count; i++) {
+		list_add_tail(&idx[i]->node, &registered_cmds);
+		build_opt_tables(idx[i]);
+	}
+
+	cmd_index_stale = 0;
+
+	return 0;
+}
+
+static struct cmd_mgr *lookup_cmd(const char *name)
+{
+	struct cmd_mgr **c;
+
+	if(cmd_index_stale && (build_cmd_index() < 0))
+		return NULL;
+
+	c = bsearch(name, cmd_index, cmd_count, sizeof(*cmd_index),
+			cmd_name_compare);
 
-	return NULL;
+	return c ? *c : NULL;
 }
 
-static int tokenize_cmd_string(char *argstr, char **argv, size_t max_args)
+int tokenize_cmd_line(char *argstr, char **argv, size_t max_args)
 {
 	size_t argc, i;
 	size_t slen = strlen(argstr);
@@ -115,36 +224,50 @@ static int tokenize_cmd_string(char *argstr, char **argv, size_t max_args)
 	return (int)argc;
 }
 
-static const struct cmd_opt *findlongopt(const struct cmd *cmd_entry,
-		const char *longopt)
+/* Long options are looked up straight out of argv, so the key is the option
+ * name up to an optional '=' rather than a terminated string.
+ */
+struct longopt_key {
+	const char *name;
+	size_t len;
+};
+
+static int longopt_key_compare(const void *key, const void *elem)
 {
-	const struct cmd_opt *o;
+	const struct longopt_key *k = key;
+	const struct cmd_opt *o = *(const struct cmd_opt * const *)elem;
+	int r;
+
+	if((r = strncmp(k->name, o->longopt, k->len)) != 0)
+		return r;
+
+	return o->longopt[k->len] ? -1 : 0;
+}
 
-	if(cmd_entry->options == NULL)
+static const struct cmd_opt *findlongopt(const struct cmd_mgr *c,
+		const char *longopt, size_t len)
+{
+	const struct cmd_opt **o;
+	struct longopt_key k = { longopt, len };
+
+	if(c->nlongopts == 0)
 		return NULL;
 
-	for(o = cmd_entry->options; o->name != NULL; o++) {
-		if(o->longopt && (strcmp(o->longopt, &longopt[2]) == 0))
-			return o;
-	}
+	o = bsearch(&k, c->longopts, c->nlongopts, sizeof(*c->longopts),
+			longopt_key_compare);
 
-	return NULL;
+	return o ? *o : NULL;
 }
 
-static const struct cmd_opt *findshortopt(const struct cmd *cmd_entry,
+static const struct cmd_opt *findshortopt(const struct cmd_mgr *c,
 		char shortopt)
 {
-	const struct cmd_opt *o;
+	unsigned char so = (unsigned char)shortopt;
 
-	if(cmd_entry->options == NULL)
+	if((so >= ARRAY_SIZE(c->shortopt)) || !c->shortopt[so])
 		return NULL;
 
-	for(o = cmd_entry->options; o->name != NULL; o++) {
-		if(o->shortopt == shortopt)
-			return o;
-	}
-
-	return NULL;
+	return &c->cmd->options[c->shortopt[so] - 1];
 }
 
 static inline void addopt(const struct cmd_opt *opt, struct dictionary *optdict,
@@ -154,65 +277,53 @@ static inline void addopt(const struct cmd_opt *opt, struct dictionary *optdict,
 	dict_add_key(optdict, opt->name, val, val_len);
 }
 
-static void handle_longopt(const struct cmd *cmd_entry, struct dictionary *od,
+static void handle_longopt(const struct cmd_mgr *c, struct dictionary *od,
 		int argc, const char **argv, unsigned int *carg)
 {
 	const struct cmd_opt *opt;
-	char *optstr = strdup(argv[*carg]);
-	char *val = NULL;
-	int i;
-
-	if(optstr == NULL) {
-		logerror("%s\n", strerror(errno));
-		return;
-	}
+	const char *optstr = &argv[*carg][2];
+	const char *val = strchr(optstr, '=');
+	size_t len = val ? (size_t)(val - optstr) : strlen(optstr);
 
 	/* Look for an = sign to separate opt from value */
-	for(i = 0; i < strlen(optstr); i++) {
-		if(optstr[i] == '=') {
-			optstr[i] = '\0';
-			val = &optstr[i + 1];
-			break;
-		}
-	}
+	if(val)
+		val++;
 
-	if((opt = findlongopt(cmd_entry, optstr)) == NULL) {
-		logwarn("`%s' doesn not take '%s' option\n", cmd_entry->name,
-				optstr);
+	if((opt = findlongopt(c, optstr, len)) == NULL) {
+		logwarn("`%s' doesn not take '--%.*s' option\n", c->cmd->name,
+				(int)len, optstr);
 	} else {
 		addopt(opt, od, val);
 	}
-
-	free(optstr);
 }
 
-static void handle_shortopt(const struct cmd *cmd_entry, struct dictionary *od,
+static void handle_shortopt(const struct cmd_mgr *c, struct dictionary *od,
 		int argc, const char **argv, unsigned int *carg)
 {
 	const struct cmd_opt *opt;
 	int i;
 
-	for(i = 1; i < strlen(argv[*carg]); i++) {
-		if((opt = findshortopt(cmd_entry, argv[*carg][i])) == NULL) {
+	for(i = 1; argv[*carg][i] != '\0'; i++) {
+		if((opt = findshortopt(c, argv[*carg][i])) == NULL) {
 			logwarn("`%s' doesn not take '-%c' option\n",
-					cmd_entry->name, argv[*carg][i]);
+					c->cmd->name, argv[*carg][i]);
 		} else {
 			addopt(opt, od, NULL);
 		}
 	}
 }
 
-static struct dictionary *cmd_getopt(const struct cmd *cmd_entry,
+static struct dictionary *cmd_getopt(const struct cmd_mgr *c,
 		int argc, const char **argv, unsigned int *carg)
 {
 	struct dictionary *od;
 
-	if((od = new_dict()) == NULL) {
+	if((od = new_dict_arena(&cmd_arena)) == NULL) {
 		return NULL;
 	}
 
 	for(;(*carg < argc) && argv[*carg][0] == '-'; (*carg)++) {
-		if(strlen(argv[*carg]) < 2) {
+		if(argv[*carg][1] == '\0') {
 			/* A single - is most likely an argument denoting
 			 * 'stdin'. We should stop processing opts.
 			 */
@@ -222,10 +333,10 @@ static struct dictionary *cmd_getopt(const struct cmd *cmd_entry,
 		logverbose("opt: %s, carg = %d\n", argv[*carg], *carg);
 		if(argv[*carg][1] == '-') {
 			/* Handle Long Opt */
-			handle_longopt(cmd_entry, od, argc, argv, carg);
+			handle_longopt(c, od, argc, argv, carg);
 		} else {
 			/* Handle Short Opts */
-			handle_shortopt(cmd_entry, od, argc, argv, carg);
+			handle_shortopt(c, od, argc, argv, carg);
 		}
 	}
 
@@ -237,29 +348,34 @@ int run_cmds(int argc, const char **argv, void *appdata)
 	unsigned int carg = 0;
 	int ret = 0;
 	struct dictionary *opts;
+	struct arena_mark m;
 
 	/* loop over all argv entries */
 	while(carg < argc) {
-		const struct cmd *cmd_entry =
-			lookup_cmd(argv[carg++], &registered_cmds);
-		if(cmd_entry == NULL) {
+		const struct cmd_mgr *c = lookup_cmd(argv[carg++]);
+		const struct cmd *cmd_entry;
+		if(c == NULL) {
 			logerror("could not find command '%s'\n",
 					argv[carg-1]);
 			return -ENOSYS;
 		}
+		cmd_entry = c->cmd;
 		logverbose("running command: %s\n", cmd_entry->name);
 
-		if((opts = cmd_getopt(cmd_entry, argc, argv, &carg)) == NULL) {
+		m = arena_mark(&cmd_arena);
+		if((opts = cmd_getopt(c, argc, argv, &carg)) == NULL) {
 			logerror("could not create option dictionary\n");
+			arena_restore(&cmd_arena, m);
 			return -ENOMEM;
 		}
 
 		/* call the command handler */
-		if((ret = (cmd_entry->handler)(argc-carg, &argv[carg],
-						cmd_entry, appdata, opts)) < 0)
+		ret = (cmd_entry->handler)(argc-carg, &argv[carg], cmd_entry,
+				appdata, opts);
+		arena_restore(&cmd_arena, m);
+		if(ret < 0)
 			return carg;
 		carg += ret;
-		delete_dict(opts);
 	}
 
 	return 0;
@@ -269,28 +385,97 @@ int run_cmd(const char *name, int argc, const char **argv, void *appdata)
 {
 	struct dictionary *opts;
 	unsigned int carg = 0;
-	const struct cmd *cmd_entry = lookup_cmd(name, &registered_cmds);
-	if(cmd_entry == NULL) {
+	const struct cmd *cmd_entry;
+	const struct cmd_mgr *c = lookup_cmd(name);
+	struct arena_mark m;
+	int status = 0;
+	if(c == NULL) {
 		logerror("could not find command '%s'\n", name);
 		return -ENOSYS;
 	}
+	cmd_entry = c->cmd;
 
 	logverbose("running command: %s\n", cmd_entry->name);
 
-	if((opts = cmd_getopt(cmd_entry, argc, argv, &carg)) == NULL) {
+	m = arena_mark(&cmd_arena);
+	if((opts = cmd_getopt(c, argc, argv, &carg)) == NULL) {
 		logerror("could not create option dictionary\n");
-		return -ENOMEM;
+		status = -ENOMEM;
+		goto exit;
 	}
 
 	/* call the command handler */
 	if((cmd_entry->handler)(argc-carg, &argv[carg], cmd_entry, appdata,
-				opts) < 0) {
-		delete_dict(opts);
-		return 1;
+				opts) < 0)
+		status = 1;
+
+exit:
+	arena_restore(&cmd_arena, m);
+	return status;
+}
+
+int run_cmd_batch(const char *name, struct cmd_call *calls, int ncalls,
+		void *appdata)
+{
+	const struct cmd *cmd_entry;
+	const struct cmd_mgr *c = lookup_cmd(name);
+	struct arena_mark m;
+	int i, status = 0;
+	if(c == NULL) {
+		logerror("could not find command '%s'\n", name);
+		return -ENOSYS;
 	}
-	delete_dict(opts);
+	cmd_entry = c->cmd;
 
-	return 0;
+	logverbose("running command: %s x%d\n", cmd_entry->name, ncalls);
+
+	m = arena_mark(&cmd_arena);
+	for(i = 0; i < ncalls; i++) {
+		unsigned int carg = 0;
+
+		if((calls[i].opts = cmd_getopt(c, calls[i].argc,
+					calls[i].argv, &carg)) == NULL) {
+			logerror("could not create option dictionary\n");
+			status = -ENOMEM;
+			goto exit;
+		}
+		calls[i].argc -= carg;
+		calls[i].argv += carg;
+		calls[i].status = 0;
+	}
+
+	if(cmd_entry->batch) {
+		if((cmd_entry->batch)(calls, ncalls, cmd_entry, appdata) < 0) {
+			status = -EIO;
+			goto exit;
+		}
+	} else {
+		for(i = 0; i < ncalls; i++) {
+			calls[i].status = (cmd_entry->handler)(calls[i].argc,
+					calls[i].argv, cmd_entry, appdata,
+					calls[i].opts);
+			if(calls[i].status < 0)
+				break;
+		}
+	}
+
+	for(i = 0; i < ncalls; i++) {
+		if(calls[i].status < 0) {
+			status = i + 1;
+			break;
+		}
+	}
+
+exit:
+	arena_restore(&cmd_arena, m);
+	return status;
+}
+
+int cmd_can_batch(const char *name)
+{
+	const struct cmd_mgr *c = lookup_cmd(name);
+
+	return (c && c->cmd->batch) ? 1 : 0;
 }
 
 int run_cmd_line(const char *cmd_line, void *appdata)
@@ -299,20 +484,21 @@ int run_cmd_line(const char *cmd_line, void *appdata)
 	char *s;
 	int argc;
 	char **argv;
+	struct arena_mark m = arena_mark(&cmd_arena);
 
-	if((s = malloc(strlen(cmd_line) + 1)) == NULL) {
-		logerror("could not allocate command line buffer");
+	if((s = arena_strdup(&cmd_arena, cmd_line)) == NULL) {
+		logerror("could not allocate command line buffer\n");
 		status = -ENOMEM;
-		goto exit1;
+		goto exit;
 	}
-	if((argv = malloc(CMDS_MAX_ARGUMENTS * sizeof(argv[0]))) == NULL) {
-		logerror("could not allocate argv");
+	if((argv = arena_alloc(&cmd_arena,
+			CMDS_MAX_ARGUMENTS * sizeof(argv[0]))) == NULL) {
+		logerror("could not allocate argv\n");
 		status = -ENOMEM;
-		goto exit2;
+		goto exit;
 	}
-	strcpy(s, cmd_line);
 
-	argc = tokenize_cmd_string(s, argv, CMDS_MAX_ARGUMENTS);
+	argc = tokenize_cmd_line(s, argv, CMDS_MAX_ARGUMENTS);
 
 	if(argc) {
 		status = run_cmd(argv[0], argc - 1, (const char **)&argv[1],
@@ -322,37 +508,30 @@ int run_cmd_line(const char *cmd_line, void *appdata)
 		status = -EINVAL;
 	}
 
-	free(argv);
-exit2:
-	free(s);
-exit1:
+exit:
+	arena_restore(&cmd_arena, m);
 	return status;
 }
 
 void _register_cmd(struct cmd_mgr *rcmd)
 {
-	struct cmd_mgr *pos;
-
-	/* add command in alphabetical order */
-	list_for_each_entry(pos, &registered_cmds, node) {
-		if(strcmp(rcmd->cmd->name, pos->cmd->name) <= 0) {
-			list_add_tail(&rcmd->node, &pos->node);
-			return;
-		}
-	}
+	/* ordering is taken care of when the index is (re)built */
 	list_add_tail(&rcmd->node, &registered_cmds);
+	cmd_count++;
+	cmd_index_stale = 1;
 }
 
 CMDHANDLER(help)
 {
 	if(argc > 0) {
 		const struct cmd_opt *o;
-		const struct cmd *cmd_entry = lookup_cmd(argv[0],
-				&registered_cmds);
-		if(cmd_entry == NULL) {
+		const struct cmd_mgr *c = lookup_cmd(argv[0]);
+		const struct cmd *cmd_entry;
+		if(c == NULL) {
 			pcmderr("command `%s' not found.\n", argv[0]);
 			return -1;
 		}
+		cmd_entry = c->cmd;
 		printf("Help for `%s' command:\n", cmd_entry->name);
 		printf("%s\n", cmd_entry->help);
 		if(cmd_entry->options) {
@@ -376,6 +555,10 @@ CMDHANDLER(help)
 		struct cmd_mgr *pos;
 		int j;
 
+		/* make sure the list is sorted */
+		if(cmd_index_stale)
+			build_cmd_index();
+
 		printf("Commands:\n");
 		list_for_each_entry(pos, &registered_cmds, node) {
 			printf("  %s ", pos->cmd->name);
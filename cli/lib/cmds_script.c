@@ -36,67 +36,328 @@
  */
 
 #include <cmds.h>
-#include <getline.h>
+#include <monotime.h>
+#include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
-#ifndef CMDS_SCRIPT_LINE_LENGTH
-#define CMDS_SCRIPT_LINE_LENGTH		1024
-#endif /* CMDS_SCRIPT_LINE_LENGTH */
+#ifndef CMDS_MAX_ARGUMENTS
+#define CMDS_MAX_ARGUMENTS		64
+#endif /* CMDS_MAX_ARGUMENTS */
+
+#define SCRIPT_READ_CHUNK		(64 * 1024)
+
+/* Scripts are read in one go and tokenized up front. Each line keeps its
+ * arguments as a slice of a single pointer pool, which lets consecutive
+ * lines for a command with a batch handler be handed over together.
+ */
+struct script_line {
+	unsigned int lineno;
+	int argc;
+	size_t arg;		/* index of argv[0] in script.args */
+	double ms;		/* run time, for --timing */
+};
+
+struct script {
+	char *buf;
+	struct script_line *lines;
+	size_t nlines;
+	char **args;
+	size_t nargs;
+};
+
+static double now_ms(void)
+{
+	return mono_now_ns() / 1000000.0;
+}
+
+static char *read_script(FILE *fp)
+{
+	char *buf = NULL, *n;
+	size_t len = 0, cap = 0, r;
+
+	do {
+		if((cap - len) < SCRIPT_READ_CHUNK) {
+			cap = cap ? cap * 2 : SCRIPT_READ_CHUNK;
+			if((n = realloc(buf, cap + 1)) == NULL) {
+				free(buf);
+				return NULL;
+			}
+			buf = n;
+		}
+		r = fread(&buf[len], 1, cap - len, fp);
+		len += r;
+	} while(r > 0);
+
+	if(ferror(fp)) {
+		free(buf);
+		return NULL;
+	}
+
+	buf[len] = '\0';
+	return buf;
+}
+
+static int add_line(struct script *sc, size_t *lcap, size_t *acap,
+		unsigned int lineno, char **argv, int argc)
+{
+	void *n;
+
+	if(sc->nlines == *lcap) {
+		*lcap = *lcap ? *lcap * 2 : 256;
+		if((n = realloc(sc->lines, *lcap * sizeof(*sc->lines))) == NULL)
+			return -1;
+		sc->lines = n;
+	}
+	if((sc->nargs + argc + 1) > *acap) {
+		while((sc->nargs + argc + 1) > *acap)
+			*acap = *acap ? *acap * 2 : 1024;
+		if((n = realloc(sc->args, *acap * sizeof(*sc->args))) == NULL)
+			return -1;
+		sc->args = n;
+	}
+
+	sc->lines[sc->nlines].lineno = lineno;
+	sc->lines[sc->nlines].argc = argc;
+	sc->lines[sc->nlines].arg = sc->nargs;
+	sc->lines[sc->nlines].ms = 0;
+	sc->nlines++;
+
+	/* keep the NULL terminator, handlers may rely on it */
+	memcpy(&sc->args[sc->nargs], argv, (argc + 1) * sizeof(*argv));
+	sc->nargs += argc + 1;
+
+	return 0;
+}
+
+static int parse_script(struct script *sc)
+{
+	char *argv[CMDS_MAX_ARGUMENTS];
+	size_t lcap = 0, acap = 0;
+	unsigned int lineno = 1;
+	char *p = sc->buf;
+	char *line, *eol;
+	int argc;
+
+	while(*p) {
+		line = p;
+		eol = line + strcspn(line, "\r\n");
+
+		/* step over the line ending, treating \r\n and \n\r as one */
+		p = eol;
+		if(*p) {
+			if((p[1] == '\r' || p[1] == '\n') && (p[1] != p[0]))
+				p++;
+			p++;
+		}
+		*eol = '\0';
+
+		if(line[0] != '#') {
+			argc = tokenize_cmd_line(line, argv, ARRAY_SIZE(argv));
+			if(argc && (add_line(sc, &lcap, &acap, lineno,
+						argv, argc) < 0))
+				return -1;
+		}
+		lineno++;
+	}
+
+	return 0;
+}
+
+static void free_script(struct script *sc)
+{
+	free(sc->args);
+	free(sc->lines);
+	free(sc->buf);
+}
+
+static void print_timing(const struct script *sc, size_t ran, double total)
+{
+	const struct script_line *slow = NULL;
+	size_t i;
+
+	printf("%8s %12s  %s\n", "line", "ms", "command");
+	for(i = 0; i < ran; i++) {
+		const struct script_line *l = &sc->lines[i];
+
+		printf("%8u %12.3f  %s\n", l->lineno, l->ms,
+				sc->args[l->arg]);
+		if(!slow || (l->ms > slow->ms))
+			slow = l;
+	}
+
+	printf("\n%zu lines in %.3f ms", ran, total);
+	if(ran)
+		printf(", %.3f ms/line, slowest #%u (%.3f ms)",
+				total / ran, slow->lineno, slow->ms);
+	printf("\n");
+}
+
+/* Runs lines [first, last) of the same batchable command together. A batch
+ * stops at the first line that fails, as the lines would one at a time, and
+ * with keep_going the rest run as a new batch. Failed lines are reported,
+ * and the number of them returned; *end is set past the last line run.
+ */
+static unsigned int run_batch(struct script *sc, size_t first, size_t last,
+		struct cmd_call *calls, void *appdata, int keep_going,
+		size_t *end)
+{
+	const char *name = sc->args[sc->lines[first].arg];
+	unsigned int failed = 0;
+	size_t i, n, ran;
+	double t0, ms;
+	int ret;
+
+	for(; first < last; first += ran) {
+		n = last - first;
+		for(i = 0; i < n; i++) {
+			const struct script_line *l = &sc->lines[first + i];
+
+			calls[i].argc = l->argc - 1;
+			calls[i].argv = (const char **)&sc->args[l->arg + 1];
+			calls[i].status = 0;
+		}
+
+		t0 = now_ms();
+		ret = run_cmd_batch(name, calls, n, appdata);
+		ran = (ret > 0) ? (size_t)ret : n;
+		ms = (now_ms() - t0) / ran;
+
+		for(i = 0; i < ran; i++)
+			sc->lines[first + i].ms = ms;
+
+		/* no one line is to blame if the handler failed as a whole
+		 * or the framework did, the whole batch counts as failed */
+		if(ret < 0) {
+			if(ret == -EIO)
+				logerror("script: %s failed on a batch of %zu "
+						"lines\n", name, n);
+			else
+				logerror("script: an error occured with lines "
+						"#%u-#%u\n",
+						sc->lines[first].lineno,
+						sc->lines[last - 1].lineno);
+			failed += n;
+			first = last;
+			break;
+		}
+
+		if(ret > 0) {
+			logerror("script: an error occured with line #%u\n",
+					sc->lines[first + ret - 1].lineno);
+			failed++;
+			if(!keep_going) {
+				first += ran;
+				break;
+			}
+		}
+	}
+
+	*end = first;
+	return failed;
+}
 
 CMDHANDLER(script_handler)
 {
-	int status = 1;
-	char *line;
-	ssize_t len;
-	int line_num = 1;
+	struct script sc = { 0 };
+	struct cmd_call *calls = NULL;
 	FILE *fp = stdin;
+	int keep_going = dict_has_key(opts, "continue");
+	int timing = dict_has_key(opts, "timing");
+	unsigned int errors = 0;
+	double start;
+	size_t i, j;
+	int status = 1;
 
 	/* check arguments */
 	if(!argc) {
 		pcmderr("no file specified\n");
-		status = -1;
-		goto exit1;
+		return -1;
 	}
 	/* try and open script file */
 	if(strcmp(argv[0], "-") != 0) {
-		if((fp = fopen(argv[0], "r")) == NULL) {
+		if((fp = fopen(argv[0], "rb")) == NULL) {
 			perror("could not open script file");
-			status = -1;
-			goto exit1;
+			return -1;
 		}
 	}
-	/* allocate line buffer */
-	if((line = malloc(CMDS_SCRIPT_LINE_LENGTH)) == NULL) {
-		perror("could not allocate line buffer");
+
+	sc.buf = read_script(fp);
+	if(fp != stdin)
+		fclose(fp);
+	if(sc.buf == NULL) {
+		pcmderr("could not read script\n");
+		return -1;
+	}
+
+	if((parse_script(&sc) < 0) ||
+			(calls = calloc(sc.nlines + 1, sizeof(*calls))) == NULL) {
+		pcmderr("could not allocate script\n");
 		status = -1;
-		goto exit2;
+		goto exit;
 	}
 
 	/* loop through lines */
-	while((len = fgetline(fp, line, CMDS_SCRIPT_LINE_LENGTH)) >= 0) {
-		if((len > 0) && (line[0] != '#')) {
-			if(run_cmd_line(line, appdata) != 0) {
-				pcmderr("an error occured with line #%d\n",
-						line_num);
-				status = -1;
-				break;
+	start = now_ms();
+	for(i = 0, j = 0; i < sc.nlines; i = j) {
+		const struct script_line *l = &sc.lines[i];
+		const char *name = sc.args[l->arg];
+		unsigned int failed = 0;
+
+		/* group consecutive lines for commands that can batch */
+		j = i + 1;
+		if(cmd_can_batch(name)) {
+			while((j < sc.nlines) &&
+				(strcmp(sc.args[sc.lines[j].arg], name) == 0))
+				j++;
+		}
+
+		if(j - i > 1) {
+			failed = run_batch(&sc, i, j, calls, appdata,
+					keep_going, &j);
+		} else {
+			double t0 = now_ms();
+			if(run_cmd(name, l->argc - 1,
+					(const char **)&sc.args[l->arg + 1],
+					appdata) != 0) {
+				pcmderr("an error occured with line #%u\n",
+						l->lineno);
+				failed = 1;
 			}
+			sc.lines[i].ms = now_ms() - t0;
+		}
+
+		if(failed) {
+			errors += failed;
+			status = -1;
+			if(!keep_going)
+				break;
 		}
-		line_num++;
 	}
 
-	/* clean up and exit */
-	free(line);
-exit2:
-	if(fp != stdin)
-		fclose(fp);
-exit1:
+	if(timing)
+		print_timing(&sc, j < sc.nlines ? j : sc.nlines,
+				now_ms() - start);
+	if(errors && keep_going)
+		pcmderr("%u line(s) failed\n", errors);
+
+exit:
+	free(calls);
+	free_script(&sc);
 	return status;
 }
-APPCMD(script, &script_handler,
+
+START_CMD_OPTS(script_opts)
+	CMD_OPT(continue, 'k', "continue-on-error",
+			"keep going after a line fails")
+	CMD_OPT(timing, 't', "timing", "report the time taken by each line")
+END_CMD_OPTS;
+
+APPCMD_OPT(script, &script_handler,
 	"run a command script",
-	"usage: script <file>\n"
-	"  a - for <file> will read from stdin",
-	NULL);
+	"usage: script [opts] <file>\n"
+	"  a - for <file> will read from stdin\n"
+	"  consecutive lines for commands that support it (e.g. delete_index)\n"
+	"  are sent to the device as a single batch",
+	NULL, script_opts);
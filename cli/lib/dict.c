@@ -39,183 +39,384 @@
 #include <stdio.h>
 #include <errno.h>
 
+/* grow when the table is more than 3/4 full */
+#define DICT_MAX_LOAD(size)	(((size) >> 1) + ((size) >> 2))
+
+/******************************** Hashing ***********************************/
+/* wyhash (final version 4), by Wang Yi, released into the public domain.
+ * Fast on short keys, which is almost everything stored here, and passes
+ * SMHasher. The 64x64->128 multiply falls back to 32 bit halves where the
+ * compiler has no 128 bit type (e.g. 32 bit mingw).
+ */
+static inline void wymum(uint64_t *a, uint64_t *b)
+{
+#if defined(__SIZEOF_INT128__)
+	__uint128_t r = *a;
+	r *= *b;
+	*a = (uint64_t)r;
+	*b = (uint64_t)(r >> 64);
+#else
+	uint64_t ha = *a >> 32, hb = *b >> 32;
+	uint64_t la = (uint32_t)*a, lb = (uint32_t)*b;
+	uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+	uint64_t t = rl + (rm0 << 32), c = t < rl, lo, hi;
+	lo = t + (rm1 << 32);
+	c += lo < t;
+	hi = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+	*a = lo;
+	*b = hi;
+#endif
+}
+
+static inline uint64_t wymix(uint64_t a, uint64_t b)
+{
+	wymum(&a, &b);
+	return a ^ b;
+}
+
+static inline uint64_t wyr8(const uint8_t *p)
+{
+	uint64_t v;
+	memcpy(&v, p, 8);
+	return v;
+}
+
+static inline uint64_t wyr4(const uint8_t *p)
+{
+	uint32_t v;
+	memcpy(&v, p, 4);
+	return v;
+}
 
-static inline int compute_hash(const char *key)
+static inline uint64_t wyr3(const uint8_t *p, size_t k)
 {
-	int h = 0, i = 1;
-	while(*key) {
-		h += ((int)(*key++) * 7 * i++);
+	return (((uint64_t)p[0]) << 16) | (((uint64_t)p[k >> 1]) << 8) |
+		p[k - 1];
+}
+
+uint64_t dict_hash(const void *key, size_t len)
+{
+	static const uint64_t s[4] = {
+		0xa0761d6478bd642full, 0xe7037ed1a0b428dbull,
+		0x8ebc6af09c88c6e3ull, 0x589965cc75374cc3ull
+	};
+	const uint8_t *p = key;
+	uint64_t seed = s[0], a, b;
+
+	if(len <= 16) {
+		if(len >= 4) {
+			a = (wyr4(p) << 32) | wyr4(p + ((len >> 3) << 2));
+			b = (wyr4(p + len - 4) << 32) |
+				wyr4(p + len - 4 - ((len >> 3) << 2));
+		} else if(len > 0) {
+			a = wyr3(p, len);
+			b = 0;
+		} else {
+			a = b = 0;
+		}
+	} else {
+		size_t i = len;
+		if(i > 48) {
+			uint64_t see1 = seed, see2 = seed;
+			do {
+				seed = wymix(wyr8(p) ^ s[1],
+						wyr8(p + 8) ^ seed);
+				see1 = wymix(wyr8(p + 16) ^ s[2],
+						wyr8(p + 24) ^ see1);
+				see2 = wymix(wyr8(p + 32) ^ s[3],
+						wyr8(p + 40) ^ see2);
+				p += 48;
+				i -= 48;
+			} while(i > 48);
+			seed ^= see1 ^ see2;
+		}
+		while(i > 16) {
+			seed = wymix(wyr8(p) ^ s[1], wyr8(p + 8) ^ seed);
+			i -= 16;
+			p += 16;
+		}
+		a = wyr8(p + i - 16);
+		b = wyr8(p + i - 8);
 	}
-	return h % DICT_HASH_SIZE;
+
+	a ^= s[1];
+	b ^= seed;
+	wymum(&a, &b);
+
+	return wymix(a ^ s[0] ^ len, b ^ s[1]);
 }
 
-struct dictionary *new_dict(void)
+/* Slot hashes are never 0, that marks an empty slot. */
+static inline uint32_t slot_hash(const char *key, size_t len)
 {
-	struct dictionary *d;
+	uint32_t h = (uint32_t)dict_hash(key, len);
+	return h ? h : 1;
+}
 
-	if((d = malloc(sizeof(*d))) == NULL) {
-		logerror("could not allocate new dictionary : %s\n",
-				strerror(errno));
+/****************************** Table Handling ******************************/
+static struct kvpair_mgr *alloc_table(struct dictionary *dict, uint32_t size)
+{
+	struct kvpair_mgr *t;
+
+	if(dict->arena)
+		t = arena_alloc(dict->arena, size * sizeof(*t));
+	else
+		t = malloc(size * sizeof(*t));
+	if(t == NULL) {
+		logerror("could not allocate dictionary table\n");
 		return NULL;
 	}
 
-	memset(d, 0, sizeof(*d));
+	memset(t, 0, size * sizeof(*t));
 
-	return d;
+	return t;
 }
 
-void delete_dict(struct dictionary *dict)
+static void free_table(struct dictionary *dict)
 {
-	int i;
+	if(dict->arena == NULL)
+		free(dict->table);
+	dict->table = NULL;
+}
 
-	for(i = 0; i < DICT_HASH_SIZE; i++) {
-		struct kvpair_mgr *kvm;
-		struct hlist_node *n, *t;
+static int init_dict(struct dictionary *dict, struct arena *arena)
+{
+	memset(dict, 0, sizeof(*dict));
+	dict->arena = arena;
 
-		hlist_for_each_entry_safe(kvm, n, t, &dict->kvtable[i], node) {
-			hlist_del(n);
-			delete_kvpair_mgr(kvm);
-			dict->entries--;
-		}
+	if((dict->table = alloc_table(dict, DICT_HASH_SIZE)) == NULL)
+		return -1;
+	dict->mask = DICT_HASH_SIZE - 1;
+
+	return 0;
+}
+
+static int grow_table(struct dictionary *dict)
+{
+	struct kvpair_mgr *old = dict->table;
+	uint32_t i, j, oldsize = dict->mask + 1;
+	uint32_t mask = (oldsize << 1) - 1;
+	struct kvpair_mgr *t;
+
+	if((t = alloc_table(dict, mask + 1)) == NULL)
+		return -1;
+
+	for(i = 0; i < oldsize; i++) {
+		if(!old[i].hash)
+			continue;
+		for(j = old[i].hash & mask; t[j].hash; j = (j + 1) & mask)
+			;
+		t[j] = old[i];
 	}
 
-	if(dict->entries != 0)
-		logwarn("dict->entries non-zero on free\n");
+	free_table(dict);
+	dict->table = t;
+	dict->mask = mask;
 
-	free(dict);
+	return 0;
 }
 
-struct kvpair *new_kvpair(const char *key, const void *value, size_t size)
+static struct kvpair_mgr *find_slot(struct dictionary *dict, uint32_t hash,
+		const char *key, size_t keylen)
 {
-	struct kvpair *kvp;
-	/* key size + null termination */
-	uint32_t keylen = strlen(key) + 1;
-	/* size of key + null termination + value data size */
-	uint32_t kvsize = keylen + size;
-
-	if((kvp = malloc(sizeof(struct kvpair) + kvsize)) == NULL) {
-		logerror("could not allocate new key/value : %s\n",
-				strerror(errno));
-		return NULL;
+	struct kvpair_mgr *t = dict->table;
+	uint32_t i;
+
+	for(i = hash & dict->mask; t[i].hash; i = (i + 1) & dict->mask) {
+		if((t[i].hash == hash) && (t[i].keylen == keylen) &&
+				(memcmp(kvpair_key(t[i].kvp), key,
+					keylen) == 0))
+			return &t[i];
 	}
 
-	kvp->kvsize = kvsize;
-	kvp->voffset = keylen;
-
-	strcpy((char *)&kvp->kv[0], key);
-	memcpy(kvpair_value(kvp, NULL), value, size);
+	return NULL;
+}
 
-	return kvp;
+static inline void release_slot(struct kvpair_mgr *kvm)
+{
+	if(kvm->free)
+		kvm->free(kvm->kvp);
 }
 
-void delete_kvpair(struct kvpair *kvp)
+/* Backward shift deletion: pull later entries of the probe run into the
+ * hole so lookups never need tombstones.
+ */
+static void remove_slot(struct dictionary *dict, struct kvpair_mgr *kvm)
 {
-	free(kvp);
+	struct kvpair_mgr *t = dict->table;
+	uint32_t mask = dict->mask;
+	uint32_t hole = kvm - t, i, home;
+
+	release_slot(kvm);
+
+	for(i = (hole + 1) & mask; t[i].hash; i = (i + 1) & mask) {
+		home = t[i].hash & mask;
+		/* move it if the hole lies between home and i, cyclically */
+		if(((i - home) & mask) >= ((i - hole) & mask)) {
+			t[hole] = t[i];
+			hole = i;
+		}
+	}
+
+	memset(&t[hole], 0, sizeof(t[hole]));
+	dict->entries--;
 }
 
-struct kvpair_mgr *new_kvpair_mgr(struct kvpair *kvp,
-		void (*free_cb)(struct kvpair *))
+/******************************* API Functions ******************************/
+struct dictionary *new_dict(void)
 {
-	struct kvpair_mgr *kvm;
+	struct dictionary *d;
 
-	if((kvm = malloc(sizeof(*kvm))) == NULL) {
-		logerror("could not allocate new key/value mgr: %s\n",
+	if((d = malloc(sizeof(*d))) == NULL) {
+		logerror("could not allocate new dictionary : %s\n",
 				strerror(errno));
 		return NULL;
 	}
 
-	INIT_HLIST_NODE(&kvm->node);
-	kvm->free = free_cb;
-	kvm->kvp = kvp;
+	if(init_dict(d, NULL) < 0) {
+		free(d);
+		return NULL;
+	}
 
-	return kvm;
+	return d;
 }
 
-void delete_kvpair_mgr(struct kvpair_mgr *kvm)
+struct dictionary *new_dict_arena(struct arena *arena)
 {
-	if(kvm->free)
-		kvm->free(kvm->kvp);
-	free(kvm);
+	struct dictionary *d;
+
+	if((d = arena_alloc(arena, sizeof(*d))) == NULL) {
+		logerror("could not allocate new dictionary\n");
+		return NULL;
+	}
+
+	if(init_dict(d, arena) < 0)
+		return NULL;
+
+	return d;
 }
 
-static struct kvpair_mgr *find_kvpair_with_hash(struct dictionary *dict,
-		int hash, const char *key)
+void delete_dict(struct dictionary *dict)
 {
-	struct kvpair_mgr *ret = NULL;
-	struct kvpair_mgr *kvm;
-	struct hlist_node *n;
+	uint32_t i;
 
-	hlist_for_each_entry(kvm, n, &dict->kvtable[hash], node) {
-		if(strcmp(key, kvpair_key(kvm->kvp)) == 0) {
-			ret = kvm;
-			break;
+	if(dict->arena == NULL) {
+		for(i = 0; i <= dict->mask; i++) {
+			if(dict->table[i].hash)
+				release_slot(&dict->table[i]);
 		}
+		free_table(dict);
+		free(dict);
+	}
+}
+
+static struct kvpair *alloc_kvpair(struct arena *arena, const char *key,
+		size_t keylen, const void *value, size_t size)
+{
+	struct kvpair *kvp;
+	/* size of key + null termination + value data size */
+	uint32_t kvsize = keylen + 1 + size;
+
+	if(arena)
+		kvp = arena_alloc(arena, sizeof(struct kvpair) + kvsize);
+	else
+		kvp = malloc(sizeof(struct kvpair) + kvsize);
+	if(kvp == NULL) {
+		logerror("could not allocate new key/value\n");
+		return NULL;
 	}
 
-	return ret;
+	kvp->kvsize = kvsize;
+	kvp->voffset = keylen + 1;
+
+	memcpy(&kvp->kv[0], key, keylen + 1);
+	memcpy(kvpair_value(kvp, NULL), value, size);
+
+	return kvp;
+}
+
+struct kvpair *new_kvpair(const char *key, const void *value, size_t size)
+{
+	return alloc_kvpair(NULL, key, strlen(key), value, size);
+}
+
+void delete_kvpair(struct kvpair *kvp)
+{
+	free(kvp);
 }
 
 struct kvpair_mgr *find_kvpair(struct dictionary *dict, const char *key)
 {
-	int hash = compute_hash(key);
-	return find_kvpair_with_hash(dict, hash, key);
+	size_t keylen = strlen(key);
+	return find_slot(dict, slot_hash(key, keylen), key, keylen);
 }
 
-struct kvpair_mgr *add_kvpair(struct dictionary *dict, struct kvpair *kvp,
+static struct kvpair_mgr *insert_kvpair(struct dictionary *dict,
+		struct kvpair *kvp, size_t keylen,
 		void (*free_cb)(struct kvpair *))
 {
+	const char *key = kvpair_key(kvp);
+	uint32_t hash = slot_hash(key, keylen);
 	struct kvpair_mgr *kvm;
-	struct kvpair_mgr *kvm_old;
-	int hash;
-
-	if((kvm = new_kvpair_mgr(kvp, free_cb)) == NULL) {
-		return NULL;
+	uint32_t i;
+
+	/* replace an existing key in place */
+	if((kvm = find_slot(dict, hash, key, keylen)) != NULL) {
+		release_slot(kvm);
+		kvm->free = free_cb;
+		kvm->kvp = kvp;
+		return kvm;
 	}
 
-	hash = compute_hash(kvpair_key(kvp));
+	if(((dict->entries + 1) > DICT_MAX_LOAD(dict->mask + 1)) &&
+			(grow_table(dict) < 0))
+		return NULL;
 
-	if((kvm_old = find_kvpair_with_hash(dict, hash, kvpair_key(kvp)))
-			!= NULL) {
-		dict->entries--;
-		hlist_del(&kvm_old->node);
-		delete_kvpair_mgr(kvm_old);
-	}
+	for(i = hash & dict->mask; dict->table[i].hash;
+			i = (i + 1) & dict->mask)
+		;
 
-	hlist_add_head(&kvm->node, &dict->kvtable[hash]);
+	kvm = &dict->table[i];
+	kvm->hash = hash;
+	kvm->keylen = keylen;
+	kvm->free = free_cb;
+	kvm->kvp = kvp;
 	dict->entries++;
 
 	return kvm;
 }
 
+struct kvpair_mgr *add_kvpair(struct dictionary *dict, struct kvpair *kvp,
+		void (*free_cb)(struct kvpair *))
+{
+	return insert_kvpair(dict, kvp, strlen(kvpair_key(kvp)), free_cb);
+}
+
 void *dict_add_key(struct dictionary *dict, const char *key,
 		const void *value, size_t size)
 {
-	void *ret = NULL;
+	size_t keylen = strlen(key);
 	struct kvpair *kvp;
 
-	if((kvp = new_kvpair(key, value, size)) == NULL) {
-		goto exit;
-	}
+	if((kvp = alloc_kvpair(dict->arena, key, keylen, value, size)) == NULL)
+		return NULL;
 
-	if(add_kvpair(dict, kvp, &delete_kvpair) == NULL) {
-		delete_kvpair(kvp);
-		goto exit;
+	if(insert_kvpair(dict, kvp, keylen,
+			dict->arena ? NULL : &delete_kvpair) == NULL) {
+		if(dict->arena == NULL)
+			delete_kvpair(kvp);
+		return NULL;
 	}
 
-	ret = kvpair_value(kvp, NULL);
-
-exit:
-	return ret;
+	return kvpair_value(kvp, NULL);
 }
 
 void dict_remove_key(struct dictionary *dict, const char *key)
 {
 	struct kvpair_mgr *kvm = find_kvpair(dict, key);
 
-	if(kvm) {
-		hlist_del(&kvm->node);
-		delete_kvpair_mgr(kvm);
-	}
+	if(kvm)
+		remove_slot(dict, kvm);
 }
 
 int dict_has_key(struct dictionary *dict, const char *key)
@@ -238,16 +439,14 @@ void *dict_value_for_key(struct dictionary *dict, const char *key, size_t *size)
 
 size_t dict_serialized_size(struct dictionary *dict)
 {
-	int i;
+	uint32_t i;
 	size_t sz = 0;
-	struct kvpair_mgr *kvm;
-	struct hlist_node *n;
 
 	/* figure out the size of the serialized data */
-	for(i = 0; i < DICT_HASH_SIZE; i++) {
-		hlist_for_each_entry(kvm, n, &dict->kvtable[i], node) {
-			sz += sizeof(*(kvm->kvp));
-			sz += kvm->kvp->kvsize;
+	for(i = 0; i <= dict->mask; i++) {
+		if(dict->table[i].hash) {
+			sz += sizeof(*(dict->table[i].kvp));
+			sz += dict->table[i].kvp->kvsize;
 		}
 	}
 
@@ -256,17 +455,18 @@ size_t dict_serialized_size(struct dictionary *dict)
 
 ssize_t dict_serialize_into(struct dictionary *dict, void *buf)
 {
-	int i;
+	uint32_t i;
 	ssize_t sz;
-	struct kvpair_mgr *kvm;
-	struct hlist_node *n;
 
-	for(i = 0, sz = 0; i < DICT_HASH_SIZE; i++) {
-		hlist_for_each_entry(kvm, n, &dict->kvtable[i], node) {
-			size_t kvsz = sizeof(*(kvm->kvp)) + kvm->kvp->kvsize;
-			memcpy(buf + sz, kvm->kvp, kvsz);
-			sz += kvsz;
-		}
+	for(i = 0, sz = 0; i <= dict->mask; i++) {
+		struct kvpair_mgr *kvm = &dict->table[i];
+		size_t kvsz;
+
+		if(!kvm->hash)
+			continue;
+		kvsz = sizeof(*(kvm->kvp)) + kvm->kvp->kvsize;
+		memcpy(buf + sz, kvm->kvp, kvsz);
+		sz += kvsz;
 	}
 
 	return sz;
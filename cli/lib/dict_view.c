@@ -0,0 +1,247 @@
+/**
+ * COPYRIGHT 2024 Flirc, Inc. All rights reserved.
+ *
+ * This copyright notice is Copyright Management Information under 17 USC 1202
+ * and is included to protect this work and deter copyright infringement.
+ * Removal or alteration of this Copyright Management Information without
+ * the express written permission of Flirc, Inc. is prohibited, and any
+ * such unauthorized removal or alteration will be a violation of federal law.
+ *
+ * @file
+ * @brief   Read only dictionary views over indexed serialized buffers
+ */
+
+#include <dict_view.h>
+#include <prjutil.h>
+#include <logging.h>
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifndef __HOST_WIN__
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#define VIEW_MIN_SLOTS		(8)
+
+/* same slot hash as struct dictionary, 0 is reserved for empty slots */
+static inline uint32_t view_hash(const char *key, size_t len)
+{
+	uint32_t h = (uint32_t)dict_hash(key, len);
+	return h ? h : 1;
+}
+
+void *dict_serialize_indexed(struct dictionary *dict, size_t *size)
+{
+	struct dict_view_hdr *hdr;
+	struct dict_view_slot *index;
+	uint8_t *buf, *data;
+	uint32_t nslots = VIEW_MIN_SLOTS, mask, i, j;
+	size_t dsize = dict_serialized_size(dict), total, off = 0;
+
+	/* keep the index at most half full */
+	while(nslots < (dict->entries * 2))
+		nslots <<= 1;
+	mask = nslots - 1;
+
+	total = sizeof(*hdr) + (nslots * sizeof(*index)) + dsize;
+	if(dsize > UINT32_MAX) {
+		logerror("dictionary too large to index\n");
+		return NULL;
+	}
+	if((buf = calloc(1, total)) == NULL) {
+		logerror("could not allocate serialized buffer\n");
+		return NULL;
+	}
+
+	hdr = (struct dict_view_hdr *)buf;
+	index = (struct dict_view_slot *)(buf + sizeof(*hdr));
+	data = (uint8_t *)&index[nslots];
+
+	hdr->magic = DICT_VIEW_MAGIC;
+	hdr->entries = dict->entries;
+	hdr->nslots = nslots;
+	hdr->data_size = dsize;
+
+	for(i = 0; i <= dict->mask; i++) {
+		const struct kvpair_mgr *kvm = &dict->table[i];
+		size_t kvsz;
+
+		if(!kvm->hash)
+			continue;
+
+		kvsz = sizeof(*kvm->kvp) + kvm->kvp->kvsize;
+		memcpy(&data[off], kvm->kvp, kvsz);
+
+		for(j = kvm->hash & mask; index[j].hash; j = (j + 1) & mask)
+			;
+		index[j].hash = kvm->hash;
+		index[j].offset = off;
+
+		off += kvsz;
+	}
+
+	if(size)
+		*size = total;
+
+	return buf;
+}
+
+int dict_view_open(struct dict_view *view, const void *buf, size_t size)
+{
+	const struct dict_view_hdr *hdr = buf;
+	size_t need;
+
+	memset(view, 0, sizeof(*view));
+
+	if((size < sizeof(*hdr)) || (hdr->magic != DICT_VIEW_MAGIC)) {
+		logerror("not an indexed dictionary\n");
+		return -EINVAL;
+	}
+	if(!hdr->nslots || (hdr->nslots & (hdr->nslots - 1))) {
+		logerror("bad dictionary index size\n");
+		return -EINVAL;
+	}
+
+	need = sizeof(*hdr) + ((size_t)hdr->nslots *
+			sizeof(struct dict_view_slot)) + hdr->data_size;
+	if(need > size) {
+		logerror("indexed dictionary truncated\n");
+		return -EINVAL;
+	}
+
+	view->hdr = hdr;
+	view->index = (const struct dict_view_slot *)&hdr[1];
+	view->data = (const uint8_t *)&view->index[hdr->nslots];
+
+	return 0;
+}
+
+const void *dict_view_value_for_key(const struct dict_view *view,
+		const char *key, size_t *size)
+{
+	const struct dict_view_hdr *hdr = view->hdr;
+	uint32_t mask = hdr->nslots - 1, i, n;
+	size_t keylen = strlen(key);
+	uint32_t hash = view_hash(key, keylen);
+
+	for(i = hash & mask, n = 0; view->index[i].hash && (n < hdr->nslots);
+			i = (i + 1) & mask, n++) {
+		const struct kvpair *kvp;
+		uint32_t off = view->index[i].offset;
+
+		if(view->index[i].hash != hash)
+			continue;
+
+		/* bounds check the record before touching it */
+		if((off > hdr->data_size) ||
+				((hdr->data_size - off) < sizeof(*kvp)))
+			return NULL;
+		kvp = (const struct kvpair *)&view->data[off];
+		if((kvp->kvsize > (hdr->data_size - off - sizeof(*kvp))) ||
+				(kvp->voffset > kvp->kvsize))
+			return NULL;
+
+		if((kvp->voffset == (keylen + 1)) &&
+				(memcmp(kvp->kv, key, keylen + 1) == 0)) {
+			if(size)
+				*size = kvp->kvsize - kvp->voffset;
+			return &kvp->kv[kvp->voffset];
+		}
+	}
+
+	return NULL;
+}
+
+#ifndef __HOST_WIN__
+int dict_view_map(struct dict_view *view, const char *path)
+{
+	struct stat st;
+	void *map;
+	int fd, ret;
+
+	if((fd = open(path, O_RDONLY)) < 0) {
+		logerror("could not open %s\n", path);
+		return -ENOENT;
+	}
+	if((fstat(fd, &st) < 0) || (st.st_size <= 0)) {
+		logerror("could not stat %s\n", path);
+		close(fd);
+		return -EINVAL;
+	}
+
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if(map == MAP_FAILED) {
+		logerror("could not map %s\n", path);
+		return -ENOMEM;
+	}
+
+	if((ret = dict_view_open(view, map, st.st_size)) < 0) {
+		munmap(map, st.st_size);
+		return ret;
+	}
+
+	view->map = map;
+	view->map_size = st.st_size;
+
+	return 0;
+}
+
+void dict_view_close(struct dict_view *view)
+{
+	if(view->map)
+		munmap(view->map, view->map_size);
+	memset(view, 0, sizeof(*view));
+}
+#else
+int dict_view_map(struct dict_view *view, const char *path)
+{
+	FILE *fp;
+	void *buf;
+	long size;
+	int ret;
+
+	if((fp = fopen(path, "rb")) == NULL) {
+		logerror("could not open %s\n", path);
+		return -ENOENT;
+	}
+	if((fseek(fp, 0, SEEK_END) < 0) || ((size = ftell(fp)) <= 0) ||
+			(fseek(fp, 0, SEEK_SET) < 0)) {
+		logerror("could not size %s\n", path);
+		fclose(fp);
+		return -EINVAL;
+	}
+	if((buf = malloc(size)) == NULL) {
+		fclose(fp);
+		return -ENOMEM;
+	}
+	if(fread(buf, 1, size, fp) != (size_t)size) {
+		logerror("could not read %s\n", path);
+		free(buf);
+		fclose(fp);
+		return -EIO;
+	}
+	fclose(fp);
+
+	if((ret = dict_view_open(view, buf, size)) < 0) {
+		free(buf);
+		return ret;
+	}
+
+	view->map = buf;
+	view->map_size = size;
+
+	return 0;
+}
+
+void dict_view_close(struct dict_view *view)
+{
+	free(view->map);
+	memset(view, 0, sizeof(*view));
+}
+#endif /* __HOST_WIN__ */
@@ -19,50 +19,81 @@
 #include <hexdump.h>
 #include <prjutil.h>
 
-static void hexdump_line(FILE *outf, void *line, size_t size, size_t width)
+static const char hexdigits[] = "0123456789abcdef";
+
+/* Renders one line into out, which has room for HEXDUMP_LINE_MAX bytes, and
+ * returns its length. Formats the same as the old per byte fprintf did.
+ */
+static size_t hexdump_line(char *out, const unsigned char *line, size_t size,
+		size_t addr, int addrdigits)
 {
+	char *hex, *asc;
 	size_t i;
+	int d;
 
-	for(i = 0; i < width; i++) {
-		if(i < size) {
-			fprintf(outf, "%02x ",
-					*((unsigned char *)(line + i)) & 0xFF);
-		} else {
-			fprintf(outf, "   ");
-		}
+	for(d = addrdigits - 1; d >= 0; d--) {
+		out[d] = hexdigits[addr & 0xF];
+		addr >>= 4;
 	}
-	fprintf(outf, " ");
-	for(i = 0; i < width; i++) {
-		if(i < size) {
-			char c = *((char *)(line + i));
-			if((c > 31) && (c < 127)) {
-				fprintf(outf, "%c", c);
-			} else {
-				fprintf(outf, ".");
-			}
-		} else {
-			fprintf(outf, " ");
-		}
+	out[addrdigits] = ':';
+	out[addrdigits + 1] = ' ';
+
+	hex = &out[addrdigits + 2];
+	asc = hex + 3 * HEXDUMP_WIDTH + 1;
+
+	for(i = 0; i < size; i++) {
+		unsigned char c = line[i];
+
+		hex[3 * i] = hexdigits[c >> 4];
+		hex[3 * i + 1] = hexdigits[c & 0xF];
+		hex[3 * i + 2] = ' ';
+		asc[i] = (c > 31 && c < 127) ? c : '.';
+	}
+	for(; i < HEXDUMP_WIDTH; i++) {
+		hex[3 * i] = hex[3 * i + 1] = hex[3 * i + 2] = ' ';
+		asc[i] = ' ';
 	}
+	hex[3 * HEXDUMP_WIDTH] = ' ';
+	asc[HEXDUMP_WIDTH] = '\n';
+
+	return asc + HEXDUMP_WIDTH + 1 - out;
 }
 
-void hexdump(FILE *outf, void *buf, size_t size)
+void hexdump_to(hexdump_sink_t sink, void *ctx, const void *buf, size_t size)
 {
-	size_t i;
-	const char *addrfmt;
+	char chunk[HEXDUMP_CHUNK_LINES * HEXDUMP_LINE_MAX];
+	const unsigned char *p = buf;
+	size_t i, n = 0;
+	int addrdigits;
 
 	if(size < (1 << 8)) {
-		addrfmt = "%02x: ";
+		addrdigits = 2;
 	} else if(size < (1 << 16)) {
-		addrfmt = "%04x: ";
+		addrdigits = 4;
 	} else {
-		addrfmt = "%08x: ";
+		addrdigits = 8;
 	}
 
 	for(i = 0; i < size; i += HEXDUMP_WIDTH) {
-		fprintf(outf, addrfmt, (unsigned int)i);
-		hexdump_line(outf, buf + i, min_of(HEXDUMP_WIDTH, (size - i)),
-				HEXDUMP_WIDTH);
-		fprintf(outf, "\n");
+		if(n + HEXDUMP_LINE_MAX > sizeof(chunk)) {
+			sink(ctx, chunk, n);
+			n = 0;
+		}
+		n += hexdump_line(&chunk[n], p + i,
+				min_of(HEXDUMP_WIDTH, (size - i)),
+				i, addrdigits);
 	}
+
+	if(n)
+		sink(ctx, chunk, n);
+}
+
+static void hexdump_file(void *ctx, const char *text, size_t len)
+{
+	fwrite(text, 1, len, (FILE *)ctx);
+}
+
+void hexdump(FILE *outf, void *buf, size_t size)
+{
+	hexdump_to(hexdump_file, outf, buf, size);
 }
@@ -0,0 +1,200 @@
+/**
+ * COPYRIGHT 2024 Flirc, Inc. All rights reserved.
+ *
+ * This copyright notice is Copyright Management Information under 17 USC 1202
+ * and is included to protect this work and deter copyright infringement.
+ * Removal or alteration of this Copyright Management Information without
+ * the express written permission of Flirc, Inc. is prohibited, and any
+ * such unauthorized removal or alteration will be a violation of federal law.
+ *
+ * @file
+ * @brief   Fixed size latency histograms with percentile queries
+ */
+
+#include <histogram.h>
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+static struct histogram *registered;
+
+static inline unsigned int bucket_of(uint64_t v)
+{
+	unsigned int shift;
+
+	if(v < HIST_SUB_COUNT)
+		return (unsigned int)v;
+
+	/* msb is at least HIST_SUB_BITS here, keep the top HIST_SUB_BITS */
+	shift = 63 - __builtin_clzll(v) - (HIST_SUB_BITS - 1);
+
+	return HIST_SUB_COUNT + (shift - 1) * HIST_HALF_COUNT +
+		(unsigned int)(v >> shift) - HIST_HALF_COUNT;
+}
+
+/* largest value that lands in a bucket */
+static inline uint64_t bucket_top(unsigned int b)
+{
+	unsigned int shift;
+	uint64_t sub;
+
+	if(b < HIST_SUB_COUNT)
+		return b;
+
+	shift = (b - HIST_SUB_COUNT) / HIST_HALF_COUNT + 1;
+	sub = (b - HIST_SUB_COUNT) % HIST_HALF_COUNT + HIST_HALF_COUNT;
+
+	return (sub << shift) + ((1ull << shift) - 1);
+}
+
+void hist_init(struct histogram *h, const char *name)
+{
+	memset(h, 0, sizeof(*h));
+	h->name = name;
+	h->min = UINT64_MAX;
+}
+
+void hist_reset(struct histogram *h)
+{
+	memset(h->counts, 0, sizeof(h->counts));
+	h->count = 0;
+	h->sum = 0;
+	h->min = UINT64_MAX;
+	h->max = 0;
+}
+
+void hist_record(struct histogram *h, uint64_t v)
+{
+	h->counts[bucket_of(v)]++;
+	h->count++;
+	h->sum += v;
+	if(v < h->min)
+		h->min = v;
+	if(v > h->max)
+		h->max = v;
+}
+
+void hist_merge(struct histogram *dst, const struct histogram *src)
+{
+	unsigned int i;
+
+	if(!src->count)
+		return;
+
+	for(i = 0; i < HIST_BUCKETS; i++)
+		dst->counts[i] += src->counts[i];
+
+	dst->count += src->count;
+	dst->sum += src->sum;
+	if(src->min < dst->min)
+		dst->min = src->min;
+	if(src->max > dst->max)
+		dst->max = src->max;
+}
+
+uint64_t hist_percentile(const struct histogram *h, double pct)
+{
+	uint64_t want, seen = 0, top;
+	double rank;
+	unsigned int i;
+
+	if(!h->count)
+		return 0;
+
+	if(pct >= 100.0)
+		return h->max;
+
+	/* rank of the record we're after, 1 based, rounded up. scaled before
+	 * dividing so an exact rank, p90 of 10, isn't nudged past itself */
+	rank = pct * h->count / 100.0;
+	want = (uint64_t)rank;
+	if(want < rank)
+		want++;
+	if(want < 1)
+		want = 1;
+
+	for(i = 0; i < HIST_BUCKETS; i++) {
+		if((seen += h->counts[i]) >= want)
+			break;
+	}
+
+	top = bucket_top(i);
+	return top > h->max ? h->max : top;
+}
+
+double hist_mean(const struct histogram *h)
+{
+	return h->count ? (double)h->sum / h->count : 0.0;
+}
+
+void hist_print_header(FILE *fp, const char *unit)
+{
+	fprintf(fp, "%-16s %10s %9s %9s %9s %9s %9s %9s %9s  (%s)\n",
+			"stage", "count", "min", "p50", "p90", "p99",
+			"p99.9", "p99.99", "max", unit);
+}
+
+void hist_print(const struct histogram *h, FILE *fp, double scale)
+{
+	fprintf(fp, "%-16s %10llu %9.1f %9.1f %9.1f %9.1f %9.1f %9.1f %9.1f\n",
+			h->name ? h->name : "-",
+			(unsigned long long)h->count,
+			h->count ? h->min / scale : 0.0,
+			hist_percentile(h, 50.0) / scale,
+			hist_percentile(h, 90.0) / scale,
+			hist_percentile(h, 99.0) / scale,
+			hist_percentile(h, 99.9) / scale,
+			hist_percentile(h, 99.99) / scale,
+			h->max / scale);
+}
+
+void hist_register(struct histogram *h)
+{
+	struct histogram **pp;
+
+	for(pp = &registered; *pp; pp = &(*pp)->next) {
+		if(*pp == h)
+			return;
+	}
+
+	h->next = NULL;
+	*pp = h;
+}
+
+void hist_unregister(struct histogram *h)
+{
+	struct histogram **pp;
+
+	for(pp = &registered; *pp; pp = &(*pp)->next) {
+		if(*pp == h) {
+			*pp = h->next;
+			h->next = NULL;
+			return;
+		}
+	}
+}
+
+void hist_reset_all(void)
+{
+	struct histogram *h;
+
+	for(h = registered; h; h = h->next)
+		hist_reset(h);
+}
+
+int hist_print_all(FILE *fp, const char *unit, double scale)
+{
+	struct histogram *h;
+	int n = 0;
+
+	for(h = registered; h; h = h->next) {
+		if(!h->count)
+			continue;
+		if(!n++)
+			hist_print_header(fp, unit);
+		hist_print(h, fp, scale);
+	}
+
+	return n;
+}
@@ -0,0 +1,434 @@
+/**
+ * COPYRIGHT 2024 Flirc, Inc. All rights reserved.
+ *
+ * This copyright notice is Copyright Management Information under 17 USC 1202
+ * and is included to protect this work and deter copyright infringement.
+ * Removal or alteration of this Copyright Management Information without
+ * the express written permission of Flirc, Inc. is prohibited, and any
+ * such unauthorized removal or alteration will be a violation of federal law.
+ *
+ * @file
+ * @brief   Deferred printf formatting
+ */
+
+#include <logfmt.h>
+
+#include <stddef.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* longest conversion spec we'll hand to snprintf, e.g. "%-+#08.*llx" */
+#define SPEC_MAX		(32)
+
+enum argtype {
+	ARG_NONE,
+	ARG_INT,
+	ARG_LONG,
+	ARG_LLONG,
+	ARG_SIZE,
+	ARG_INTMAX,
+	ARG_PTRDIFF,
+	ARG_DOUBLE,
+	ARG_LDOUBLE,
+	ARG_PTR,
+	ARG_STR,
+	ARG_SKIP,	/* %n, argument consumed but not used */
+};
+
+struct spec {
+	size_t len;		/* characters from '%' to the conversion */
+	int stars;		/* '*' width and precision arguments */
+	int prec;		/* precision, PREC_NONE or PREC_STAR */
+	enum argtype type;
+};
+
+#define PREC_NONE	(-1)
+#define PREC_STAR	(-2)
+
+/* Parses the conversion spec starting at the '%' in p. */
+static void parse_spec(const char *p, struct spec *s)
+{
+	const char *c = p + 1;
+	int l = 0, big = 0, other = 0;
+
+	s->stars = 0;
+	s->prec = PREC_NONE;
+	s->type = ARG_NONE;
+
+	while(*c && strchr("-+ #0'", *c))
+		c++;
+	if(*c == '*') {
+		s->stars++;
+		c++;
+	} else {
+		while(*c >= '0' && *c <= '9')
+			c++;
+	}
+	if(*c == '.') {
+		c++;
+		if(*c == '*') {
+			s->stars++;
+			s->prec = PREC_STAR;
+			c++;
+		} else {
+			s->prec = 0;
+			while(*c >= '0' && *c <= '9') {
+				if(s->prec < INT_MAX / 10)
+					s->prec = s->prec * 10 + (*c - '0');
+				c++;
+			}
+		}
+	}
+	for(;; c++) {
+		if(*c == 'l')
+			l++;
+		else if(*c == 'h')
+			;	/* promoted to int anyway */
+		else if(*c == 'q')
+			l = 2;
+		else if(*c == 'L')
+			big = 1;
+		else if(*c == 'j' || *c == 'z' || *c == 'Z' || *c == 't')
+			other = *c;
+		else
+			break;
+	}
+
+	switch(*c) {
+	case 'd': case 'i': case 'o': case 'u': case 'x': case 'X':
+		if(other == 'j')
+			s->type = ARG_INTMAX;
+		else if(other == 'z' || other == 'Z')
+			s->type = ARG_SIZE;
+		else if(other == 't')
+			s->type = ARG_PTRDIFF;
+		else if(l >= 2)
+			s->type = ARG_LLONG;
+		else if(l == 1)
+			s->type = ARG_LONG;
+		else
+			s->type = ARG_INT;
+		break;
+	case 'c':
+		s->type = ARG_INT;
+		break;
+	case 'f': case 'F': case 'e': case 'E':
+	case 'g': case 'G': case 'a': case 'A':
+		s->type = big ? ARG_LDOUBLE : ARG_DOUBLE;
+		break;
+	case 's':
+		/* wide strings are passed through as pointers */
+		s->type = l ? ARG_PTR : ARG_STR;
+		break;
+	case 'p':
+		s->type = ARG_PTR;
+		break;
+	case 'n':
+		s->type = ARG_SKIP;
+		break;
+	case '\0':
+		/* dangling '%', print it as is */
+		s->len = c - p;
+		return;
+	default:
+		/* "%%" and anything unknown take no argument */
+		break;
+	}
+
+	s->len = (c - p) + 1;
+}
+
+/****************************** Capturing ***********************************/
+struct sink {
+	unsigned char *p;
+	size_t left;
+	int flags;
+};
+
+static int put(struct sink *k, const void *v, size_t size)
+{
+	if(k->left < size) {
+		k->flags |= LOGFMT_TRUNCATED;
+		k->left = 0;
+		return -1;
+	}
+	memcpy(k->p, v, size);
+	k->p += size;
+	k->left -= size;
+	return 0;
+}
+
+#define PUT(k, type, ap) \
+	({ type __v = va_arg(ap, type); put(k, &__v, sizeof(__v)); })
+
+/* A string with a precision needn't be NUL terminated, so no more than
+ * prec bytes of it are read. prec is negative for none.
+ */
+static int put_str(struct sink *k, const char *s, int prec)
+{
+	size_t n;
+
+	if(s == NULL)
+		s = "(null)";
+	n = (prec < 0) ? strlen(s) : strnlen(s, prec);
+
+	if(k->left == 0) {
+		k->flags |= LOGFMT_TRUNCATED;
+		return -1;
+	}
+	if(n >= k->left) {
+		n = k->left - 1;
+		k->flags |= LOGFMT_TRUNCATED;
+	}
+	memcpy(k->p, s, n);
+	k->p[n] = '\0';
+	k->p += n + 1;
+	k->left -= n + 1;
+	return 0;
+}
+
+static const char sigchar[] = {
+	[ARG_INT]	= 'i',
+	[ARG_LONG]	= 'l',
+	[ARG_LLONG]	= 'L',
+	[ARG_SIZE]	= 'z',
+	[ARG_INTMAX]	= 'j',
+	[ARG_PTRDIFF]	= 't',
+	[ARG_DOUBLE]	= 'd',
+	[ARG_LDOUBLE]	= 'D',
+	[ARG_PTR]	= 'p',
+	[ARG_STR]	= 's',
+	[ARG_SKIP]	= 'n',
+};
+
+/* A string with a precision is 'S' if it comes from the '*' argument
+ * before it, or '.', the digits and 's' if it's in the format.
+ */
+int logfmt_signature(const char *fmt, char *sig, size_t size)
+{
+	char prec[16];
+	struct spec s;
+	size_t n = 0, plen;
+	int i, args = 0;
+
+	for(; *fmt; fmt++) {
+		if(*fmt != '%')
+			continue;
+
+		parse_spec(fmt, &s);
+		plen = 0;
+		if(s.type == ARG_STR && s.prec >= 0)
+			plen = snprintf(prec, sizeof(prec), ".%d", s.prec);
+		if((n + s.stars + plen + 1) >= size)
+			return -1;
+		for(i = 0; i < s.stars; i++)
+			sig[n++] = sigchar[ARG_INT];
+		memcpy(&sig[n], prec, plen);
+		n += plen;
+		if(s.type == ARG_STR && s.prec == PREC_STAR)
+			sig[n++] = 'S';
+		else if(s.type != ARG_NONE)
+			sig[n++] = sigchar[s.type];
+		args += s.stars + (s.type != ARG_NONE);
+
+		if(s.len)
+			fmt += s.len - 1;
+	}
+
+	sig[n] = '\0';
+	return args;
+}
+
+size_t logfmt_capture_sig(void *buf, size_t size, const char *sig,
+		va_list ap, int *flags)
+{
+	struct sink k = { buf, size, 0 };
+	va_list aq;
+	int r = 0, last = 0, prec;
+
+	/* va_list may be an array type, work on a copy we can pass around */
+	va_copy(aq, ap);
+
+	for(; *sig && (r == 0); sig++) {
+		switch(*sig) {
+		case 'i':
+			/* kept, it's the precision if an 'S' follows */
+			last = va_arg(aq, int);
+			r = put(&k, &last, sizeof(last));
+			break;
+		case 'l': r = PUT(&k, long, aq); break;
+		case 'L': r = PUT(&k, long long, aq); break;
+		case 'z': r = PUT(&k, size_t, aq); break;
+		case 'j': r = PUT(&k, intmax_t, aq); break;
+		case 't': r = PUT(&k, ptrdiff_t, aq); break;
+		case 'd': r = PUT(&k, double, aq); break;
+		case 'D': r = PUT(&k, long double, aq); break;
+		case 'p': r = PUT(&k, void *, aq); break;
+		case 's': r = put_str(&k, va_arg(aq, const char *), -1); break;
+		case 'S': r = put_str(&k, va_arg(aq, const char *), last); break;
+		case '.':
+			prec = (int)strtol(sig + 1, (char **)&sig, 10);
+			r = put_str(&k, va_arg(aq, const char *), prec);
+			break;
+		case 'n': (void)va_arg(aq, void *); break;
+		}
+	}
+
+	va_end(aq);
+
+	if(flags)
+		*flags = k.flags;
+
+	return size - k.left;
+}
+
+size_t logfmt_capture(void *buf, size_t size, const char *fmt, va_list ap,
+		int *flags)
+{
+	char sig[LOGFMT_SIG_MAX];
+
+	if(logfmt_signature(fmt, sig, sizeof(sig)) < 0) {
+		if(flags)
+			*flags = LOGFMT_TRUNCATED;
+		return 0;
+	}
+
+	return logfmt_capture_sig(buf, size, sig, ap, flags);
+}
+
+/******************************* Rendering **********************************/
+struct source {
+	const unsigned char *p;
+	size_t left;
+};
+
+static int take(struct source *a, void *v, size_t size)
+{
+	if(a->left < size)
+		return -1;
+	memcpy(v, a->p, size);
+	a->p += size;
+	a->left -= size;
+	return 0;
+}
+
+static const char *take_str(struct source *a)
+{
+	const char *s = (const char *)a->p;
+	size_t n;
+
+	if(a->left == 0)
+		return NULL;
+	n = strnlen(s, a->left);
+	if(n == a->left)
+		return NULL;
+	a->p += n + 1;
+	a->left -= n + 1;
+	return s;
+}
+
+#define EMIT(type) do { \
+		type __v; \
+		if(take(&a, &__v, sizeof(__v)) < 0) \
+			goto done; \
+		n = (s.stars == 0) ? snprintf(o, room, sp, __v) : \
+			(s.stars == 1) ? snprintf(o, room, sp, w[0], __v) : \
+			snprintf(o, room, sp, w[0], w[1], __v); \
+	} while(0)
+
+size_t logfmt_render(char *out, size_t outsize, const char *fmt,
+		const void *args, size_t len)
+{
+	struct source a = { args, len };
+	char sp[SPEC_MAX];
+	size_t pos = 0;
+	struct spec s;
+	int w[2], i, n;
+
+	if(outsize == 0)
+		return 0;
+
+	while(*fmt && (pos < (outsize - 1))) {
+		const char *pct = strchr(fmt, '%');
+		size_t lit = pct ? (size_t)(pct - fmt) : strlen(fmt);
+		char *o;
+		size_t room;
+
+		/* literal text up to the next conversion */
+		if(lit > (outsize - 1 - pos))
+			lit = outsize - 1 - pos;
+		memcpy(&out[pos], fmt, lit);
+		pos += lit;
+		fmt += lit;
+		if(!pct || (*fmt != '%'))
+			break;
+
+		parse_spec(fmt, &s);
+		o = &out[pos];
+		room = outsize - pos;
+		n = 0;
+
+		if(s.type == ARG_NONE || s.len >= sizeof(sp)) {
+			/* "%%" renders one '%', anything else verbatim */
+			if(s.len == 2 && fmt[1] == '%') {
+				out[pos] = '%';
+				n = 1;
+			} else {
+				n = s.len < room ? s.len : room - 1;
+				memcpy(o, fmt, n);
+			}
+			fmt += s.len;
+			pos += n;
+			continue;
+		}
+
+		memcpy(sp, fmt, s.len);
+		sp[s.len] = '\0';
+		fmt += s.len;
+
+		for(i = 0; i < s.stars; i++) {
+			if(take(&a, &w[i], sizeof(w[i])) < 0)
+				goto done;
+		}
+
+		switch(s.type) {
+		case ARG_INT:     EMIT(int); break;
+		case ARG_LONG:    EMIT(long); break;
+		case ARG_LLONG:   EMIT(long long); break;
+		case ARG_SIZE:    EMIT(size_t); break;
+		case ARG_INTMAX:  EMIT(intmax_t); break;
+		case ARG_PTRDIFF: EMIT(ptrdiff_t); break;
+		case ARG_DOUBLE:  EMIT(double); break;
+		case ARG_LDOUBLE: EMIT(long double); break;
+		case ARG_PTR:
+			/* also covers %ls, which we can't render */
+			if(sp[s.len - 1] != 'p') {
+				strcpy(sp, "%p");
+				s.stars = 0;
+			}
+			EMIT(void *);
+			break;
+		case ARG_STR: {
+			const char *str = take_str(&a);
+			if(str == NULL)
+				goto done;
+			n = (s.stars == 0) ? snprintf(o, room, sp, str) :
+				(s.stars == 1) ? snprintf(o, room, sp, w[0], str) :
+				snprintf(o, room, sp, w[0], w[1], str);
+			break;
+		}
+		case ARG_SKIP:
+		case ARG_NONE:
+			break;
+		}
+
+		if(n > 0)
+			pos += ((size_t)n < room) ? (size_t)n : room - 1;
+	}
+
+done:
+	out[pos] = '\0';
+	return pos;
+}
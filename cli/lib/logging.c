@@ -32,9 +32,16 @@
  */
 
 #include <logging.h>
+#include <logfmt.h>
+#include <logbin.h>
 #include <cmds.h>
+#include <monotime.h>
 #include <stdarg.h>
+#include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <signal.h>
 
 #ifdef LOG_WITH_NSLOG
 extern void _nslog_hook(const char *fmt, va_list ap);
@@ -42,28 +49,434 @@ extern void _nslog_hook(const char *fmt, va_list ap);
 
 static FILE *logfds[MAX_LOGLEVEL + 1];
 
-static int loglevel = min_of(DEFAULT_LOGLEVEL, MAX_LOGLEVEL);
+int __loglevel = min_of(DEFAULT_LOGLEVEL, MAX_LOGLEVEL);
 
+/* Asynchronous Logging
+ * 	When started, the log macros don't format anything. The caller
+ * 	copies its site pointer and arguments (see logfmt.h) into a slot of a
+ * 	bounded multi-producer, single-consumer ring, and a writer thread
+ * 	formats and writes them in order. The ring is a Vyukov style array
+ * 	queue: each slot carries a sequence number that tells producers it
+ * 	is free and the writer that it is full, so producers only contend on
+ * 	one compare-and-swap and never block. A full ring drops the message
+ * 	and counts it; the writer reports drops as it catches up.
+ *
+ * 	In binary mode the writer doesn't format either, it writes the site
+ * 	(once) and the raw record to a file for logdecode.
+ */
+#define LOG_RING_SLOTS		1024	/* power of two */
+#define LOG_REC_ARGS		(512 - 2 * sizeof(size_t) - sizeof(void *))
+#define LOG_LINE_MAX		1024
+#define LOG_IDLE_US		1000
+#define LOG_FLUSH_MS		1000
+
+struct log_rec {
+	size_t seq;
+	uint16_t len;
+	uint16_t flags;
+	uint32_t pad;
+	const struct log_site *site;
+	uint64_t ts_ns;
+	unsigned char args[LOG_REC_ARGS - sizeof(uint64_t)];
+};
+
+static struct {
+	struct log_rec *ring;
+	size_t head __aligned(64);	/* next slot for producers */
+	size_t tail __aligned(64);	/* next slot for the writer */
+	size_t written;			/* records written, for log_flush */
+	unsigned long logged;
+	unsigned long dropped;
+	unsigned long truncated;
+	volatile int running;
+	pthread_t writer;
+	FILE *binfp;
+} alog;
+
+static pthread_mutex_t site_lock = PTHREAD_MUTEX_INITIALIZER;
+static uint32_t site_ids;
+
+/* Slow path, first time a site logs: work out its argument signature and
+ * give it an id. A signature that doesn't fit leaves the site on the
+ * synchronous path.
+ */
+static void log_site_init(struct log_site *site)
+{
+	pthread_mutex_lock(&site_lock);
+	if(!site->id) {
+		if(logfmt_signature(site->fmt, site->sig,
+					sizeof(site->sig)) < 0)
+			site->sig[0] = '\0';
+		__atomic_store_n(&site->id, ++site_ids, __ATOMIC_RELEASE);
+	}
+	pthread_mutex_unlock(&site_lock);
+}
+
+static int alog_push(const struct log_site *site, va_list ap)
+{
+	struct log_rec *r;
+	size_t pos = __atomic_load_n(&alog.head, __ATOMIC_RELAXED);
+	size_t seq;
+	intptr_t dif;
+	int flags;
+
+	for(;;) {
+		r = &alog.ring[pos & (LOG_RING_SLOTS - 1)];
+		seq = __atomic_load_n(&r->seq, __ATOMIC_ACQUIRE);
+		dif = (intptr_t)seq - (intptr_t)pos;
+		if(dif == 0) {
+			if(__atomic_compare_exchange_n(&alog.head, &pos,
+					pos + 1, 1, __ATOMIC_RELAXED,
+					__ATOMIC_RELAXED))
+				break;
+		} else if(dif < 0) {
+			__atomic_add_fetch(&alog.dropped, 1, __ATOMIC_RELAXED);
+			return -1;
+		} else {
+			pos = __atomic_load_n(&alog.head, __ATOMIC_RELAXED);
+		}
+	}
+
+	r->site = site;
+	r->ts_ns = alog.binfp ? mono_now_ns() : 0;
+	r->len = logfmt_capture_sig(r->args, sizeof(r->args), site->sig, ap,
+			&flags);
+	r->flags = flags;
+
+	__atomic_store_n(&r->seq, pos + 1, __ATOMIC_RELEASE);
+
+	return 0;
+}
+
+static void alog_write_text(const struct log_rec *r)
+{
+	const struct log_site *site = r->site;
+	char line[LOG_LINE_MAX];
+	int n;
+
+	n = snprintf(line, sizeof(line), "[%c] %s %s(%d): ", site->tag,
+			site->file, site->func, site->line);
+	if((n < 0) || (n >= sizeof(line)))
+		n = 0;
+	n += logfmt_render(&line[n], sizeof(line) - n, site->fmt, r->args,
+			r->len);
+	fwrite(line, 1, n, logfds[site->level]);
+}
+
+static void alog_write_binary(struct log_rec *r)
+{
+	struct log_site *site = (struct log_site *)r->site;
+	struct logbin_msg m;
+
+	/* only the writer touches defined, so this needs no locking */
+	if(!site->defined) {
+		struct logbin_define d;
+
+		memset(&d, 0, sizeof(d));
+		d.type = LOGBIN_DEFINE;
+		d.level = site->level;
+		d.tag = site->tag;
+		d.id = site->id;
+		d.line = site->line;
+		d.file_len = strlen(site->file);
+		d.func_len = strlen(site->func);
+		d.fmt_len = strlen(site->fmt);
+		fwrite(&d, sizeof(d), 1, alog.binfp);
+		fwrite(site->file, 1, d.file_len, alog.binfp);
+		fwrite(site->func, 1, d.func_len, alog.binfp);
+		fwrite(site->fmt, 1, d.fmt_len, alog.binfp);
+		site->defined = 1;
+	}
+
+	m.type = LOGBIN_MSG;
+	m.flags = r->flags;
+	m.len = r->len;
+	m.id = site->id;
+	m.ts_ns = r->ts_ns;
+	fwrite(&m, sizeof(m), 1, alog.binfp);
+	fwrite(r->args, 1, r->len, alog.binfp);
+}
+
+static void alog_write_drops(unsigned long count)
+{
+	if(alog.binfp) {
+		struct logbin_drop d;
+
+		memset(&d, 0, sizeof(d));
+		d.type = LOGBIN_DROP;
+		d.count = count;
+		d.ts_ns = mono_now_ns();
+		fwrite(&d, sizeof(d), 1, alog.binfp);
+	} else {
+		fprintf(logfds[LOGLEVEL_WARNING],
+				"[W] logging: %lu message(s) dropped\n",
+				count);
+	}
+}
+
+/* Writes out everything published so far, returns the number of records. */
+static size_t alog_drain(void)
+{
+	static unsigned long reported;
+	unsigned long dropped;
+	struct log_rec *r;
+	size_t n = 0;
+
+	for(;;) {
+		r = &alog.ring[alog.tail & (LOG_RING_SLOTS - 1)];
+		if(__atomic_load_n(&r->seq, __ATOMIC_ACQUIRE) !=
+				(alog.tail + 1))
+			break;
+
+		if(r->flags & LOGFMT_TRUNCATED)
+			alog.truncated++;
+		if(alog.binfp)
+			alog_write_binary(r);
+		else
+			alog_write_text(r);
+
+		__atomic_store_n(&r->seq, alog.tail + LOG_RING_SLOTS,
+				__ATOMIC_RELEASE);
+		alog.tail++;
+		n++;
+	}
+
+	dropped = __atomic_load_n(&alog.dropped, __ATOMIC_RELAXED);
+	if(dropped != reported) {
+		alog_write_drops(dropped - reported);
+		reported = dropped;
+	}
+
+	if(n) {
+		fflush(NULL);
+		alog.logged += n;
+		__atomic_store_n(&alog.written, alog.tail, __ATOMIC_RELEASE);
+	}
+
+	return n;
+}
+
+static void *alog_writer(void *arg)
+{
+	while(__atomic_load_n(&alog.running, __ATOMIC_ACQUIRE)) {
+		if(alog_drain() == 0)
+			mono_sleep_us(LOG_IDLE_US);
+	}
+
+	/* pick up anything published before we were told to stop */
+	alog_drain();
+
+	return NULL;
+}
+
+int log_async_start(void)
+{
+	sigset_t all, prev;
+	size_t i;
+	int rc;
+
+	if(alog.running)
+		return 0;
+
+	if(alog.ring == NULL) {
+		if((alog.ring = calloc(LOG_RING_SLOTS,
+				sizeof(*alog.ring))) == NULL)
+			return -1;
+		for(i = 0; i < LOG_RING_SLOTS; i++)
+			alog.ring[i].seq = i;
+		alog.head = alog.tail = alog.written = 0;
+		atexit(log_async_stop);
+	}
+
+	/* the writer inherits this mask, so no handler ever runs on it and
+	 * waits on itself in log_flush */
+	sigfillset(&all);
+	pthread_sigmask(SIG_SETMASK, &all, &prev);
+
+	alog.running = 1;
+	rc = pthread_create(&alog.writer, NULL, alog_writer, NULL);
+	pthread_sigmask(SIG_SETMASK, &prev, NULL);
+
+	if(rc != 0) {
+		alog.running = 0;
+		return -1;
+	}
+
+	return 0;
+}
+
+int log_binary_start(const char *path)
+{
+	struct logbin_hdr h;
+	FILE *fp;
+
+	if(alog.running || alog.binfp)
+		return -1;
+
+	if((fp = fopen(path, "wb")) == NULL)
+		return -1;
+
+	logbin_hdr_init(&h);
+	if(fwrite(&h, sizeof(h), 1, fp) != 1) {
+		fclose(fp);
+		return -1;
+	}
+
+	alog.binfp = fp;
+	if(log_async_start() < 0) {
+		alog.binfp = NULL;
+		fclose(fp);
+		return -1;
+	}
+
+	return 0;
+}
+
+void log_async_stop(void)
+{
+	if(!alog.running)
+		return;
+
+	__atomic_store_n(&alog.running, 0, __ATOMIC_RELEASE);
+	pthread_join(alog.writer, NULL);
+
+	if(alog.binfp) {
+		fclose(alog.binfp);
+		alog.binfp = NULL;
+	}
+}
+
+/* Waits for the writer to catch up with what was logged before the call,
+ * for at most LOG_FLUSH_MS. A slot claimed but never published, by a
+ * thread stopped inside alog_push, holds the writer up for good, so the
+ * wait also ends there.
+ */
+void log_flush(void)
+{
+	size_t target = __atomic_load_n(&alog.head, __ATOMIC_ACQUIRE);
+	uint64_t deadline = mono_now_ns() + LOG_FLUSH_MS * 1000000ull;
+	struct log_rec *r;
+	size_t done;
+
+	if(!alog.running) {
+		fflush(NULL);
+		return;
+	}
+
+	while((done = __atomic_load_n(&alog.written, __ATOMIC_ACQUIRE)) <
+			target) {
+		r = &alog.ring[done & (LOG_RING_SLOTS - 1)];
+		if(__atomic_load_n(&r->seq, __ATOMIC_ACQUIRE) == done)
+			break;
+		if(mono_now_ns() >= deadline)
+			break;
+		mono_sleep_us(LOG_IDLE_US / 10);
+	}
+}
+
+void log_get_stats(struct log_stats *st)
+{
+	st->logged = alog.logged;
+	st->dropped = __atomic_load_n(&alog.dropped, __ATOMIC_RELAXED);
+	st->truncated = alog.truncated;
+}
 
 void set_log_level(int level)
 {
-	loglevel = min_of(level, MAX_LOGLEVEL);
+	__loglevel = min_of(level, MAX_LOGLEVEL);
 }
 
 void __log(int level, const char *fmt, ...)
 {
 	va_list argp;
+
+	if(!level || (level > __loglevel))
+		return;
+
 	va_start(argp, fmt);
 
-	if(level && (level <= loglevel)) {
 #ifdef LOG_WITH_NSLOG
-		_nslog_hook(fmt, argp);
+	_nslog_hook(fmt, argp);
 #else
-		vfprintf(logfds[level], fmt, argp);
+	vfprintf(logfds[level], fmt, argp);
 #endif
+
+	va_end(argp);
+}
+
+void log_hexdump(void *ctx, const char *text, size_t len)
+{
+	__log((int)(intptr_t)ctx, "%.*s", (int)len, text);
+}
+
+#ifdef LOG_WITH_NSLOG
+static void nslog(const char *fmt, ...)
+{
+	va_list argp;
+	va_start(argp, fmt);
+	_nslog_hook(fmt, argp);
+	va_end(argp);
+}
+#endif
+
+void __log_at(struct log_site *site, const char *fmt, ...)
+{
+	char msg[LOG_LINE_MAX];
+	va_list argp, aq;
+	int n;
+
+	if(!site->level || (site->level > __loglevel))
+		return;
+
+	if(!__atomic_load_n(&site->id, __ATOMIC_ACQUIRE))
+		log_site_init(site);
+
+	va_start(argp, fmt);
+
+	if(alog.running && (site->sig[0] || !strchr(fmt, '%'))) {
+		alog_push(site, argp);
+		va_end(argp);
+		return;
 	}
 
+	/* one write per message, like a single vfprintf would have been */
+	va_copy(aq, argp);
+	n = vsnprintf(msg, sizeof(msg), fmt, argp);
 	va_end(argp);
+#ifdef LOG_WITH_NSLOG
+	nslog("[%c] %s %s(%d): %s", site->tag, site->file, site->func,
+			site->line, msg);
+#else
+	if(n < (int)sizeof(msg)) {
+		fprintf(logfds[site->level], "[%c] %s %s(%d): %s", site->tag,
+				site->file, site->func, site->line, msg);
+	} else {
+		fprintf(logfds[site->level], "[%c] %s %s(%d): ", site->tag,
+				site->file, site->func, site->line);
+		vfprintf(logfds[site->level], fmt, aq);
+	}
+#endif
+	va_end(aq);
+}
+
+/* Reports a MONO_SCOPED_TIMER(), lives here so monotime.c has no logging
+ * dependency and can be linked on its own.
+ */
+void mono_timer_report(struct mono_timer *t)
+{
+#if MAX_LOGLEVEL >= LOGLEVEL_DEBUG
+	uint64_t cycles = mono_cycles() - t->start;
+
+	/* calibrating costs milliseconds, skip it if nobody sees the result */
+	if(__loglevel < LOGLEVEL_DEBUG)
+		return;
+
+	logdebug("%s: %llu cycles, %llu us\n", t->name,
+			(unsigned long long)cycles,
+			(unsigned long long)mono_cycles_to_ns(cycles) / 1000);
+#else
+	(void)t;
+#endif
 }
 
 /* We need an init constructor to initialize the file descriptor array with
@@ -81,6 +494,7 @@ static void __constructor _init_logging(void)
 /* Some commands to handle changing logging behavior during run-time */
 CMDHANDLER(setloglevel)
 {
+	const char *file;
 	int req_level;
 
 	/* check arguments */
@@ -95,17 +509,36 @@ CMDHANDLER(setloglevel)
 		return -1;
 	}
 
-	loglevel = req_level;
+	__loglevel = req_level;
+
+	if((file = dict_str_for_key(opts, "binary")) != NULL) {
+		if(log_binary_start(file) < 0) {
+			pcmderr("could not start binary logging to %s\n",
+					file);
+			return -1;
+		}
+	} else if(dict_has_key(opts, "async") && (log_async_start() < 0)) {
+		pcmderr("could not start async logging\n");
+		return -1;
+	}
 
 	return 1;
 }
-APPCMD(loglevel, &setloglevel, "set the log level",
-		"usage: loglevel <level>\n"
+
+START_CMD_OPTS(loglevel_opts)
+	CMD_OPT(async, 'a', "async",
+			"format and write from a background thread")
+	CMD_OPT(binary, 'b', "binary",
+			"--binary=<file>, write an undecoded log for logdecode")
+END_CMD_OPTS;
+
+APPCMD_OPT(loglevel, &setloglevel, "set the log level",
+		"usage: loglevel [opts] <level>\n"
 		"  0 - NONE\n"
 		"  1 - ERROR\n"
 		"  2 - WARNING\n"
 		"  3 - INFO\n"
 		"  4 - DEBUG\n"
 		"  5 - VERBOSE",
-		NULL);
+		NULL, loglevel_opts);
 #endif /* WITH_NO_CMDS */
@@ -0,0 +1,144 @@
+/**
+ * COPYRIGHT 2024 Flirc, Inc. All rights reserved.
+ *
+ * This copyright notice is Copyright Management Information under 17 USC 1202
+ * and is included to protect this work and deter copyright infringement.
+ * Removal or alteration of this Copyright Management Information without
+ * the express written permission of Flirc, Inc. is prohibited, and any
+ * such unauthorized removal or alteration will be a violation of federal law.
+ *
+ * @file
+ * @brief   Monotonic clock, deadline sleeps and scoped cycle timers
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <monotime.h>
+
+#include <stdint.h>
+#include <time.h>
+
+#ifdef __HOST_WIN__
+#include <windows.h>
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#define NSEC_PER_SEC		1000000000ull
+#define NSEC_PER_USEC		1000ull
+
+/* how long to watch the cycle counter against the clock when calibrating */
+#define CALIBRATE_NS		(5 * 1000 * 1000)
+
+#ifdef __HOST_WIN__
+uint64_t mono_now_ns(void)
+{
+	static LARGE_INTEGER freq;
+	LARGE_INTEGER c;
+
+	if(!freq.QuadPart)
+		QueryPerformanceFrequency(&freq);
+	QueryPerformanceCounter(&c);
+
+	/* split to avoid overflowing the multiply on long uptimes */
+	return (uint64_t)(c.QuadPart / freq.QuadPart) * NSEC_PER_SEC +
+		(uint64_t)(c.QuadPart % freq.QuadPart) * NSEC_PER_SEC /
+		freq.QuadPart;
+}
+#else
+uint64_t mono_now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+#endif /* __HOST_WIN__ */
+
+uint64_t mono_elapsed_us(uint64_t start)
+{
+	return (mono_now_ns() - start) / NSEC_PER_USEC;
+}
+
+int mono_has_elapsed_us(uint64_t start, uint64_t us)
+{
+	return (mono_now_ns() - start) >= us * NSEC_PER_USEC;
+}
+
+void mono_sleep_until(uint64_t deadline)
+{
+#if defined(__linux__)
+	struct timespec ts;
+
+	ts.tv_sec = deadline / NSEC_PER_SEC;
+	ts.tv_nsec = deadline % NSEC_PER_SEC;
+
+	/* restarted on signals, the deadline doesn't move */
+	while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) != 0)
+		;
+#elif defined(__HOST_WIN__)
+	uint64_t now;
+
+	/* Sleep() only has millisecond resolution, yield out the rest */
+	while((now = mono_now_ns()) < deadline) {
+		if(deadline - now >= 2 * 1000 * NSEC_PER_USEC)
+			Sleep((DWORD)((deadline - now) / (1000 * NSEC_PER_USEC)) - 1);
+		else
+			SwitchToThread();
+	}
+#else
+	struct timespec ts;
+	uint64_t now;
+
+	while((now = mono_now_ns()) < deadline) {
+		ts.tv_sec = (deadline - now) / NSEC_PER_SEC;
+		ts.tv_nsec = (deadline - now) % NSEC_PER_SEC;
+		nanosleep(&ts, NULL);
+	}
+#endif
+}
+
+void mono_sleep_us(uint64_t us)
+{
+	mono_sleep_until(mono_now_ns() + us * NSEC_PER_USEC);
+}
+
+uint64_t mono_cycles(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	return __rdtsc();
+#elif defined(__aarch64__)
+	uint64_t v;
+
+	__asm__ __volatile__("mrs %0, cntvct_el0" : "=r" (v));
+	return v;
+#else
+	return mono_now_ns();
+#endif
+}
+
+uint64_t mono_cycles_to_ns(uint64_t cycles)
+{
+	/* counter ticks per nanosecond, racing callers compute the same value */
+	static double per_ns;
+
+	if(per_ns == 0.0) {
+#if defined(__x86_64__) || defined(__i386__) || defined(__aarch64__)
+		uint64_t t0, c0, t1, c1;
+
+		t0 = mono_now_ns();
+		c0 = mono_cycles();
+		mono_sleep_until(t0 + CALIBRATE_NS);
+		t1 = mono_now_ns();
+		c1 = mono_cycles();
+
+		per_ns = (double)(c1 - c0) / (double)(t1 - t0);
+#else
+		per_ns = 1.0;
+#endif
+	}
+
+	return (uint64_t)(cycles / per_ns);
+}
@@ -0,0 +1,121 @@
+/**
+ * COPYRIGHT 2024 Flirc, Inc. All rights reserved.
+ *
+ * This copyright notice is Copyright Management Information under 17 USC 1202
+ * and is included to protect this work and deter copyright infringement.
+ * Removal or alteration of this Copyright Management Information without
+ * the express written permission of Flirc, Inc. is prohibited, and any
+ * such unauthorized removal or alteration will be a violation of federal law.
+ *
+ * @file
+ * @brief   Pronto hex to and from raw timings
+ */
+
+#include <pronto.h>
+
+#include <stdint.h>
+
+#define USEC_PER_SEC		1000000ull
+
+/* a count of carrier periods to us, rounded. the divisor is a constant so
+ * this is a multiply and a shift, not a division */
+static inline uint32_t ticks_to_us(uint32_t count, uint32_t word)
+{
+	return ((uint64_t)count * word * USEC_PER_SEC + PRONTO_CLOCK_HZ / 2) /
+		PRONTO_CLOCK_HZ;
+}
+
+static inline uint64_t us_to_ticks(uint32_t us, uint32_t word)
+{
+	uint64_t d = (uint64_t)word * USEC_PER_SEC;
+
+	return ((uint64_t)us * PRONTO_CLOCK_HZ + d / 2) / d;
+}
+
+int ir_pronto_to_raw(const uint16_t *pronto, size_t len,
+		struct pronto_raw *raw)
+{
+	uint32_t word, n, i;
+
+	if (len < PRONTO_PREAMBLE)
+		return -1;
+	if (pronto[0] != PRONTO_LEARNED && pronto[0] != PRONTO_UNMODULATED)
+		return -1;
+	if ((word = pronto[1]) == 0)
+		return -1;
+
+	n = 2 * ((uint32_t)pronto[2] + pronto[3]);
+	if (n == 0 || n > PRONTO_MAX_TIMINGS || PRONTO_PREAMBLE + n != len)
+		return -1;
+
+	raw->carrier = pronto[0] == PRONTO_UNMODULATED ? 0 :
+		(PRONTO_CLOCK_HZ + word / 2) / word;
+	raw->once = 2 * pronto[2];
+	raw->repeat = 2 * pronto[3];
+
+	for (i = 0; i < n; i++)
+		raw->buf[i] = ticks_to_us(pronto[PRONTO_PREAMBLE + i], word);
+
+	return 0;
+}
+
+int ir_raw_to_pronto(const struct pronto_raw *raw, uint16_t *pronto,
+		size_t max)
+{
+	uint32_t n = raw->once + raw->repeat;
+	uint32_t word, longest = 0, i;
+
+	if ((raw->once & 1) || (raw->repeat & 1) || n == 0 ||
+			n > PRONTO_MAX_TIMINGS || PRONTO_PREAMBLE + n > max)
+		return -1;
+
+	for (i = 0; i < n; i++) {
+		if (raw->buf[i] > longest)
+			longest = raw->buf[i];
+	}
+
+	if (raw->carrier) {
+		word = (PRONTO_CLOCK_HZ + raw->carrier / 2) / raw->carrier;
+	} else {
+		/* no carrier to keep to, so the finest unit the longest
+		 * timing still fits in */
+		word = ((uint64_t)longest * PRONTO_CLOCK_HZ +
+				USEC_PER_SEC * UINT16_MAX - 1) /
+			(USEC_PER_SEC * UINT16_MAX);
+		if (word == 0)
+			word = 1;
+	}
+	if (word == 0 || word > UINT16_MAX ||
+			us_to_ticks(longest, word) > UINT16_MAX)
+		return -1;
+
+	pronto[0] = raw->carrier ? PRONTO_LEARNED : PRONTO_UNMODULATED;
+	pronto[1] = word;
+	pronto[2] = raw->once / 2;
+	pronto[3] = raw->repeat / 2;
+
+	for (i = 0; i < n; i++)
+		pronto[PRONTO_PREAMBLE + i] = us_to_ticks(raw->buf[i], word);
+
+	return PRONTO_PREAMBLE + n;
+}
+
+/* a plain loop, see pronto.h */
+size_t ir_pronto_to_raw_batch(const struct pronto_code *codes,
+		struct pronto_raw *raw, size_t n)
+{
+	size_t i, ok = 0;
+
+	for (i = 0; i < n; i++) {
+		const struct pronto_code *c = &codes[i];
+
+		if (ir_pronto_to_raw(c->words, c->len, &raw[i]) < 0) {
+			raw[i].once = 0;
+			raw[i].repeat = 0;
+			continue;
+		}
+		ok++;
+	}
+
+	return ok;
+}
@@ -0,0 +1,186 @@
+/**
+ * COPYRIGHT 2024 Flirc, Inc. All rights reserved.
+ *
+ * This copyright notice is Copyright Management Information under 17 USC 1202
+ * and is included to protect this work and deter copyright infringement.
+ * Removal or alteration of this Copyright Management Information without
+ * the express written permission of Flirc, Inc. is prohibited, and any
+ * such unauthorized removal or alteration will be a violation of federal law.
+ *
+ * @file
+ * @brief   Instrumented IR transmit calls and usb counters
+ */
+
+#include <tx_stats.h>
+#include <histogram.h>
+#include <monotime.h>
+
+#include <flirc/flirc.h>
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+static struct tx_stats stats;
+static struct histogram tx_encode = HISTOGRAM_INIT("tx.encode");
+static struct histogram tx_usb = HISTOGRAM_INIT("tx.usb");
+static struct histogram tx_total = HISTOGRAM_INIT("tx.total");
+
+/* encode time reported for the transmit in progress */
+static uint64_t pending_encode;
+
+static void tx_register(void)
+{
+	hist_register(&tx_encode);
+	hist_register(&tx_usb);
+	hist_register(&tx_total);
+}
+
+static void tx_account(int rc, uint64_t ns)
+{
+	stats.usb_ns += ns;
+	hist_record(&tx_usb, ns);
+	hist_record(&tx_total, pending_encode + ns);
+	pending_encode = 0;
+
+	if (rc >= 0) {
+		stats.sent++;
+		return;
+	}
+
+	stats.last_error = rc;
+	if (rc == -LIBUSBERR)
+		stats.usb_errors++;
+	else if (rc == -ETIMEOUT)
+		stats.timeouts++;
+	else
+		stats.errors++;
+}
+
+int tx_raw(uint16_t *buf, uint16_t len, uint16_t ik, uint8_t repeat)
+{
+	uint64_t t0 = mono_now_ns();
+	int tries = 0;
+	int rc;
+
+	tx_register();
+	stats.calls++;
+
+	for (;;) {
+		stats.bytes += len * sizeof(buf[0]);
+		rc = fl_transmit_raw(buf, len, ik, repeat);
+		if (rc != -LIBUSBERR || tries++ == TX_MAX_RETRIES)
+			break;
+		stats.retries++;
+	}
+
+	tx_account(rc, mono_now_ns() - t0);
+
+	return rc;
+}
+
+int tx_pronto(uint16_t *buf, uint32_t len, uint8_t rep)
+{
+	uint64_t t0 = mono_now_ns();
+	int tries = 0;
+	int rc;
+
+	tx_register();
+	stats.calls++;
+
+	for (;;) {
+		stats.bytes += len * sizeof(buf[0]);
+		rc = flirc_send_pronto(buf, len, rep);
+		if (rc != -LIBUSBERR || tries++ == TX_MAX_RETRIES)
+			break;
+		stats.retries++;
+	}
+
+	tx_account(rc, mono_now_ns() - t0);
+
+	return rc;
+}
+
+/* a leading 0, the timings up to the last mark and the gap after it as the
+ * inter key delay, which is then waited out */
+static int tx_sequence(const uint32_t *seq, uint16_t len)
+{
+	uint16_t buf[PRONTO_MAX_TIMINGS];
+	uint32_t gap = seq[len - 1];
+	uint16_t i;
+	int rc;
+
+	buf[0] = 0;
+	for (i = 0; i < len - 1; i++)
+		buf[i + 1] = seq[i] > UINT16_MAX ? UINT16_MAX : seq[i];
+
+	rc = tx_raw(buf, len, gap > UINT16_MAX ? UINT16_MAX : gap, 1);
+	mono_sleep_us(gap);
+
+	return rc;
+}
+
+int tx_pronto_raw(const struct pronto_raw *raw, uint8_t rep)
+{
+	const uint32_t *once = raw->buf;
+	const uint32_t *repeat = &raw->buf[raw->once];
+	int rc;
+
+	if (raw->once && (rc = tx_sequence(once, raw->once)) < 0)
+		return rc;
+
+	while (rep--) {
+		if (raw->repeat)
+			rc = tx_sequence(repeat, raw->repeat);
+		else
+			rc = tx_sequence(once, raw->once);
+		if (rc < 0)
+			return rc;
+	}
+
+	return 0;
+}
+
+void tx_stats_encode(uint64_t ns)
+{
+	tx_register();
+	hist_record(&tx_encode, ns);
+	pending_encode = ns;
+}
+
+void tx_stats_get(struct tx_stats *st)
+{
+	*st = stats;
+}
+
+void tx_stats_reset(void)
+{
+	memset(&stats, 0, sizeof(stats));
+	hist_reset(&tx_encode);
+	hist_reset(&tx_usb);
+	hist_reset(&tx_total);
+	pending_encode = 0;
+}
+
+int tx_stats_print(FILE *fp)
+{
+	if (!stats.calls)
+		return 0;
+
+	fprintf(fp, "tx calls:        %llu\n", (unsigned long long)stats.calls);
+	fprintf(fp, "tx sent:         %llu\n", (unsigned long long)stats.sent);
+	fprintf(fp, "tx bytes:        %llu\n", (unsigned long long)stats.bytes);
+	fprintf(fp, "tx retries:      %llu\n",
+			(unsigned long long)stats.retries);
+	fprintf(fp, "tx usb errors:   %llu\n",
+			(unsigned long long)stats.usb_errors);
+	fprintf(fp, "tx timeouts:     %llu\n",
+			(unsigned long long)stats.timeouts);
+	fprintf(fp, "tx other errors: %llu\n",
+			(unsigned long long)stats.errors);
+	if (stats.last_error)
+		fprintf(fp, "tx last error:   %d\n", stats.last_error);
+	fprintf(fp, "tx usb time:     %.3f ms\n", stats.usb_ns / 1e6);
+
+	return 1;
+}
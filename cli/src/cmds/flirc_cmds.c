@@ -19,7 +19,10 @@
 #include <cmds.h>
 #include <logging.h>
 
-#include <timelib.h>
+#include <monotime.h>
+#include <histogram.h>
+#include <tx_stats.h>
+#include <signal.h>
 
 static inline int enough_args(int arguments, int amount_expected)
 {
@@ -378,7 +381,7 @@ APPCMD(record_api, &record_api,
 
 CMDHANDLER(delete_index)
 {
-	int index;
+	int index, rc = 1;
 
 	if (enough_args(argc, 1) < 0) {
 		run_cmd_line("help delete_index", NULL);
@@ -392,7 +395,10 @@ CMDHANDLER(delete_index)
 	if (fl_display_config() < 0)
 		log_err("failed to load configuration\n");
 
-	fl_delete_index(index);
+	if (fl_delete_index(index) < 0) {
+		log_err("failed to delete index %d\n", index);
+		rc = -1;
+	}
 
 	fflush(stdout);
 	printf("\n\n");
@@ -404,16 +410,62 @@ CMDHANDLER(delete_index)
 
 	printf("\n");
 
-	return 1;
+	return rc;
+}
+
+/*
+ * Deleting several indexes from a script only needs the configuration shown
+ * once on either side, not twice per index. Indexes are still deleted in
+ * script order, so later indexes refer to the table after earlier deletes,
+ * and each call gets what delete_index would have returned for it. The
+ * batch stops at the first index that can't be deleted, as a script run a
+ * line at a time would.
+ */
+CMDBATCH(delete_index_batch)
+{
+	int i;
+
+	printf("Before Index Deletion\n");
+
+	if (fl_display_config() < 0)
+		log_err("failed to load configuration\n");
+
+	for (i = 0; i < ncalls; i++) {
+		if (enough_args(calls[i].argc, 1) < 0) {
+			run_cmd_line("help delete_index", NULL);
+			calls[i].status = calls[i].argc;
+			continue;
+		}
+
+		if (fl_delete_index(atoi(calls[i].argv[0])) < 0) {
+			log_err("failed to delete index %s\n",
+					calls[i].argv[0]);
+			calls[i].status = -1;
+			break;
+		}
+		calls[i].status = 1;
+	}
+
+	fflush(stdout);
+	printf("\n\n");
+
+	printf("After Index Deletion\n");
+
+	if (fl_display_config() < 0)
+		log_err("failed to save configuration\n");
+
+	printf("\n");
+
+	return 0;
 }
 
-APPCMD(delete_index, &delete_index,
+APPCMD_BATCH(delete_index, &delete_index, &delete_index_batch,
 		"Delete button at index displayed in `flirc_util settings`",
 		"usage: \n"
 		"  delete_index <index> \n"
 		"example: \n"
 		"  flirc delete_index 0",
-		NULL);
+		NULL, NULL);
 
 
 CMDHANDLER(delete)
@@ -453,9 +505,6 @@ APPCMD(normal, &normal,
 
 CMDHANDLER(saveconfig)
 {
-#ifdef CONFIG_DEBUG
-	struct timeval s;
-#endif
 	char file_name[300];
 
 	if (enough_args(argc, 1) < 0) {
@@ -468,14 +517,10 @@ CMDHANDLER(saveconfig)
 	printf("\nSaving Configuration File '%s' to Disk\n", file_name);
 
 #ifdef CONFIG_DEBUG
-	gettimeofday(&s, NULL);
+	MONO_SCOPED_TIMER("saveconfig");
 #endif
 	if (fl_save_config(file_name) == EOK) {
 		printf("\n\nConfiguration File saved\n\n");
-#ifdef CONFIG_DEBUG
-		printf("\n\nTook %d ms\n\n",
-				(int)time_elapsed_us(&s)/(1000));
-#endif
 	}
 
 	return 1;
@@ -928,6 +973,8 @@ APPCMD(reboot, &reboot_flirc,
 		"  flirc_util reboot\n",
 		NULL);
 
+#define DEVICE_LOG_POLL_US	100
+
 static void dump_log(void)
 {
 	char buf[2048];
@@ -972,8 +1019,7 @@ APPCMD_OPT(mode, &mode,
 
 CMDHANDLER(device_log)
 {
-	struct timeval s;
-	gettimeofday(&s, NULL);
+	uint64_t next, now;
 	uint8_t persist = 0;
 
 	if (dict_has_key(opts, "ir")) {
@@ -990,10 +1036,15 @@ CMDHANDLER(device_log)
 		persist = 1;
 	}
 
+	next = mono_now_ns();
 	do {
-		gettimeofday(&s, NULL);
 		dump_log();
-		while (!time_has_elapsed_us(&s, 100));
+
+		/* sleep to the next poll, don't burst to catch up if late */
+		next += DEVICE_LOG_POLL_US * 1000;
+		if ((now = mono_now_ns()) > next)
+			next = now;
+		mono_sleep_until(next);
 	} while (persist);
 
 	return argc;
@@ -1012,6 +1063,101 @@ APPCMD_OPT(device_log, &device_log,
 		"  - this command clears the log on the device\n",
 		NULL, device_log_opts);
 
+/* receive path latencies, kept for the life of the process so a shell or
+ * script can listen more than once and see the combined result */
+static struct histogram rx_poll = HISTOGRAM_INIT("rx.poll");
+static struct histogram rx_interval = HISTOGRAM_INIT("rx.interval");
+
+static volatile sig_atomic_t stats_stop;
+
+static void stats_interrupt(int sig)
+{
+	stats_stop = 1;
+}
+
+static int stats_listen(unsigned long frames)
+{
+	struct ir_packet p;
+	void (*prev)(int);
+	uint64_t t0, t1, last = 0;
+	unsigned long n = 0;
+	int rc = 0;
+
+	hist_register(&rx_poll);
+	hist_register(&rx_interval);
+
+	stats_stop = 0;
+	prev = signal(SIGINT, stats_interrupt);
+
+	printf("Press buttons on a remote, Ctrl+C to stop\n");
+
+	while (!stats_stop && (!frames || n < frames)) {
+		t0 = mono_now_ns();
+		rc = fl_ir_packet_poll(&p);
+		t1 = mono_now_ns();
+
+		if (rc < 0) {
+			logerror("unable to poll for ir packets (%d)\n", rc);
+			break;
+		} else if (rc == 0) {
+			continue;
+		}
+
+		hist_record(&rx_poll, t1 - t0);
+		if (last)
+			hist_record(&rx_interval, t1 - last);
+		last = t1;
+		n++;
+	}
+
+	signal(SIGINT, prev);
+	printf("\n%lu frame(s) received\n\n", n);
+
+	return rc < 0 ? -1 : 0;
+}
+
+CMDHANDLER(stats)
+{
+	if (dict_has_key(opts, "reset")) {
+		hist_reset_all();
+		tx_stats_reset();
+	}
+
+	if (dict_has_key(opts, "listen")) {
+		const char *val = dict_str_for_key(opts, "listen");
+		unsigned long frames = val ? strtoul(val, NULL, 10) : 0;
+
+		if (stats_listen(frames) < 0)
+			return -1;
+	}
+
+	if (tx_stats_print(stdout))
+		printf("\n");
+
+	if (!hist_print_all(stdout, "us", 1000.0))
+		printf("No latency samples recorded\n");
+
+	return argc;
+}
+
+START_CMD_OPTS(stats_opts)
+	CMD_OPT(listen, 'l', "listen",
+			"--listen=<frames>, poll for frames, 0 until Ctrl+C")
+	CMD_OPT(reset, 'r', "reset", "clear everything recorded so far")
+END_CMD_OPTS;
+
+APPCMD_OPT(stats, &stats,
+		"Receive and transmit path latency percentiles",
+		"usage: \n"
+		"  stats [--reset] [--listen=<frames>]\n"
+		"  - rx.poll is the time spent in the poll that returned a frame\n"
+		"  - rx.interval is the time between consecutive frames\n"
+		"  - tx.encode is the host parsing or encoding a pattern\n"
+		"  - tx.usb is the transfer and the device acknowledging it\n"
+		"  - tx counters and timings cover sendir in this session\n"
+		"  - percentiles are shown in microseconds\n",
+		NULL, stats_opts);
+
 CMDHANDLER(rom_table)
 {
 	uint8_t table_id;
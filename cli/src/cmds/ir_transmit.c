@@ -14,8 +14,11 @@
 
 #include <cmds.h>
 #include <flirc/flirc.h>
+#include <hexdump.h>
 #include <logging.h>
-#include <timelib.h>
+#include <monotime.h>
+#include <pronto.h>
+#include <tx_stats.h>
 
 #ifndef IS_ODD
 #define IS_ODD(x)			(x & 0x1)
@@ -47,7 +50,7 @@ static int sendRaw(uint16_t *data, int len, int ik, int repeats)
 	printf("\n");
 	printf("-%d\n", ik);
 
-	if ((rq = fl_transmit_raw(buf, len, ik, repeats)) < 0) {
+	if ((rq = tx_raw(buf, len, ik, repeats)) < 0) {
 		return rq;
 	}
 
@@ -56,7 +59,10 @@ static int sendRaw(uint16_t *data, int len, int ik, int repeats)
 
 static void decode_pronto(const char *line, int repeats)
 {
-	uint16_t buf[100];
+	uint64_t t0 = mono_now_ns();
+	uint16_t buf[PRONTO_MAX_WORDS];
+	struct pronto_raw raw;
+	int rq;
 	ssize_t len = 0;
 	int i = 0;
 
@@ -67,6 +73,11 @@ static void decode_pronto(const char *line, int repeats)
 
 	/* convert string to buf */
 	while (i < strlen(line)) {
+		if (len == PRONTO_MAX_WORDS) {
+			logerror("pronto code longer than %d words\n",
+					PRONTO_MAX_WORDS);
+			return;
+		}
 		buf[len++] = strtol(&line[i], NULL, 16);
 		while ((line[i] != ' ' && line[i] != ',' && i < strlen(line))) {
 			i++;
@@ -74,11 +85,20 @@ static void decode_pronto(const char *line, int repeats)
 		i++;
 	}
 
-	flirc_send_pronto(buf, len, repeats);
+	rq = ir_pronto_to_raw(buf, len, &raw);
+
+	tx_stats_encode(mono_now_ns() - t0);
+
+	/* anything we don't convert goes to the library as it is */
+	if (rq == 0)
+		tx_pronto_raw(&raw, repeats);
+	else
+		tx_pronto(buf, len, repeats);
 }
 
 static void decode_raw(const char *line, int ik, int repeats)
 {
+	uint64_t t0 = mono_now_ns();
 	uint16_t buf[100];
 	ssize_t len = 0;
 	int i = 0;
@@ -100,6 +120,7 @@ static void decode_raw(const char *line, int ik, int repeats)
 		i += 2;
 	}
 
+	tx_stats_encode(mono_now_ns() - t0);
 	if (sendRaw(buf, len, ik, repeats) < 0) {
 		log_err("Error sending pattern\n");
 	}
@@ -213,6 +234,7 @@ CMDHANDLER(sendir)
 			return argc;
 		}
 
+		uint64_t t0 = mono_now_ns();
 		int buf_size = 0;
 		char *token;
 		char *rest = (char *)val;
@@ -237,8 +259,14 @@ CMDHANDLER(sendir)
 			return -1;
 		}
 
+		tx_stats_encode(mono_now_ns() - t0);
+
+		if (__loglevel >= LOGLEVEL_VERBOSE)
+			hexdump_to(log_hexdump, (void *)LOGLEVEL_VERBOSE, buf,
+					buf_size * sizeof(buf[0]));
+
 		printf("Transmitting IR Pattern...");
-		if (fl_transmit_raw(buf, buf_size, ik_delay, repeat) < 0) {
+		if (tx_raw(buf, buf_size, ik_delay, repeat) < 0) {
 			log_err("Error: could not transmit data\n");
 		}
 
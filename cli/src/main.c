@@ -40,6 +40,8 @@
 #include <stdlib.h>
 #include <string.h>
 #include <libgen.h>
+#include <pthread.h>
+#include <signal.h>
 
 #include <flirc/flirc.h>
 /*
@@ -62,6 +64,49 @@ const char *default_cmds[] = {
 extern int (*precmdfuncs[])(struct appdata_priv *priv);
 extern int (*postcmdfuncs[])(struct appdata_priv *priv);
 
+static sigset_t intr;
+
+/*
+ * SIGINT is blocked in every thread and waited for here, out of signal
+ * context, so whatever the async logger still holds can be flushed. Then it
+ * takes the default action, and a Ctrl+C ends the program at once, in the
+ * middle of a looping command or one blocked in libflirc as much as between
+ * commands. The device isn't closed, the main thread may be mid transfer.
+ */
+static void *ex_program(void *arg)
+{
+	int sig;
+
+	if (sigwait(&intr, &sig) != 0)
+		return NULL;
+
+	log_flush();
+	printf("\n");
+	fflush(stdout);
+
+	signal(sig, SIG_DFL);
+	pthread_sigmask(SIG_UNBLOCK, &intr, NULL);
+	raise(sig);
+
+	return NULL;
+}
+
+static void ex_program_start(void)
+{
+	pthread_t t;
+
+	sigemptyset(&intr);
+	sigaddset(&intr, SIGINT);
+
+	/* threads started after this inherit the mask, the logger's too */
+	pthread_sigmask(SIG_BLOCK, &intr, NULL);
+	if (pthread_create(&t, NULL, ex_program, NULL) != 0) {
+		pthread_sigmask(SIG_UNBLOCK, &intr, NULL);
+		return;
+	}
+	pthread_detach(t);
+}
+
 int main(int argc, const char * argv[])
 {
 	int status = 0;
@@ -95,6 +140,8 @@ int main(int argc, const char * argv[])
 
 	rq = fl_open_device(0x20A0, "flirc.tv");
 
+	ex_program_start();
+
 	if (argc > 1 && (rq < 0) && strcmp(argv[1], "help") != 0 &&
 			(strcmp(argv[1], "upgrade") != 0) &&
 			(strcmp(argv[1], "wait") != 0)) {
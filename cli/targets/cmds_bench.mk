@@ -0,0 +1,29 @@
+CONFIGS := release
+
+# Sources
+SOURCES :=	bench/cmds_bench.c \
+		lib/logging.c \
+		lib/logfmt.c \
+		lib/monotime.c \
+		lib/getline.c \
+		lib/arena.c \
+		lib/dict.c \
+		lib/cmds.c \
+		lib/cmds_script.c \
+
+# Host-only benchmark, no device libraries needed
+LIBRARIES := pthread
+
+# Count heap allocations made by the benchmarked code
+ifneq ($(HOSTOS), DARWIN)
+OPTIONS += CMDS_BENCH_WRAP_MALLOC
+LDFLAGS += -Wl,--wrap=malloc
+endif
+
+# Release Config
+ifeq ($(CONFIG),release)
+# Options
+OPTIONS += MAX_LOGLEVEL=3 DEFAULT_LOGLEVEL=2
+# Flags
+CFLAGS += -O2
+endif
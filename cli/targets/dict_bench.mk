@@ -0,0 +1,22 @@
+CONFIGS := release
+
+# Sources
+SOURCES :=	bench/dict_bench.c \
+		lib/logging.c \
+		lib/logfmt.c \
+		lib/monotime.c \
+		lib/arena.c \
+		lib/dict.c \
+		lib/dict_view.c \
+		lib/cmds.c \
+
+# Host-only benchmark, no device libraries needed
+LIBRARIES := pthread
+
+# Release Config
+ifeq ($(CONFIG),release)
+# Options
+OPTIONS += MAX_LOGLEVEL=3 DEFAULT_LOGLEVEL=2
+# Flags
+CFLAGS += -O2
+endif
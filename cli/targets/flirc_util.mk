@@ -4,7 +4,14 @@ CONFIGS := debug release
 SOURCES :=	src/main.c \
 		src/prepost.c \
 		lib/logging.c \
+		lib/logfmt.c \
+		lib/monotime.c \
+		lib/histogram.c \
+		lib/tx_stats.c \
+		lib/pronto.c \
 		lib/getline.c \
+		lib/hexdump.c \
+		lib/arena.c \
 		lib/dict.c \
 		lib/cmds.c \
 		lib/cmds_script.c \
@@ -12,7 +19,7 @@ SOURCES :=	src/main.c \
 		src/cmds/ir_transmit.c \
 
 # Libraries
-LIBRARIES  += flirc
+LIBRARIES  += flirc pthread
 
 ifeq ($(ISHELL), 1)
 LIBRARIES += readline
@@ -0,0 +1,14 @@
+CONFIGS := release
+
+# Sources
+SOURCES :=	tools/logdecode.c \
+		lib/logfmt.c \
+
+# Host-only tool, no device libraries needed
+LIBRARIES :=
+
+# Release Config
+ifeq ($(CONFIG),release)
+# Flags
+CFLAGS += -O2
+endif
@@ -0,0 +1,16 @@
+CONFIGS := release
+
+# Sources
+SOURCES :=	bench/pronto_bench.c \
+		lib/pronto.c \
+
+# Host-only benchmark, no device libraries needed
+LIBRARIES := pthread
+
+# Release Config
+ifeq ($(CONFIG),release)
+# Options
+OPTIONS += MAX_LOGLEVEL=3 DEFAULT_LOGLEVEL=2
+# Flags
+CFLAGS += -O2
+endif
@@ -0,0 +1,193 @@
+/**
+ * COPYRIGHT 2024 Flirc, Inc. All rights reserved.
+ *
+ * This copyright notice is Copyright Management Information under 17 USC 1202
+ * and is included to protect this work and deter copyright infringement.
+ * Removal or alteration of this Copyright Management Information without
+ * the express written permission of Flirc, Inc. is prohibited, and any
+ * such unauthorized removal or alteration will be a violation of federal law.
+ */
+
+/*
+ * logdecode.c - Formats a binary log written by `loglevel --binary'.
+ *
+ * Each message is printed as it would have been on stderr, prefixed with
+ * its monotonic timestamp in seconds.
+ *
+ * usage: logdecode <file>
+ *   a - for <file> reads from stdin
+ */
+
+#include <logbin.h>
+#include <logfmt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define LINE_MAX_LEN		(4096)
+
+struct site {
+	char level;
+	char tag;
+	uint32_t line;
+	char *file;
+	char *func;
+	char *fmt;
+};
+
+static struct site *sites;
+static size_t nsites;
+
+static int read_exact(FILE *fp, void *buf, size_t size)
+{
+	return (fread(buf, 1, size, fp) == size) ? 0 : -1;
+}
+
+static char *read_str(FILE *fp, size_t len)
+{
+	char *s;
+
+	if((s = malloc(len + 1)) == NULL)
+		return NULL;
+	if(read_exact(fp, s, len) < 0) {
+		free(s);
+		return NULL;
+	}
+	s[len] = '\0';
+
+	return s;
+}
+
+static int define_site(FILE *fp)
+{
+	struct logbin_define d;
+	struct site *s;
+
+	if(read_exact(fp, (uint8_t *)&d + 1, sizeof(d) - 1) < 0)
+		return -1;
+
+	if(d.id >= nsites) {
+		size_t n = nsites ? nsites : 64;
+		while(n <= d.id)
+			n *= 2;
+		if((s = realloc(sites, n * sizeof(*s))) == NULL)
+			return -1;
+		memset(&s[nsites], 0, (n - nsites) * sizeof(*s));
+		sites = s;
+		nsites = n;
+	}
+
+	s = &sites[d.id];
+	s->level = d.level;
+	s->tag = d.tag;
+	s->line = d.line;
+	if(((s->file = read_str(fp, d.file_len)) == NULL) ||
+			((s->func = read_str(fp, d.func_len)) == NULL) ||
+			((s->fmt = read_str(fp, d.fmt_len)) == NULL))
+		return -1;
+
+	return 0;
+}
+
+static void print_ts(uint64_t ts_ns)
+{
+	printf("[%5lu.%06lu] ", (unsigned long)(ts_ns / 1000000000ull),
+			(unsigned long)((ts_ns % 1000000000ull) / 1000));
+}
+
+static int print_msg(FILE *fp)
+{
+	static unsigned char args[UINT16_MAX];
+	static char line[LINE_MAX_LEN];
+	struct logbin_msg m;
+	struct site *s;
+
+	if(read_exact(fp, (uint8_t *)&m + 1, sizeof(m) - 1) < 0)
+		return -1;
+	if(read_exact(fp, args, m.len) < 0)
+		return -1;
+
+	if((m.id >= nsites) || (sites[m.id].fmt == NULL)) {
+		fprintf(stderr, "message for undefined site %u\n", m.id);
+		return -1;
+	}
+	s = &sites[m.id];
+
+	logfmt_render(line, sizeof(line), s->fmt, args, m.len);
+
+	print_ts(m.ts_ns);
+	printf("[%c] %s %s(%u): %s%s", s->tag, s->file, s->func, s->line,
+			line, (m.flags & LOGFMT_TRUNCATED) ? " [truncated]\n" : "");
+
+	return 0;
+}
+
+static int print_drop(FILE *fp)
+{
+	struct logbin_drop d;
+
+	if(read_exact(fp, (uint8_t *)&d + 1, sizeof(d) - 1) < 0)
+		return -1;
+
+	print_ts(d.ts_ns);
+	printf("[W] logging: %u message(s) dropped\n", d.count);
+
+	return 0;
+}
+
+int main(int argc, const char *argv[])
+{
+	struct logbin_hdr h, want;
+	FILE *fp = stdin;
+	int type, ret = 0;
+
+	if(argc != 2) {
+		fprintf(stderr, "usage: logdecode <file>\n");
+		return 1;
+	}
+	if((strcmp(argv[1], "-") != 0) &&
+			((fp = fopen(argv[1], "rb")) == NULL)) {
+		perror(argv[1]);
+		return 1;
+	}
+
+	logbin_hdr_init(&want);
+	if((read_exact(fp, &h, sizeof(h)) < 0) ||
+			(memcmp(h.magic, want.magic, LOGBIN_MAGIC_LEN) != 0)) {
+		fprintf(stderr, "%s: not a binary log\n", argv[1]);
+		return 1;
+	}
+	if(memcmp(&h, &want, sizeof(h)) != 0) {
+		fprintf(stderr, "%s: written on a host with different type "
+				"sizes or byte order\n", argv[1]);
+		return 1;
+	}
+
+	while((type = getc(fp)) != EOF) {
+		switch(type) {
+		case LOGBIN_DEFINE:
+			ret = define_site(fp);
+			break;
+		case LOGBIN_MSG:
+			ret = print_msg(fp);
+			break;
+		case LOGBIN_DROP:
+			ret = print_drop(fp);
+			break;
+		default:
+			fprintf(stderr, "unknown record type %d\n", type);
+			ret = -1;
+			break;
+		}
+		if(ret < 0) {
+			fprintf(stderr, "%s: truncated or corrupt log\n",
+					argv[1]);
+			break;
+		}
+	}
+
+	if(fp != stdin)
+		fclose(fp);
+
+	return ret < 0 ? 1 : 0;
+}
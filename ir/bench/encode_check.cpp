@@ -0,0 +1,239 @@
+/**
+ * COPYRIGHT 2024 Flirc, Inc. All rights reserved.
+ *
+ * This copyright notice is Copyright Management Information under 17 USC 1202
+ * and is included to protect this work and deter copyright infringement.
+ * Removal or alteration of this Copyright Management Information without
+ * the express written permission of Flirc, Inc. is prohibited, and any
+ * such unauthorized removal or alteration will be a violation of federal law.
+ */
+
+/*
+ * encode_check.cpp - Checks ir/encode.hpp against this libir's ir_encode().
+ *
+ * Every protocol both can encode is run over the walking ones, all zeros,
+ * all ones and a run of random scancodes, and the buffers, lengths and
+ * elapsed compared edge for edge. ir_encode() flips the RC5 and RC6 toggle
+ * on every call, so the toggle is taken from the first frame and expected
+ * to alternate after that.
+ *
+ * libir can't encode Samsung, its frames go through ir_decode_packet()
+ * instead, which reads them as one of the NEC variants. Nothing in libir
+ * handles JVC, so that isn't checked.
+ *
+ * The first mismatch for each protocol is printed, and the exit status is
+ * 1 if there were any.
+ *
+ * usage: encode_check [--scancodes=N] [--seed=N]
+ */
+
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+#include <ir/ir.h>
+#include <ir/encode.hpp>
+
+#define DEFAULT_SCANCODES	(100000)
+#define DEFAULT_SEED		(0x1F1C)
+
+/* tables built by the compiler, these never reach the encoder at run time */
+static constexpr auto nec_power = ir::code<RC_PROTO_NEC, 0x04FB>();
+static constexpr auto sony_power = ir::code<RC_PROTO_SONY12, 0x09500000>();
+static constexpr auto rc5_power = ir::code<RC_PROTO_RC5, 0x000C, true>();
+static constexpr auto samsung_power = ir::samsung32_code<0xE0E040BF>();
+
+static_assert(nec_power.buf.size() == 67 && nec_power.elapsed == 40,
+		"NEC frame shape");
+static_assert(nec_power.buf[0] == 9000 && nec_power.buf[3] == 1690 &&
+		nec_power.buf[7] == 560, "NEC 0x04FB bits");
+static_assert(sony_power.buf.size() == 25, "SONY12 frame shape");
+static_assert(rc5_power.buf[0] == 889 && rc5_power.buf[3] == 889,
+		"RC5 toggle");
+static_assert(samsung_power.buf.size() == 67 &&
+		samsung_power.buf[0] == 4500 && samsung_power.buf[1] == 4500,
+		"SAMSUNG32 frame shape");
+
+static const enum rc_proto checked[] = {
+	RC_PROTO_NEC,
+	RC_PROTO_NECX,
+	RC_PROTO_NEC32,
+	RC_PROTO_SONY12,
+	RC_PROTO_SONY15,
+	RC_PROTO_SONY20,
+	RC_PROTO_RC5,
+	RC_PROTO_RC6_0,
+};
+
+static uint32_t rng(uint32_t *s)
+{
+	/* xorshift32 */
+	*s ^= *s << 13;
+	*s ^= *s >> 17;
+	*s ^= *s << 5;
+	return *s;
+}
+
+static bool same(const ir::waveform &w, const struct ir_packet &p)
+{
+	return w.len == p.len && w.elapsed == p.elapsed &&
+		!memcmp(w.buf, p.buf, w.len * sizeof(w.buf[0]));
+}
+
+static void print(const char *what, const uint16_t *buf, unsigned int len)
+{
+	unsigned int i;
+
+	printf("    %-8s", what);
+	for (i = 0; i < len; i++)
+		printf(" %u", buf[i]);
+	printf("\n");
+}
+
+static uint32_t scancode(unsigned int i, uint32_t *seed)
+{
+	if (i < 32)
+		return 1u << i;
+	if (i == 32)
+		return 0;
+	if (i == 33)
+		return 0xFFFFFFFF;
+	return rng(seed);
+}
+
+/* returns the number of mismatches */
+static unsigned long check(enum rc_proto proto, unsigned int n, uint32_t seed)
+{
+	unsigned long bad = 0;
+	bool toggle = false;
+	unsigned int i;
+
+	for (i = 0; i < n; i++) {
+		uint32_t sc = scancode(i, &seed);
+		struct ir_packet p;
+		ir::waveform w;
+
+		memset(&p, 0, sizeof(p));
+		if (ir_encode(proto, sc, &p) < 0) {
+			printf("%s: ir_encode() failed for 0x%08X\n",
+					enum_to_str(proto), sc);
+			return n;
+		}
+
+		/* libir's toggle starts wherever the last call left it */
+		if (i == 0 && !same(ir::encode(proto, sc, toggle), p))
+			toggle = !toggle;
+
+		w = ir::encode(proto, sc, toggle);
+		toggle = !toggle;
+
+		if (same(w, p))
+			continue;
+
+		if (!bad++) {
+			printf("%s: mismatch for 0x%08X\n", enum_to_str(proto),
+					sc);
+			print("libir", p.buf, p.len);
+			print("encode", w.buf, w.len);
+		}
+	}
+
+	return bad;
+}
+
+static unsigned long check_samsung(unsigned int n, uint32_t seed)
+{
+	unsigned long bad = 0;
+	unsigned int i;
+
+	for (i = 0; i < n; i++) {
+		uint32_t sc = scancode(i, &seed);
+		ir::waveform w = ir::encode_samsung32(sc);
+		struct ir_packet p;
+		struct ir_prot d;
+
+		/* a zero scancode never decodes, for any protocol */
+		if (!sc)
+			continue;
+
+		memset(&p, 0, sizeof(p));
+		memset(&d, 0, sizeof(d));
+		memcpy(p.buf, w.buf, w.len * sizeof(w.buf[0]));
+		p.len = w.len;
+		p.elapsed = w.elapsed;
+
+		/* which variant depends on the address and command bytes,
+		 * the decoder goes by which are inverted copies */
+		switch (ir_decode_packet(&p, &d)) {
+		case RC_PROTO_NEC:
+		case RC_PROTO_NECX:
+		case RC_PROTO_NEC32:
+		case RC_PROTO_NEC_APPLE:
+			if (d.scancode == sc)
+				continue;
+			break;
+		default:
+			break;
+		}
+
+		if (!bad++)
+			printf("SAMSUNG32: 0x%08X decoded as %s 0x%08X\n", sc,
+					enum_to_str(d.protocol), d.scancode);
+	}
+
+	return bad;
+}
+
+static unsigned long opt_value(const char *arg, const char *name)
+{
+	size_t len = strlen(name);
+
+	if (strncmp(arg, name, len) || arg[len] != '=')
+		return 0;
+
+	return strtoul(arg + len + 1, NULL, 0);
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned int n = DEFAULT_SCANCODES;
+	uint32_t seed = DEFAULT_SEED;
+	unsigned long bad, total = 0;
+	unsigned int i;
+
+	for (i = 1; i < (unsigned int)argc; i++) {
+		unsigned long v;
+
+		if ((v = opt_value(argv[i], "--scancodes")))
+			n = v;
+		else if ((v = opt_value(argv[i], "--seed")))
+			seed = v;
+		else {
+			printf("usage: encode_check [--scancodes=N] "
+					"[--seed=N]\n");
+			return 2;
+		}
+	}
+
+	/* walking ones and the all zero and all one codes come first */
+	if (n < 34)
+		n = 34;
+
+	printf("libir %s, %u scancodes per protocol\n", ir_lib_version(), n);
+
+	for (i = 0; i < sizeof(checked) / sizeof(checked[0]); i++) {
+		bad = check(checked[i], n, seed);
+		printf("%-10s %s\n", enum_to_str(checked[i]),
+				bad ? "FAIL" : "ok");
+		total += bad;
+	}
+
+	bad = check_samsung(n, seed);
+	printf("%-10s %s, decoded as NEC\n", "SAMSUNG32", bad ? "FAIL" : "ok");
+	total += bad;
+
+	printf("%-10s not checked, libir has no JVC support\n", "JVC");
+
+	return total ? 1 : 0;
+}
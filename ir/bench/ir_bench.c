@@ -0,0 +1,908 @@
+/**
+ * COPYRIGHT 2024 Flirc, Inc. All rights reserved.
+ *
+ * This copyright notice is Copyright Management Information under 17 USC 1202
+ * and is included to protect this work and deter copyright infringement.
+ * Removal or alteration of this Copyright Management Information without
+ * the express written permission of Flirc, Inc. is prohibited, and any
+ * such unauthorized removal or alteration will be a violation of federal law.
+ */
+
+/*
+ * ir_bench.c - Decode throughput, latency and accuracy for libir.
+ *
+ * No device is needed. A synthetic corpus is built by running ir_encode()
+ * over every enum rc_proto and a sweep of scancodes. Each clean frame is
+ * followed by noisy copies: marks stretched and spaces shortened the way a
+ * demodulating receiver does, random jitter on every edge, and now and
+ * then a glitch splitting a space. What the decoder makes of the clean
+ * frame is taken as the intended result.
+ *
+ * The report has the ir_decode_packet() throughput over the whole corpus,
+ * and for every protocol the clean and noisy accuracy and the decode
+ * latency percentiles. It also times each edge classification kernel this
+ * cpu supports (quantize.h) over the same corpus, after checking they all
+ * agree with the scalar one.
+ *
+ * candidate_decode() (candidate.h) is timed against a plain decode, and
+ * checked for how often its best candidate is what libir decoded, and for
+ * how well its confidence separates the noisy frames that decoded right
+ * from the ones that didn't.
+ *
+ * Pairs of frames are joined into one packet with a gap between them, to
+ * count how many segment_split() (segment.h) recovers over a plain decode.
+ * Handing each frame to several consumers is timed by copy and through a
+ * pool (pool.h). The corpus is packed into variable length frames
+ * (frame.h), for the bytes a frame and a result take against the fixed
+ * types and what ir_frame_decode() costs over a plain decode.
+ *
+ * --generate writes a small corpus with a fixed seed, recording both the
+ * intended result and what this libir decoded, and --corpus replays one.
+ * bench/corpus.txt is checked in so a new SDK drop can be compared against
+ * the previous one on identical input; frames that decode differently are
+ * listed and the exit status is 1 if any got worse.
+ *
+ * usage: ir_bench [--scancodes=N] [--rounds=N] [--seed=N] [--jitter=PCT]
+ *                 [--bias=US] [--glitch=PCT] [--verbose]
+ *        ir_bench --generate=<file>
+ *        ir_bench --corpus=<file>
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <ir/ir.h>
+
+#include <histogram.h>
+#include <monotime.h>
+
+#include "candidate.h"
+#include "frame.h"
+#include "noise.h"
+#include "pool.h"
+#include "quantize.h"
+#include "segment.h"
+
+#define IR_PROTO_COUNT		(RC_PROTO_GAP + 1)
+
+#define DEFAULT_SCANCODES	(64)
+#define DEFAULT_ROUNDS		(20)
+#define DEFAULT_SEED		(0x1F1C)
+#define DEFAULT_JITTER		(4)	/* percent of each edge */
+#define DEFAULT_BIAS		(60)	/* us added to marks, taken off spaces */
+#define DEFAULT_GLITCH		(2)	/* percent of noisy frames */
+
+/* noisy copies made of each clean frame */
+#define NOISY_PER_CLEAN		(3)
+
+/* --generate keeps the checked in corpus small */
+#define GENERATE_SCANCODES	(4)
+
+#define MAX_FRAME_EDGES		(256)
+
+/* NEC, RC5 and RC6 timings, us */
+static const uint16_t bench_quanta[] = { 560, 889, 1690, 2666, 4500, 9000 };
+#define QUANT_TOLERANCE		(20)
+
+struct bench_opts {
+	unsigned int scancodes;
+	unsigned int rounds;
+	uint64_t seed;
+	struct ir_noise noise;
+};
+
+/**
+ * struct bench_frame - one frame and what it should decode to
+ *
+ * @p:          timings handed to the decoder
+ * @encoded:    protocol passed to ir_encode()
+ * @want:       protocol the clean frame decoded as
+ * @want_sc:    scancode the clean frame decoded as
+ * @had:        recorded result, only for frames loaded with --corpus
+ * @had_sc:     recorded scancode, only for frames loaded with --corpus
+ * @noisy:      non-zero for a noisy copy
+ */
+struct bench_frame {
+	struct ir_packet p;
+	enum rc_proto encoded;
+	enum rc_proto want;
+	uint32_t want_sc;
+	enum rc_proto had;
+	uint32_t had_sc;
+	int noisy;
+};
+
+struct bench_corpus {
+	struct bench_frame *frames;
+	size_t count;
+	size_t cap;
+};
+
+struct proto_result {
+	uint64_t clean;
+	uint64_t clean_ok;
+	uint64_t noisy;
+	uint64_t noisy_ok;
+	struct histogram *lat;
+};
+
+static int decoded_ok(enum rc_proto p)
+{
+	return p != RC_PROTO_UNKNOWN && p != RC_PROTO_INVALID;
+}
+
+static struct bench_frame *corpus_add(struct bench_corpus *c)
+{
+	if (c->count == c->cap) {
+		size_t cap = c->cap ? c->cap * 2 : 1024;
+		void *n = realloc(c->frames, cap * sizeof(c->frames[0]));
+
+		if (n == NULL)
+			return NULL;
+		c->frames = n;
+		c->cap = cap;
+	}
+
+	memset(&c->frames[c->count], 0, sizeof(c->frames[0]));
+
+	return &c->frames[c->count++];
+}
+
+/**
+ * Encodes every protocol over a scancode sweep. The first two scancodes are
+ * always 0 and all ones, the rest are random. Protocols libir can't encode
+ * are flagged in @encodable and skipped.
+ */
+static int build_corpus(struct bench_corpus *c, const struct bench_opts *o,
+		int encodable[IR_PROTO_COUNT])
+{
+	uint64_t rng = o->seed;
+	struct ir_prot d;
+	int proto;
+
+	for (proto = 0; proto < IR_PROTO_COUNT; proto++) {
+		unsigned int s, n;
+
+		encodable[proto] = 0;
+
+		for (s = 0; s < o->scancodes; s++) {
+			uint32_t sc = s == 0 ? 0 : s == 1 ? 0xFFFFFFFF :
+				(uint32_t)noise_rng(&rng);
+			struct ir_packet clean;
+			struct bench_frame *f;
+
+			memset(&clean, 0, sizeof(clean));
+			if (ir_encode(proto, sc, &clean) < 0 || clean.len == 0)
+				break;
+			encodable[proto] = 1;
+
+			if ((f = corpus_add(c)) == NULL)
+				return -1;
+			f->p = clean;
+			f->encoded = proto;
+
+			/* decode a scratch copy, the decoder may write to it */
+			f->want = ir_decode_packet(&clean, &d);
+			f->want_sc = d.scancode;
+
+			for (n = 0; n < NOISY_PER_CLEAN; n++) {
+				struct bench_frame *nf;
+
+				if ((nf = corpus_add(c)) == NULL)
+					return -1;
+				/* corpus_add may have moved the clean frame */
+				f = nf - 1 - n;
+				*nf = *f;
+				nf->noisy = 1;
+				noise_apply(&nf->p, &rng, &o->noise);
+			}
+		}
+	}
+
+	return 0;
+}
+
+/**
+ * Reads a corpus written by --generate. Each frame is preceded by a comment
+ * holding the encoded protocol, the intended result and the recorded
+ * result, and followed by the timings in `ir decode` format.
+ */
+static int load_corpus(const char *path, struct bench_corpus *c)
+{
+	char line[8192], enc[32], want[32], had[32];
+	unsigned int want_sc, had_sc, elapsed, noisy;
+	struct bench_frame *f = NULL;
+	FILE *fp;
+
+	if ((fp = fopen(path, "r")) == NULL) {
+		perror(path);
+		return -1;
+	}
+
+	while (fgets(line, sizeof(line), fp)) {
+		char *p = line, *end;
+
+		if (line[0] == '#') {
+			if (sscanf(line, "# frame %31s %u %31s 0x%x %31s 0x%x %u",
+					enc, &noisy, want, &want_sc, had,
+					&had_sc, &elapsed) != 7)
+				continue;
+			if ((f = corpus_add(c)) == NULL)
+				break;
+			f->encoded = str_to_enum(enc);
+			f->noisy = noisy;
+			f->want = str_to_enum(want);
+			f->want_sc = want_sc;
+			f->had = str_to_enum(had);
+			f->had_sc = had_sc;
+			f->p.elapsed = elapsed;
+			continue;
+		}
+
+		if (f == NULL)
+			continue;
+
+		while (*p && f->p.len < MAX_FRAME_EDGES) {
+			unsigned long v;
+
+			while (*p == '+' || *p == '-' || *p == ' ' || *p == ',')
+				p++;
+			v = strtoul(p, &end, 10);
+			if (end == p)
+				break;
+			f->p.buf[f->p.len++] = (uint16_t)v;
+			p = end;
+		}
+		f = NULL;
+	}
+
+	fclose(fp);
+
+	return c->count ? 0 : -1;
+}
+
+static int generate(const char *path)
+{
+	struct bench_opts o = {
+		GENERATE_SCANCODES, 0, DEFAULT_SEED,
+		{ DEFAULT_JITTER, DEFAULT_BIAS, DEFAULT_GLITCH },
+	};
+	int encodable[IR_PROTO_COUNT];
+	struct bench_corpus c = { 0 };
+	struct ir_prot d;
+	size_t i;
+	FILE *fp;
+
+	if (build_corpus(&c, &o, encodable) < 0)
+		return 1;
+
+	if ((fp = fopen(path, "w")) == NULL) {
+		perror(path);
+		return 1;
+	}
+
+	fprintf(fp, "# ir_bench reference corpus, libir %s, seed %u\n"
+			"# frame <encoded> <noisy> <intended> <scancode> "
+			"<recorded> <scancode> <elapsed>\n",
+			ir_lib_version(), DEFAULT_SEED);
+
+	for (i = 0; i < c.count; i++) {
+		struct bench_frame *f = &c.frames[i];
+		struct ir_packet p = f->p;
+		enum rc_proto got = ir_decode_packet(&p, &d);
+		int e;
+
+		fprintf(fp, "# frame %s %d %s 0x%08X %s 0x%08X %u\n",
+				enum_to_str(f->encoded), f->noisy,
+				enum_to_str(f->want), f->want_sc,
+				enum_to_str(got), d.scancode, f->p.elapsed);
+		for (e = 0; e < f->p.len; e++)
+			fprintf(fp, "%s%c%u", e ? " " : "",
+					(e & 1) ? '-' : '+', f->p.buf[e]);
+		fprintf(fp, "\n");
+	}
+
+	fclose(fp);
+	printf("wrote %zu frames to %s\n", c.count, path);
+	free(c.frames);
+
+	return 0;
+}
+
+/**
+ * One timed pass, per frame, to fill in accuracy and latency. Timing each
+ * call costs a couple of clock reads, so throughput is measured separately
+ * over whole passes.
+ */
+static void score(struct bench_corpus *c, struct proto_result *r,
+		uint64_t *improved, uint64_t *regressed, int verbose)
+{
+	struct ir_prot d;
+	size_t i;
+
+	for (i = 0; i < c->count; i++) {
+		struct bench_frame *f = &c->frames[i];
+		struct proto_result *pr = &r[f->encoded];
+		struct ir_packet p = f->p;
+		enum rc_proto got;
+		uint64_t t0, t1;
+		int ok, was_ok;
+
+		t0 = mono_now_ns();
+		got = ir_decode_packet(&p, &d);
+		t1 = mono_now_ns();
+
+		hist_record(pr->lat, t1 - t0);
+
+		ok = decoded_ok(f->want) && got == f->want &&
+			d.scancode == f->want_sc;
+
+		if (f->noisy) {
+			pr->noisy++;
+			pr->noisy_ok += ok;
+		} else {
+			pr->clean++;
+			pr->clean_ok += ok;
+		}
+
+		/* only frames loaded from a corpus have a recorded result */
+		if (improved == NULL || (got == f->had && d.scancode == f->had_sc))
+			continue;
+
+		/* differently wrong counts as neither, but is still listed */
+		was_ok = decoded_ok(f->want) && f->had == f->want &&
+			f->had_sc == f->want_sc;
+		if (ok && !was_ok)
+			(*improved)++;
+		else if (!ok && was_ok)
+			(*regressed)++;
+
+		if (verbose || !ok)
+			printf("frame %zu (%s%s): was %s 0x%08X, now %s 0x%08X\n",
+					i, enum_to_str(f->encoded),
+					f->noisy ? ", noisy" : "",
+					enum_to_str(f->had), f->had_sc,
+					enum_to_str(got), d.scancode);
+	}
+}
+
+static double throughput(struct bench_corpus *c, unsigned int rounds)
+{
+	struct ir_prot d;
+	struct ir_packet p;
+	uint64_t t0;
+	unsigned int r;
+	size_t i;
+
+	t0 = mono_now_ns();
+	for (r = 0; r < rounds; r++) {
+		for (i = 0; i < c->count; i++) {
+			p = c->frames[i].p;
+			ir_decode_packet(&p, &d);
+		}
+	}
+
+	return (double)(mono_now_ns() - t0) / ((double)rounds * c->count);
+}
+
+static double pct(uint64_t n, uint64_t d)
+{
+	return d ? 100.0 * n / d : 0.0;
+}
+
+/* confidence below which a frame counts as rejected */
+#define CANDIDATE_ACCEPT	(50)
+
+/**
+ * candidates() - Times candidate_decode() and reports how useful its
+ * ranking and confidence are over the corpus.
+ */
+static void candidates(struct bench_corpus *c, unsigned int rounds,
+		double decode_ns)
+{
+	struct candidate cand[CANDIDATE_MAX];
+	uint64_t decoded = 0, top = 0, t0;
+	uint64_t right = 0, right_kept = 0, wrong = 0, wrong_kept = 0;
+	struct ir_packet p;
+	struct ir_prot d;
+	unsigned int r;
+	double ns;
+	size_t i;
+	int n;
+
+	for (i = 0; i < c->count; i++) {
+		struct bench_frame *f = &c->frames[i];
+		int ok, kept;
+
+		p = f->p;
+		n = candidate_decode(&p, &d, cand, CANDIDATE_MAX);
+
+		if (decoded_ok(d.protocol)) {
+			decoded++;
+			top += n && cand[0].decoded;
+		}
+
+		if (!f->noisy || !decoded_ok(f->want))
+			continue;
+
+		/* what a caller dropping low confidence frames would keep */
+		kept = n && cand[0].decoded &&
+			cand[0].confidence >= CANDIDATE_ACCEPT;
+		ok = d.protocol == f->want && d.scancode == f->want_sc;
+		if (ok) {
+			right++;
+			right_kept += kept;
+		} else {
+			wrong++;
+			wrong_kept += kept;
+		}
+	}
+
+	t0 = mono_now_ns();
+	for (r = 0; r < rounds; r++) {
+		for (i = 0; i < c->count; i++) {
+			p = c->frames[i].p;
+			candidate_decode(&p, &d, cand, CANDIDATE_MAX);
+		}
+	}
+	ns = (double)(mono_now_ns() - t0) / ((double)rounds * c->count);
+
+	printf("candidates: %.0f ns/frame, %+.0f%% on a plain decode\n", ns,
+			100.0 * (ns - decode_ns) / decode_ns);
+	printf("candidates: best is libir's decode for %.1f%% of decoded "
+			"frames\n", pct(top, decoded));
+	printf("candidates: confidence >= %u keeps %.1f%% of noisy frames "
+			"decoded right, %.1f%% of those decoded wrong\n",
+			CANDIDATE_ACCEPT, pct(right_kept, right),
+			pct(wrong_kept, wrong));
+}
+
+/* inter-frame gaps made up for segments(), us */
+#define SEGMENT_GAP_MIN		(12000)
+#define SEGMENT_GAP_SPAN	(48000)
+
+/* the k'th frame split from a packet, as decoded */
+static int segment_ok(struct ir_packet *p, const struct segment *s, int k,
+		const struct bench_frame *f)
+{
+	struct ir_packet sub, *q;
+	struct ir_prot d;
+
+	q = segment_packet(p, &s[k], &sub);
+	ir_decode_packet(q, &d);
+
+	return d.protocol == f->want && d.scancode == f->want_sc;
+}
+
+/**
+ * segments() - Joins pairs of frames into one packet, the way a repeat that
+ * follows too closely arrives, and reports how many frames a plain decode
+ * and segment_split() get out of them. A quarter of the gaps have a
+ * glitch in them. Also checks no frame that decodes is split, and times
+ * the split of one.
+ */
+static void segments(struct bench_corpus *c, unsigned int rounds,
+		uint64_t seed, double decode_ns)
+{
+	struct segment seg[SEGMENT_MAX];
+	uint64_t packets = 0, whole = 0, split = 0, apart = 0, wrong = 0, t0;
+	struct bench_frame *a, *b;
+	struct ir_packet p;
+	struct ir_prot d;
+	unsigned int r, gap;
+	double ns;
+	size_t i;
+	int n;
+
+	for (i = 0; i < c->count; i++) {
+		a = &c->frames[i];
+		/* libir takes a Sharp frame's two halves one at a time, so
+		 * only a frame it decoded whole counts */
+		if (!a->noisy && decoded_ok(a->want) &&
+				segment_split(a->p.buf, a->p.len, seg,
+					SEGMENT_MAX) > 1)
+			wrong++;
+
+		/* the first frame must end on a mark. ir_encode() ends some
+		 * RC5 frames on a half bit space, which libir then reads as
+		 * RC5_SZ, and that space would be lost in the gap */
+		b = &c->frames[noise_rng(&seed) % c->count];
+		if (!decoded_ok(a->want) || !decoded_ok(b->want) ||
+				a->p.len % 2 == 0 ||
+				a->p.len + b->p.len + 3 > MAX_FRAME_EDGES)
+			continue;
+
+		p = a->p;
+		gap = SEGMENT_GAP_MIN + noise_rng(&seed) % SEGMENT_GAP_SPAN;
+		if (noise_rng(&seed) % 4 == 0) {
+			p.buf[p.len++] = gap / 2;
+			p.buf[p.len++] = NOISE_GLITCH_US;
+			p.buf[p.len++] = gap / 2;
+		} else {
+			p.buf[p.len++] = gap;
+		}
+		memcpy(&p.buf[p.len], b->p.buf, b->p.len * sizeof(p.buf[0]));
+		p.len += b->p.len;
+		packets++;
+
+		n = segment_split(p.buf, p.len, seg, SEGMENT_MAX);
+		if (n == 2)
+			split += segment_ok(&p, seg, 0, a) +
+				segment_ok(&p, seg, 1, b);
+
+		ir_decode_packet(&p, &d);
+		whole += d.protocol == a->want && d.scancode == a->want_sc;
+
+		p = a->p;
+		ir_decode_packet(&p, &d);
+		apart += d.protocol == a->want && d.scancode == a->want_sc;
+		p = b->p;
+		ir_decode_packet(&p, &d);
+		apart += d.protocol == b->want && d.scancode == b->want_sc;
+	}
+
+	t0 = mono_now_ns();
+	for (r = 0; r < rounds; r++) {
+		for (i = 0; i < c->count; i++) {
+			p = c->frames[i].p;
+			segment_split(p.buf, p.len, seg, SEGMENT_MAX);
+		}
+	}
+	ns = (double)(mono_now_ns() - t0) / ((double)rounds * c->count);
+
+	printf("segments: %llu packets of two frames, %.1f%% of the frames "
+			"decode whole, %.1f%% split, %.1f%% sent apart\n",
+			(unsigned long long)packets, pct(whole, 2 * packets),
+			pct(split, 2 * packets), pct(apart, 2 * packets));
+	printf("segments: %.0f ns to split a frame, %.1f%% of a decode, "
+			"%llu decodable frames split\n", ns,
+			100.0 * ns / decode_ns, (unsigned long long)wrong);
+}
+
+/* consumers each frame goes to in pooled(), as listen's output, recorder
+ * and a statistics pass would take it */
+#define POOL_CONSUMERS		(3)
+
+/**
+ * pooled() - Times handing each frame to POOL_CONSUMERS consumers, by a
+ * copy each and by reference to one pooled frame.
+ */
+static void pooled(struct bench_corpus *c, unsigned int rounds)
+{
+	static struct ir_packet copies[POOL_CONSUMERS];
+	struct ir_packet *held[POOL_CONSUMERS];
+	struct ir_packet polled, *p;
+	struct pool *pool;
+	uint64_t t0, frames = (uint64_t)rounds * c->count;
+	volatile uint32_t seen = 0;
+	double copy_ns, pool_ns;
+	unsigned int r, k;
+	size_t i;
+
+	if ((pool = pool_new(sizeof(struct ir_packet), POOL_CONSUMERS)) ==
+			NULL)
+		return;
+
+	/* each consumer looks at its frame, so no copy can be left out */
+	t0 = mono_now_ns();
+	for (r = 0; r < rounds; r++) {
+		for (i = 0; i < c->count; i++) {
+			polled = c->frames[i].p;
+			for (k = 0; k < POOL_CONSUMERS; k++) {
+				copies[k] = polled;
+				seen += copies[k].buf[copies[k].len - 1];
+			}
+		}
+	}
+	copy_ns = (double)(mono_now_ns() - t0) / frames;
+
+	t0 = mono_now_ns();
+	for (r = 0; r < rounds; r++) {
+		for (i = 0; i < c->count; i++) {
+			/* filled in once, where the poll would put it */
+			p = pool_get(pool);
+			*p = c->frames[i].p;
+			for (k = 0; k < POOL_CONSUMERS; k++) {
+				if (k)
+					pool_ref(pool, p);
+				held[k] = p;
+			}
+			for (k = 0; k < POOL_CONSUMERS; k++) {
+				seen += held[k]->buf[held[k]->len - 1];
+				pool_put(pool, held[k]);
+			}
+		}
+	}
+	pool_ns = (double)(mono_now_ns() - t0) / frames;
+
+	printf("pool: %u consumers, %.0f ns/frame copying, %.0f ns/frame "
+			"by reference\n", POOL_CONSUMERS, copy_ns, pool_ns);
+
+	pool_free(pool);
+}
+
+/**
+ * compact() - Packs the corpus as struct ir_frame back to back, and
+ * decodes it with ir_frame_decode() into one struct ir_result.
+ */
+static void compact(struct bench_corpus *c, unsigned int rounds, double ns)
+{
+	static unsigned char res[IR_RESULT_MAX];
+	struct ir_result *rs = (struct ir_result *)res;
+	const struct ir_frame *f;
+	unsigned char *packed, *at;
+	size_t i, bytes = 0, rbytes = 0;
+	uint64_t t0;
+	unsigned int r;
+	double frame_ns;
+
+	for (i = 0; i < c->count; i++)
+		bytes += IR_FRAME_SIZE(c->frames[i].p.len);
+
+	if ((packed = malloc(bytes)) == NULL)
+		return;
+
+	for (at = packed, i = 0; i < c->count; i++)
+		at += ir_frame_pack((struct ir_frame *)at, &c->frames[i].p);
+
+	for (at = packed, i = 0; i < c->count; i++) {
+		f = (const struct ir_frame *)at;
+		ir_frame_decode(f, rs, sizeof(res));
+		rbytes += IR_RESULT_SIZE(rs->len, rs->pronto_len);
+		at += IR_FRAME_SIZE(f->len);
+	}
+
+	/* results only wanted for their scancode, as a decoder loop's are */
+	t0 = mono_now_ns();
+	for (r = 0; r < rounds; r++) {
+		for (at = packed, i = 0; i < c->count; i++) {
+			f = (const struct ir_frame *)at;
+			ir_frame_decode(f, rs, sizeof(*rs));
+			at += IR_FRAME_SIZE(f->len);
+		}
+	}
+	frame_ns = (double)(mono_now_ns() - t0) / ((double)rounds * c->count);
+
+	printf("frames: %.0f bytes/frame packed against %zu, results %.0f "
+			"bytes against %zu, decode %.0f ns/frame (%+.1f%%)\n",
+			(double)bytes / c->count, sizeof(struct ir_packet),
+			(double)rbytes / c->count, sizeof(struct ir_prot),
+			frame_ns, 100.0 * (frame_ns - ns) / ns);
+
+	free(packed);
+}
+
+/**
+ * quantize() - Times every edge classifier over the corpus.
+ *
+ * @return      - 0, or -1 if one disagreed with the scalar classifier
+ */
+static int quantize(struct bench_corpus *c, unsigned int rounds)
+{
+	uint8_t want[MAX_FRAME_EDGES], got[MAX_FRAME_EDGES];
+	const struct quant_impl *impls;
+	struct quant_table q;
+	uint64_t edges = 0, t0;
+	int n, k, rc = 0;
+	unsigned int r;
+	size_t i;
+
+	quant_init(&q, bench_quanta,
+			sizeof(bench_quanta) / sizeof(bench_quanta[0]),
+			QUANT_TOLERANCE);
+	n = quant_impls(&impls);
+
+	for (i = 0; i < c->count; i++) {
+		struct ir_packet *p = &c->frames[i].p;
+
+		edges += p->len;
+		impls[n - 1].fn(&q, p->buf, p->len, want);
+		for (k = 0; k < n - 1; k++) {
+			impls[k].fn(&q, p->buf, p->len, got);
+			if (memcmp(want, got, p->len)) {
+				printf("quantize: %s disagrees with %s on "
+						"frame %zu\n", impls[k].name,
+						impls[n - 1].name, i);
+				rc = -1;
+			}
+		}
+	}
+
+	for (k = 0; k < n; k++) {
+		double ns;
+
+		t0 = mono_now_ns();
+		for (r = 0; r < rounds; r++) {
+			for (i = 0; i < c->count; i++) {
+				struct ir_packet *p = &c->frames[i].p;
+
+				impls[k].fn(&q, p->buf, p->len, got);
+			}
+		}
+		ns = (double)(mono_now_ns() - t0) / ((double)rounds * edges);
+
+		printf("quantize %-8s %6.2f ns/edge, %7.1f M edges/sec\n",
+				impls[k].name, ns, 1e3 / ns);
+	}
+
+	return rc;
+}
+
+static void report(struct proto_result *r, const int *encodable)
+{
+	uint64_t clean = 0, clean_ok = 0, noisy = 0, noisy_ok = 0;
+	int proto, skipped = 0;
+
+	printf("%-12s %7s %7s %7s %9s %9s %9s  (us)\n", "protocol", "frames",
+			"clean%", "noisy%", "p50", "p99", "max");
+
+	for (proto = 0; proto < IR_PROTO_COUNT; proto++) {
+		struct proto_result *pr = &r[proto];
+
+		if (!pr->clean && !pr->noisy)
+			continue;
+
+		printf("%-12s %7llu %7.1f %7.1f %9.2f %9.2f %9.2f\n",
+				enum_to_str(proto),
+				(unsigned long long)(pr->clean + pr->noisy),
+				pct(pr->clean_ok, pr->clean),
+				pct(pr->noisy_ok, pr->noisy),
+				hist_percentile(pr->lat, 50.0) / 1000.0,
+				hist_percentile(pr->lat, 99.0) / 1000.0,
+				pr->lat->max / 1000.0);
+
+		clean += pr->clean;
+		clean_ok += pr->clean_ok;
+		noisy += pr->noisy;
+		noisy_ok += pr->noisy_ok;
+	}
+
+	printf("%-12s %7llu %7.1f %7.1f\n", "all",
+			(unsigned long long)(clean + noisy),
+			pct(clean_ok, clean), pct(noisy_ok, noisy));
+
+	if (encodable == NULL)
+		return;
+
+	printf("\nnot encodable:");
+	for (proto = 0; proto < IR_PROTO_COUNT; proto++) {
+		if (!encodable[proto]) {
+			printf("%s%s", skipped++ % 8 ? " " : "\n  ",
+					enum_to_str(proto));
+		}
+	}
+	printf("\n");
+}
+
+static unsigned long opt_value(const char *arg, const char *name)
+{
+	size_t n = strlen(name);
+
+	if (strncmp(arg, name, n) == 0 && arg[n] == '=')
+		return strtoul(&arg[n + 1], NULL, 0);
+
+	return (unsigned long)-1;
+}
+
+static void usage(void)
+{
+	printf("usage: ir_bench [--scancodes=N] [--rounds=N] [--seed=N]\n"
+	       "                [--jitter=PCT] [--bias=US] [--glitch=PCT]"
+	       " [--verbose]\n"
+	       "       ir_bench --generate=<file>\n"
+	       "       ir_bench --corpus=<file>\n");
+}
+
+int main(int argc, char *argv[])
+{
+	struct bench_opts o = {
+		DEFAULT_SCANCODES, DEFAULT_ROUNDS, DEFAULT_SEED,
+		{ DEFAULT_JITTER, DEFAULT_BIAS, DEFAULT_GLITCH },
+	};
+	struct proto_result r[IR_PROTO_COUNT];
+	int encodable[IR_PROTO_COUNT];
+	struct bench_corpus c = { 0 };
+	const char *corpus = NULL, *gen = NULL;
+	uint64_t improved = 0, regressed = 0;
+	int i, verbose = 0, rc = 0;
+	unsigned long v;
+	double ns;
+
+	for (i = 1; i < argc; i++) {
+		const char *a = argv[i];
+
+		if (strncmp(a, "--generate=", 11) == 0) {
+			gen = &a[11];
+		} else if (strncmp(a, "--corpus=", 9) == 0) {
+			corpus = &a[9];
+		} else if (strcmp(a, "--verbose") == 0) {
+			verbose = 1;
+		} else if ((v = opt_value(a, "--scancodes")) != -1ul) {
+			o.scancodes = v;
+		} else if ((v = opt_value(a, "--rounds")) != -1ul) {
+			o.rounds = v ? v : 1;
+		} else if ((v = opt_value(a, "--seed")) != -1ul) {
+			o.seed = v;
+		} else if ((v = opt_value(a, "--jitter")) != -1ul) {
+			o.noise.jitter = v;
+		} else if ((v = opt_value(a, "--bias")) != -1ul) {
+			o.noise.bias = v;
+		} else if ((v = opt_value(a, "--glitch")) != -1ul) {
+			o.noise.glitch = v;
+		} else {
+			usage();
+			return 1;
+		}
+	}
+
+	/* libir logs every frame it rejects, noisy input would drown the
+	 * report and the timings would mostly measure stderr */
+	if (!verbose && freopen("/dev/null", "w", stderr) == NULL)
+		return 1;
+
+	if (gen)
+		return generate(gen);
+
+	printf("libir %s\n", ir_lib_version());
+
+	if (corpus) {
+		if (load_corpus(corpus, &c) < 0) {
+			printf("unable to load %s\n", corpus);
+			return 1;
+		}
+		printf("corpus %s: %zu frames\n\n", corpus, c.count);
+	} else {
+		if (build_corpus(&c, &o, encodable) < 0) {
+			printf("out of memory\n");
+			return 1;
+		}
+		printf("synthetic: %zu frames, %u scancodes per protocol, "
+				"jitter %u%%, bias %u us, glitch %u%%, "
+				"seed %llu\n\n", c.count, o.scancodes,
+				o.noise.jitter, o.noise.bias, o.noise.glitch,
+				(unsigned long long)o.seed);
+	}
+
+	memset(r, 0, sizeof(r));
+	for (i = 0; i < IR_PROTO_COUNT; i++) {
+		if ((r[i].lat = malloc(sizeof(*r[i].lat))) == NULL)
+			return 1;
+		hist_init(r[i].lat, enum_to_str(i));
+	}
+
+	score(&c, r, corpus ? &improved : NULL, corpus ? &regressed : NULL,
+			verbose);
+	ns = throughput(&c, o.rounds);
+
+	report(r, corpus ? NULL : encodable);
+
+	printf("\ndecode: %.0f ns/frame, %.0f frames/sec over %u rounds\n",
+			ns, 1e9 / ns, o.rounds);
+
+	candidates(&c, o.rounds, ns);
+	segments(&c, o.rounds, o.seed, ns);
+	pooled(&c, o.rounds);
+	compact(&c, o.rounds, ns);
+
+	if (quantize(&c, o.rounds) < 0)
+		rc = 1;
+
+	if (corpus) {
+		printf("against recorded results: %llu improved, "
+				"%llu regressed\n",
+				(unsigned long long)improved,
+				(unsigned long long)regressed);
+		if (regressed)
+			rc = 1;
+	}
+
+	for (i = 0; i < IR_PROTO_COUNT; i++)
+		free(r[i].lat);
+	free(c.frames);
+
+	return rc;
+}
@@ -0,0 +1,516 @@
+/**
+ * COPYRIGHT 2024 Flirc, Inc. All rights reserved.
+ *
+ * This copyright notice is Copyright Management Information under 17 USC 1202
+ * and is included to protect this work and deter copyright infringement.
+ * Removal or alteration of this Copyright Management Information without
+ * the express written permission of Flirc, Inc. is prohibited, and any
+ * such unauthorized removal or alteration will be a violation of federal law.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include <ir/ir.h>
+
+#include "candidate.h"
+#include "quantize.h"
+
+#define ERROR_MAX		(1000)
+
+/* most mark stretch taken out, us */
+#define BIAS_MAX_US		(200)
+
+#define NOMINALS		(3)
+#define VARIANTS		(4)
+
+enum model_kind {
+	PULSE,		/* a fixed edge count, pulse distance or width */
+	BIPHASE,	/* edges of one or more units, a fixed total length */
+};
+
+/**
+ * struct model - the published timing of a protocol family
+ *
+ * @hdr_mark:   us, 0 for none
+ * @hdr_space:  us, 0 for none
+ * @mark:       us, the lengths a mark after the header can have
+ * @space:      us, as @mark for spaces
+ * @unit:       BIPHASE, us in a half bit
+ * @length:     PULSE, edges in a frame, BIPHASE, units after the header,
+ *              one per variant
+ * @variant:    protocol for each @length
+ */
+struct model {
+	const char *name;
+	enum model_kind kind;
+	uint16_t hdr_mark;
+	uint16_t hdr_space;
+	uint16_t mark[NOMINALS];
+	uint16_t space[NOMINALS];
+	uint16_t unit;
+	uint16_t length[VARIANTS];
+	enum rc_proto variant[VARIANTS];
+};
+
+static const struct model models[] = {
+	{ "NEC", PULSE, 9000, 4500, { 560 }, { 560, 1690 }, 0,
+		{ 67 }, { RC_PROTO_NEC } },
+	{ "NEC_REPEAT", PULSE, 9000, 2250, { 560 }, { 2250 }, 0,
+		{ 3 }, { RC_PROTO_NEC_REPEAT } },
+	{ "SAMSUNG32", PULSE, 4500, 4500, { 560 }, { 560, 1690 }, 0,
+		{ 67 }, { RC_PROTO_OTHER } },
+	{ "SANYO", PULSE, 9000, 4500, { 560 }, { 560, 1690 }, 0,
+		{ 87 }, { RC_PROTO_SANYO } },
+	{ "JVC", PULSE, 8400, 4200, { 526 }, { 526, 1574 }, 0,
+		{ 35 }, { RC_PROTO_JVC } },
+	{ "PANASONIC", PULSE, 3456, 1728, { 432 }, { 432, 1296 }, 0,
+		{ 99 }, { RC_PROTO_PANASONIC } },
+	/* the frame ends on a data mark, there's no header space */
+	{ "SONY", PULSE, 2400, 0, { 600, 1200 }, { 600 }, 0,
+		{ 25, 31, 41 },
+		{ RC_PROTO_SONY12, RC_PROTO_SONY15, RC_PROTO_SONY20 } },
+	/* 14 bits, the leading half space of the start bit isn't seen */
+	{ "RC5", BIPHASE, 0, 0, { 889, 1778 }, { 889, 1778 }, 889,
+		{ 27, 29 }, { RC_PROTO_RC5, RC_PROTO_RC5_SZ } },
+	/* start, mode and the double length trailer are 12 units */
+	{ "RC6", BIPHASE, 2664, 888, { 444, 888, 1332 }, { 444, 888, 1332 }, 444,
+		{ 44, 52, 60, 76 },
+		{ RC_PROTO_RC6_0, RC_PROTO_RC6_6A_20, RC_PROTO_RC6_6A_24,
+			RC_PROTO_RC6_6A_32 } },
+};
+
+#define MODELS		(sizeof(models) / sizeof(models[0]))
+
+/* per model, the classes edges are sorted into, a nominal timing each, and
+ * ERROR_MAX / nominal for each */
+static struct quant_table mark_q[MODELS];
+static struct quant_table space_q[MODELS];
+static uint32_t mark_rcp[MODELS][NOMINALS];
+static uint32_t space_rcp[MODELS][NOMINALS];
+static int tables_ready;
+
+/* every model's class boundaries, marks and spaces, cut into one table so a
+ * frame is classified once, and which of a model's classes each of its
+ * classes falls in. shared is 0 if they don't fit in QUANT_MAX_CLASSES */
+static struct quant_table edge_q;
+static uint8_t mark_class[MODELS][QUANT_MAX_CLASSES];
+static uint8_t space_class[MODELS][QUANT_MAX_CLASSES];
+static int shared;
+
+static const uint8_t same_class[QUANT_MAX_CLASSES] = {
+	0, 1, 2, 3, 4, 5, 6, 7
+};
+
+/* ERROR_MAX / nominal in 16.16 fixed point, a multiply an edge rather than
+ * a divide */
+static inline uint32_t reciprocal(uint16_t nominal)
+{
+	return ((uint32_t)ERROR_MAX << 16) / nominal;
+}
+
+static unsigned int nominals(const uint16_t *nominal)
+{
+	unsigned int n = 0;
+
+	while (n < NOMINALS && nominal[n])
+		n++;
+
+	return n;
+}
+
+static uint8_t class_of(const struct quant_table *q, uint16_t us)
+{
+	unsigned int c;
+
+	for (c = 0; c + 1 < q->count && us > q->hi[c]; c++)
+		;
+
+	return c;
+}
+
+/* a boundary into the sorted set, -1 if it's full */
+static int cut_add(uint16_t *cut, unsigned int *n, uint16_t at)
+{
+	unsigned int i;
+
+	for (i = 0; i < *n && cut[i] < at; i++)
+		;
+	if (i < *n && cut[i] == at)
+		return 0;
+	if (*n + 1 >= QUANT_MAX_CLASSES)
+		return -1;
+
+	memmove(&cut[i + 1], &cut[i], (*n - i) * sizeof(cut[0]));
+	cut[i] = at;
+	(*n)++;
+
+	return 0;
+}
+
+static void shared_init(void)
+{
+	uint16_t cut[QUANT_MAX_CLASSES];
+	unsigned int m, i, n = 0;
+
+	for (m = 0; m < MODELS; m++) {
+		for (i = 0; i + 1 < mark_q[m].count; i++) {
+			if (cut_add(cut, &n, mark_q[m].hi[i]) < 0)
+				return;
+		}
+		for (i = 0; i + 1 < space_q[m].count; i++) {
+			if (cut_add(cut, &n, space_q[m].hi[i]) < 0)
+				return;
+		}
+	}
+
+	edge_q.lo[0] = 0;
+	for (i = 0; i < n; i++) {
+		edge_q.hi[i] = cut[i];
+		edge_q.lo[i + 1] = cut[i] + 1;
+	}
+	edge_q.hi[n] = UINT16_MAX;
+	edge_q.count = n + 1;
+
+	/* every model's boundaries are among the cuts, so each shared class
+	 * lies inside one class of the model */
+	for (m = 0; m < MODELS; m++) {
+		for (i = 0; i < edge_q.count; i++) {
+			mark_class[m][i] = class_of(&mark_q[m], edge_q.lo[i]);
+			space_class[m][i] = class_of(&space_q[m], edge_q.lo[i]);
+		}
+	}
+
+	shared = 1;
+}
+
+static void tables_init(void)
+{
+	unsigned int m, i;
+
+	/* the nearest nominal by ratio, so an edge between 560 and 1690 goes
+	 * to whichever it's proportionally closer to */
+	for (m = 0; m < MODELS; m++) {
+		quant_init_nearest(&mark_q[m], models[m].mark,
+				nominals(models[m].mark));
+		quant_init_nearest(&space_q[m], models[m].space,
+				nominals(models[m].space));
+		for (i = 0; i < mark_q[m].count; i++)
+			mark_rcp[m][i] = reciprocal(models[m].mark[i]);
+		for (i = 0; i < space_q[m].count; i++)
+			space_rcp[m][i] = reciprocal(models[m].space[i]);
+	}
+	shared_init();
+
+	tables_ready = 1;
+}
+
+/* which variant of the model a frame's length fits, -1 if none */
+static int fits(const struct model *m, const struct ir_packet *p,
+		uint32_t total)
+{
+	uint32_t units, diff, best = 2;
+	int i, v = -1;
+
+	if (m->kind == PULSE) {
+		for (i = 0; i < VARIANTS && m->length[i]; i++) {
+			if (p->len == m->length[i])
+				return i;
+		}
+		return -1;
+	}
+
+	/* a received frame ends on a mark, so a trailing half space can be
+	 * missing, allow a unit either way */
+	if (total < (uint32_t)m->hdr_mark + m->hdr_space)
+		return -1;
+	units = (total - m->hdr_mark - m->hdr_space + m->unit / 2) / m->unit;
+
+	for (i = 0; i < VARIANTS && m->length[i]; i++) {
+		diff = units > m->length[i] ? units - m->length[i] :
+			m->length[i] - units;
+		if (diff < best) {
+			best = diff;
+			v = i;
+		}
+	}
+
+	return v;
+}
+
+static inline unsigned int error(unsigned int us, unsigned int nominal,
+		uint32_t rcp)
+{
+	uint64_t e;
+
+	e = ((uint64_t)(us > nominal ? us - nominal : nominal - us) * rcp) >> 16;
+
+	return e > ERROR_MAX ? ERROR_MAX : e;
+}
+
+/* integer square root, the scores don't need libm */
+static unsigned int isqrt(uint32_t v)
+{
+	uint32_t r = 0, b = 1u << 30;
+
+	while (b > v)
+		b >>= 2;
+	while (b) {
+		if (v >= r + b) {
+			v -= r + b;
+			r = (r >> 1) + b;
+		} else {
+			r >>= 1;
+		}
+		b >>= 2;
+	}
+
+	return r;
+}
+
+/**
+ * A receiver stretches every mark and shortens every space by about the
+ * same few tens of us, which on a 168 us edge is a large part of it. That
+ * offset is measured from the frame, the average of how much longer the
+ * marks came out less how much longer the spaces did, halved, and taken
+ * out before each edge is compared.
+ *
+ * Errors are at most ERROR_MAX and there are at most MAX_EDGES, so the sum
+ * of squares fits in 32 bits.
+ */
+static void rms_error(const uint16_t *buf, const uint16_t *nominal,
+		const uint32_t *rcp, int len, unsigned int *rms,
+		unsigned int *worst)
+{
+	int32_t mark = 0, space = 0, bias, dev;
+	uint32_t sum = 0, e, w = 0;
+	int i;
+
+	if (len < 2) {
+		*rms = *worst = len ? error(buf[0], nominal[0], rcp[0]) :
+			ERROR_MAX;
+		return;
+	}
+
+	for (i = 0; i < len; i++) {
+		if (i & 1)
+			space += buf[i] - nominal[i];
+		else
+			mark += buf[i] - nominal[i];
+	}
+	bias = (mark / ((len + 1) / 2) - space / (len / 2)) / 2;
+
+	/* more than a receiver would do is the frame not fitting */
+	if (bias > BIAS_MAX_US)
+		bias = BIAS_MAX_US;
+	else if (bias < -BIAS_MAX_US)
+		bias = -BIAS_MAX_US;
+
+	for (i = 0; i < len; i++) {
+		dev = buf[i] + ((i & 1) ? bias : -bias);
+		e = error(dev < 0 ? 0 : dev, nominal[i], rcp[i]);
+		sum += e * e;
+		w = e > w ? e : w;
+	}
+
+	*rms = isqrt(sum / len);
+	*worst = w;
+}
+
+/**
+ * score() - Timing error of a frame against a model.
+ *
+ * @param *cls  - the frame through edge_q, shared only, each family's
+ *                classes are looked up from it rather than the frame
+ *                classified again
+ */
+static void score(int model, const struct ir_packet *p, const uint8_t *cls,
+		unsigned int *rms, unsigned int *worst)
+{
+	const struct model *m = &models[model];
+	uint8_t own_mark[MAX_EDGES], own_space[MAX_EDGES];
+	const uint8_t *mark = cls, *space = cls;
+	const uint8_t *mark_map = same_class, *space_map = same_class;
+	uint16_t nominal[MAX_EDGES];
+	uint32_t rcp[MAX_EDGES];
+	uint8_t c;
+	int i = 0;
+
+	if (shared) {
+		mark_map = mark_class[model];
+		space_map = space_class[model];
+	} else {
+		/* every edge both ways, the vector kernel is cheaper run
+		 * over the frame twice than picking out every other edge */
+		quant_classify(&mark_q[model], p->buf, p->len, own_mark);
+		quant_classify(&space_q[model], p->buf, p->len, own_space);
+		mark = own_mark;
+		space = own_space;
+	}
+
+	if (m->hdr_mark && p->len > 0) {
+		nominal[i] = m->hdr_mark;
+		rcp[i++] = reciprocal(m->hdr_mark);
+		if (m->hdr_space && p->len > 1) {
+			nominal[i] = m->hdr_space;
+			rcp[i++] = reciprocal(m->hdr_space);
+		}
+	}
+
+	/* the classes cover every length, no edge is QUANT_NONE */
+	for (; i < p->len; i++) {
+		if (i & 1) {
+			c = space_map[space[i]];
+			nominal[i] = m->space[c];
+			rcp[i] = space_rcp[model][c];
+		} else {
+			c = mark_map[mark[i]];
+			nominal[i] = m->mark[c];
+			rcp[i] = mark_rcp[model][c];
+		}
+	}
+
+	rms_error(p->buf, nominal, rcp, p->len, rms, worst);
+}
+
+/* against the ideal frame libir made, -1 if it isn't edge for edge */
+static int score_decoded(const struct ir_packet *p, const struct ir_prot *d,
+		unsigned int *rms, unsigned int *worst)
+{
+	uint32_t rcp[MAX_EDGES];
+	int i;
+
+	if (d->len != p->len || p->len == 0)
+		return -1;
+
+	for (i = 0; i < p->len; i++) {
+		if (d->buf[i] == 0)
+			return -1;
+		rcp[i] = reciprocal(d->buf[i]);
+	}
+
+	rms_error(p->buf, d->buf, rcp, p->len, rms, worst);
+
+	return 0;
+}
+
+static int family(enum rc_proto p)
+{
+	enum rc_proto nec[] = { RC_PROTO_NECX, RC_PROTO_NEC32,
+		RC_PROTO_NEC_APPLE };
+	unsigned int m, v;
+
+	for (v = 0; v < sizeof(nec) / sizeof(nec[0]); v++) {
+		if (p == nec[v])
+			p = RC_PROTO_NEC;
+	}
+	if (p == RC_PROTO_RC6_MCE)
+		p = RC_PROTO_RC6_6A_32;
+
+	for (m = 0; m < MODELS; m++) {
+		for (v = 0; v < VARIANTS && models[m].length[v]; v++) {
+			if (models[m].variant[v] == p)
+				return m;
+		}
+	}
+
+	return -1;
+}
+
+static unsigned int confidence(unsigned int error)
+{
+	if (error >= CANDIDATE_REJECT)
+		return 0;
+
+	return 100 * (CANDIDATE_REJECT - error) / CANDIDATE_REJECT;
+}
+
+int candidate_decode(struct ir_packet *p, struct ir_prot *d,
+		struct candidate *c, int k)
+{
+	struct candidate all[CANDIDATE_MAX];
+	uint8_t cls[MAX_EDGES];
+	int i, j, n = 0, fam = -1, v, classified = 0;
+	enum rc_proto got;
+	uint32_t total = 0;
+	struct candidate t;
+
+	if (!tables_ready)
+		tables_init();
+
+	got = ir_decode_packet(p, d);
+	if (got != RC_PROTO_UNKNOWN && got != RC_PROTO_INVALID)
+		fam = family(got);
+
+	for (i = 0; i < p->len && i < MAX_EDGES; i++)
+		total += p->buf[i];
+
+	for (i = 0; i < (int)MODELS && p->len <= MAX_EDGES; i++) {
+		struct candidate *a = &all[n];
+
+		if ((v = fits(&models[i], p, total)) < 0)
+			continue;
+
+		/* only a frame some family fits is quantized at all, and
+		 * then once for all of them */
+		if (shared && !classified) {
+			quant_classify(&edge_q, p->buf, p->len, cls);
+			classified = 1;
+		}
+		score(i, p, cls, &a->error, &a->worst);
+		if (a->error > CANDIDATE_REJECT && i != fam)
+			continue;
+
+		a->protocol = models[i].variant[v];
+		a->name = a->protocol == RC_PROTO_OTHER ? models[i].name :
+			enum_to_str(a->protocol);
+		a->scancode = 0;
+		a->decoded = 0;
+
+		/* libir's answer takes the place of its family's, scored the
+		 * same way so it ranks fairly against the rest */
+		if (i == fam) {
+			a->protocol = got;
+			a->name = enum_to_str(got);
+			a->scancode = d->scancode;
+			a->decoded = 1;
+			fam = -2;
+		}
+		n++;
+	}
+
+	/* decoded as something no family covers, or that didn't fit it, the
+	 * ideal frame libir made is all there is to measure against */
+	if (fam != -2 && got != RC_PROTO_UNKNOWN && got != RC_PROTO_INVALID &&
+			n < CANDIDATE_MAX) {
+		struct candidate *a = &all[n++];
+
+		a->protocol = got;
+		a->name = enum_to_str(got);
+		a->scancode = d->scancode;
+		a->decoded = 1;
+		if (score_decoded(p, d, &a->error, &a->worst) < 0) {
+			a->error = CANDIDATE_REJECT;
+			a->worst = ERROR_MAX;
+		}
+	}
+
+	/* a handful at most, insertion sort, libir's first on a tie */
+	for (i = 1; i < n; i++) {
+		t = all[i];
+		for (j = i; j > 0 && (all[j - 1].error > t.error ||
+				(all[j - 1].error == t.error && t.decoded));
+				j--)
+			all[j] = all[j - 1];
+		all[j] = t;
+	}
+
+	if (n > k)
+		n = k;
+	for (i = 0; i < n; i++) {
+		c[i] = all[i];
+		c[i].confidence = confidence(c[i].error);
+	}
+
+	return n;
+}
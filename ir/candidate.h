@@ -0,0 +1,100 @@
+/**
+ * COPYRIGHT 2024 Flirc, Inc. All rights reserved.
+ *
+ * This copyright notice is Copyright Management Information under 17 USC 1202
+ * and is included to protect this work and deter copyright infringement.
+ * Removal or alteration of this Copyright Management Information without
+ * the express written permission of Flirc, Inc. is prohibited, and any
+ * such unauthorized removal or alteration will be a violation of federal law.
+ */
+
+#ifndef I__CANDIDATE_H__
+#define I__CANDIDATE_H__
+
+#include <stdint.h>
+
+#include <ir/ir.h>
+
+/**
+ * Ranked decode results, each with how well the frame's timing fits.
+ *
+ * ir_decode_packet() gives one answer and no idea how close a call it was.
+ * candidate_decode() calls it once and then scores the frame against the
+ * timing of every protocol family it knows: NEC against Samsung, which
+ * differ only in the header, or RC5 against StreamZap's RC5 with one more
+ * bit. Families whose frame length can't fit are skipped without looking
+ * at an edge.
+ *
+ * Each family's marks and spaces are sorted into its nominal timings, the
+ * nearest by ratio. The class boundaries of every family are cut into one
+ * table, so quant_classify() (quantize.h) goes over the frame once and each
+ * family reads its classes off the same array, a lookup per edge. A
+ * protocol libir decoded that no family covers is scored against the ideal
+ * frame the decode produced, or put at CANDIDATE_REJECT if that doesn't
+ * line up edge for edge.
+ *
+ * That still isn't close to the cost of a single decode. make bench puts
+ * candidate_decode() at about a quarter over a plain ir_decode_packet(),
+ * 20 to 40 percent from run to run and machine to machine. What's left is
+ * the error pass each family that fits the frame's length makes over it,
+ * which depends on the family's timings and isn't shared.
+ *
+ * Each edge's error is its distance from the nearest timing the family
+ * allows, in permille of that timing, once the receiver's mark stretch is
+ * taken out. A candidate's error is the root mean square over the frame,
+ * so one edge far out, a Samsung header read as NEC, counts for more than
+ * the same total spread thinly. A candidate past CANDIDATE_REJECT isn't
+ * reported.
+ *
+ * libir goes on to decide between the variants of a family by the
+ * scancode, NEC against NECX, NEC32 or NEC_APPLE, and only the candidate
+ * for the family it picked carries its protocol and scancode. The others
+ * are the family's usual protocol, with no scancode.
+ */
+
+/* families scored, the most candidate_decode() can report */
+#define CANDIDATE_MAX		(10)
+
+/* rms error, permille, past which a family isn't a candidate */
+#define CANDIDATE_REJECT	(300)
+
+/**
+ * struct candidate
+ *
+ * @protocol:   libir's for the decoded candidate, else the family's usual
+ *              one, RC_PROTO_OTHER for Samsung which libir has none for
+ * @name:       the family, or enum_to_str() of the decoded protocol
+ * @scancode:   libir's, decoded candidate only
+ * @decoded:    1 for what ir_decode_packet() returned
+ * @error:      rms edge timing error, permille
+ * @worst:      largest error of a single edge, permille, a glitch shows
+ *              here long before it moves the mean
+ * @confidence: 0 to 100, falling from 100 at no error to 0 at
+ *              CANDIDATE_REJECT
+ */
+struct candidate {
+	enum rc_proto protocol;
+	const char *name;
+	uint32_t scancode;
+	int decoded;
+	unsigned int error;
+	unsigned int worst;
+	unsigned int confidence;
+};
+
+/**
+ * candidate_decode() - ir_decode_packet(), then the likely protocols,
+ * best fit first.
+ *
+ * @param *p    - frame, as for ir_decode_packet()
+ * @param *d    - filled in by ir_decode_packet()
+ * @param *c    - room for k candidates
+ * @param k     - most candidates wanted
+ *
+ * @return      - candidates written, 0 if nothing fits and libir couldn't
+ *                decode it either
+ */
+int candidate_decode(struct ir_packet *p, struct ir_prot *d,
+		struct candidate *c, int k);
+
+#endif /* I__CANDIDATE_H__ */
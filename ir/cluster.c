@@ -0,0 +1,596 @@
+/**
+ * COPYRIGHT 2024 Flirc, Inc. All rights reserved.
+ *
+ * This copyright notice is Copyright Management Information under 17 USC 1202
+ * and is included to protect this work and deter copyright infringement.
+ * Removal or alteration of this Copyright Management Information without
+ * the express written permission of Flirc, Inc. is prohibited, and any
+ * such unauthorized removal or alteration will be a violation of federal law.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <ir/ir.h>
+
+#include "cluster.h"
+#include "decode_file.h"
+#include "segment.h"
+
+/* edges shorter than this all share step 0 */
+#define STEP_FLOOR_US		(16)
+
+/* frames averaged, past this a cluster's average is settled and further
+ * frames are only counted, which also keeps the sums in 32 bits */
+#define CLUSTER_AVG_MAX		(1u << 15)
+
+/* a split shows up within a cluster's first frames, once it has this many
+ * it's not checked for a twin any more */
+#define CLUSTER_YOUNG		(16)
+
+/**
+ * struct cluster
+ *
+ * @sum:        per edge, total of the frames averaged
+ * @averaged:   frames in sum, stops at CLUSTER_AVG_MAX
+ * @dev:        steps each frame was from the average when it joined, summed
+ *              over its edges and over the frames
+ * @seen:       when a frame last joined, in frames added to the set
+ * @next:       next cluster with the same edge count, -1 for none
+ */
+struct cluster {
+	uint32_t sum[CLUSTER_MAX_EDGES];
+	uint64_t sum_elapsed;
+	uint32_t averaged;
+	uint32_t frames;
+	uint64_t dev;
+	uint64_t seen;
+	uint16_t len;
+	int next;
+};
+
+/**
+ * struct cluster_set
+ *
+ * @shape:  per cluster, CLUSTER_MAX_EDGES steps of its average, kept apart
+ *          from the sums so a search only reads a byte an edge
+ * @head:   per edge count, first cluster with that many edges
+ */
+struct cluster_set {
+	struct cluster_cfg cfg;
+	struct cluster *c;
+	uint8_t *shape;
+	int head[CLUSTER_MAX_EDGES + 1];
+	int count;
+	uint64_t seq;
+	struct cluster_stats st;
+};
+
+/* us to step, built on first use */
+static uint8_t step_of[UINT16_MAX + 1];
+static int step_ready;
+
+static void step_init(void)
+{
+	uint32_t us, next = STEP_FLOOR_US;
+	unsigned int step = 0;
+
+	for (us = 0; us <= UINT16_MAX; us++) {
+		if (us == next) {
+			step++;
+			next += next * CLUSTER_STEP / 100 ?
+				next * CLUSTER_STEP / 100 : 1;
+		}
+		/* about 150 steps cover 16 bits, so this never clamps */
+		step_of[us] = step > UINT8_MAX ? UINT8_MAX : step;
+	}
+
+	step_ready = 1;
+}
+
+struct cluster_set *cluster_new(const struct cluster_cfg *cfg)
+{
+	static const struct cluster_cfg defaults = CLUSTER_DEFAULTS;
+	struct cluster_set *cs;
+	int i;
+
+	if (!step_ready)
+		step_init();
+
+	if ((cs = calloc(1, sizeof(*cs))) == NULL)
+		return NULL;
+
+	cs->cfg = cfg ? *cfg : defaults;
+	if (cs->cfg.max_clusters == 0)
+		cs->cfg.max_clusters = 1;
+
+	cs->c = calloc(cs->cfg.max_clusters, sizeof(*cs->c));
+	cs->shape = calloc(cs->cfg.max_clusters, CLUSTER_MAX_EDGES);
+	if (!cs->c || !cs->shape) {
+		cluster_free(cs);
+		return NULL;
+	}
+
+	for (i = 0; i <= CLUSTER_MAX_EDGES; i++)
+		cs->head[i] = -1;
+
+	return cs;
+}
+
+void cluster_free(struct cluster_set *cs)
+{
+	if (!cs)
+		return;
+
+	free(cs->shape);
+	free(cs->c);
+	free(cs);
+}
+
+/* total steps between two shapes, or UINT32_MAX as soon as an edge is more
+ * than tol out. buttons on a remote usually differ within their first few
+ * bits, so most comparisons stop after a handful of edges */
+static inline unsigned int distance(const uint8_t *a, const uint8_t *b,
+		uint16_t len, unsigned int tol)
+{
+	unsigned int d = 0;
+	uint16_t e;
+
+	for (e = 0; e < len; e++) {
+		int x = a[e] - b[e];
+		unsigned int v = x < 0 ? -x : x;
+
+		if (v > tol)
+			return UINT32_MAX;
+		d += v;
+	}
+
+	return d;
+}
+
+/* cluster in q's bucket with the smallest total distance, -1 if there is
+ * none with every edge inside the tolerance */
+static int nearest(const struct cluster_set *cs, const uint8_t *q,
+		uint16_t len, int skip, unsigned int *dist)
+{
+	unsigned int best_d = UINT32_MAX, d;
+	int i, best = -1;
+
+	for (i = cs->head[len]; i >= 0; i = cs->c[i].next) {
+		if (i == skip)
+			continue;
+
+		d = distance(q, &cs->shape[i * CLUSTER_MAX_EDGES], len,
+				cs->cfg.tol);
+		if (d < best_d) {
+			best_d = d;
+			best = i;
+		}
+	}
+
+	*dist = best_d;
+
+	return best;
+}
+
+static void reshape(struct cluster_set *cs, int id)
+{
+	struct cluster *c = &cs->c[id];
+	uint8_t *s = &cs->shape[id * CLUSTER_MAX_EDGES];
+	uint32_t n = c->averaged;
+	uint16_t e;
+
+	for (e = 0; e < c->len; e++)
+		s[e] = step_of[(c->sum[e] + n / 2) / n];
+}
+
+static void unlink_cluster(struct cluster_set *cs, int id)
+{
+	int *p = &cs->head[cs->c[id].len];
+
+	while (*p != id)
+		p = &cs->c[*p].next;
+	*p = cs->c[id].next;
+}
+
+/* a free id, or the stalest single frame cluster, -1 if neither */
+static int claim(struct cluster_set *cs)
+{
+	uint64_t oldest = UINT64_MAX;
+	int i, victim = -1;
+
+	if ((unsigned int)cs->count < cs->cfg.max_clusters)
+		return cs->count++;
+
+	/* one merged away has no frames and is the first choice */
+	for (i = 0; i < cs->count; i++) {
+		if (cs->c[i].frames <= 1 && cs->c[i].seen < oldest) {
+			oldest = cs->c[i].seen;
+			victim = i;
+		}
+	}
+
+	if (victim >= 0 && cs->c[victim].frames) {
+		unlink_cluster(cs, victim);
+		cs->st.evicted++;
+	}
+
+	return victim;
+}
+
+/**
+ * Two clusters can be started by one button, when its first frames land
+ * either side of the tolerance. As they average out they drift together,
+ * and once they're within the tolerance of each other the younger is
+ * folded into the older.
+ */
+static int merge(struct cluster_set *cs, int id)
+{
+	struct cluster *dst, *src;
+	unsigned int dist;
+	uint16_t e;
+	int other;
+
+	other = nearest(cs, &cs->shape[id * CLUSTER_MAX_EDGES], cs->c[id].len,
+			id, &dist);
+	if (other < 0)
+		return id;
+
+	if (other > id) {
+		dst = &cs->c[id];
+		src = &cs->c[other];
+	} else {
+		dst = &cs->c[other];
+		src = &cs->c[id];
+		id = other;
+	}
+
+	/* each side is at most CLUSTER_AVG_MAX, so this still fits */
+	for (e = 0; e < dst->len; e++)
+		dst->sum[e] += src->sum[e];
+	dst->sum_elapsed += src->sum_elapsed;
+	dst->averaged += src->averaged;
+	dst->frames += src->frames;
+	dst->dev += src->dev;
+	dst->seen = cs->seq;
+
+	unlink_cluster(cs, src - cs->c);
+	src->frames = 0;
+	src->seen = 0;
+	cs->st.merged++;
+
+	reshape(cs, id);
+
+	return id;
+}
+
+int cluster_add(struct cluster_set *cs, const uint16_t *buf, uint16_t len,
+		uint16_t elapsed, int *created)
+{
+	uint8_t q[CLUSTER_MAX_EDGES];
+	struct cluster *c;
+	unsigned int dist;
+	uint16_t e;
+	int id;
+
+	if (created)
+		*created = 0;
+
+	cs->st.frames++;
+	cs->seq++;
+
+	if (len < cs->cfg.min_edges || len > CLUSTER_MAX_EDGES) {
+		cs->st.ignored++;
+		return -1;
+	}
+
+	for (e = 0; e < len; e++)
+		q[e] = step_of[buf[e]];
+
+	if ((id = nearest(cs, q, len, -1, &dist)) >= 0) {
+		c = &cs->c[id];
+		c->frames++;
+		c->seen = cs->seq;
+		c->dev += dist;
+
+		if (c->averaged < CLUSTER_AVG_MAX) {
+			for (e = 0; e < len; e++)
+				c->sum[e] += buf[e];
+			c->sum_elapsed += elapsed;
+			c->averaged++;
+
+			/* each frame moves a young average, an older one only
+			 * needs refreshing now and then */
+			if (c->averaged <= CLUSTER_YOUNG ||
+					!(c->averaged & (c->averaged - 1)))
+				reshape(cs, id);
+			if (c->averaged <= CLUSTER_YOUNG)
+				id = merge(cs, id);
+		}
+
+		return id;
+	}
+
+	if ((id = claim(cs)) < 0) {
+		cs->st.dropped++;
+		return -1;
+	}
+
+	c = &cs->c[id];
+	memset(c, 0, sizeof(*c));
+	for (e = 0; e < len; e++)
+		c->sum[e] = buf[e];
+	c->sum_elapsed = elapsed;
+	c->averaged = 1;
+	c->frames = 1;
+	c->seen = cs->seq;
+	c->len = len;
+	memcpy(&cs->shape[id * CLUSTER_MAX_EDGES], q, len);
+
+	c->next = cs->head[len];
+	cs->head[len] = id;
+
+	cs->st.created++;
+	if (created)
+		*created = 1;
+
+	return id;
+}
+
+int cluster_count(const struct cluster_set *cs)
+{
+	return cs->count;
+}
+
+static unsigned int confidence(const struct cluster_set *cs,
+		const struct cluster *c)
+{
+	double n = c->frames, support, tight;
+
+	if (c->frames < 2)
+		return 0;
+
+	/* the first frame is the average it was measured against, so only
+	 * the ones after it carry a distance */
+	support = (n - 1) / (n + 1);
+	if (cs->cfg.tol)
+		tight = 1.0 - (double)c->dev / ((n - 1) * c->len * cs->cfg.tol);
+	else
+		tight = 1.0;
+	if (tight < 0)
+		tight = 0;
+
+	return (unsigned int)(100 * support * tight + 0.5);
+}
+
+int cluster_get(const struct cluster_set *cs, int id, struct cluster_info *ci)
+{
+	const struct cluster *c;
+	uint32_t n;
+	uint16_t e;
+
+	if (id < 0 || id >= cs->count || cs->c[id].frames == 0)
+		return -1;
+
+	c = &cs->c[id];
+	n = c->averaged;
+
+	for (e = 0; e < c->len; e++)
+		ci->buf[e] = (c->sum[e] + n / 2) / n;
+	ci->len = c->len;
+	ci->elapsed = (c->sum_elapsed + n / 2) / n;
+	ci->frames = c->frames;
+	ci->confidence = confidence(cs, c);
+
+	return 0;
+}
+
+void cluster_stats(const struct cluster_set *cs, struct cluster_stats *st)
+{
+	*st = cs->st;
+}
+
+static const struct cluster_set *sort_set;
+
+static int by_frames(const void *a, const void *b)
+{
+	const struct cluster *ca = &sort_set->c[*(const int *)a];
+	const struct cluster *cb = &sort_set->c[*(const int *)b];
+
+	if (ca->frames != cb->frames)
+		return ca->frames < cb->frames ? 1 : -1;
+
+	return *(const int *)a - *(const int *)b;
+}
+
+int cluster_print(const struct cluster_set *cs, FILE *fp,
+		unsigned int min_frames)
+{
+	struct cluster_info ci;
+	struct ir_packet p;
+	struct ir_prot d;
+	int *order, i, n = 0;
+	uint16_t e;
+
+	if (cs->count == 0)
+		return 0;
+
+	if ((order = malloc(cs->count * sizeof(*order))) == NULL)
+		return 0;
+
+	for (i = 0; i < cs->count; i++)
+		order[i] = i;
+	sort_set = cs;
+	qsort(order, cs->count, sizeof(*order), by_frames);
+
+	for (i = 0; i < cs->count; i++) {
+		/* merged away clusters sort last */
+		if (cluster_get(cs, order[i], &ci) < 0 ||
+				ci.frames < min_frames)
+			break;
+
+		/* libir's hash of the canonical frame, what a keymap entry
+		 * for the button is keyed on */
+		memset(&p, 0, sizeof(p));
+		memcpy(p.buf, ci.buf, ci.len * sizeof(ci.buf[0]));
+		p.len = ci.len;
+		p.elapsed = ci.elapsed;
+		ir_decode_packet(&p, &d);
+
+		fprintf(fp, "#%-3d %6u frames %4u edges %3u%% confidence "
+				"hash 0x%08X\n", order[i], ci.frames, ci.len,
+				ci.confidence, d.hash);
+		for (e = 0; e < ci.len; e++)
+			fprintf(fp, "%c%u ", e & 1 ? '-' : '+', ci.buf[e]);
+		fprintf(fp, "\n");
+		n++;
+	}
+
+	free(order);
+
+	return n;
+}
+
+static double now_sec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void learn_file_usage(void)
+{
+	printf("usage: ir learn [--tol=N] [--min=N] [--all] <capture>\n");
+	printf("     - groups the frames that don't decode by button, and\n");
+	printf("       prints an averaged frame for each. --tol is in %d%%\n",
+			CLUSTER_STEP);
+	printf("       steps, --min hides clusters with fewer frames and\n");
+	printf("       --all clusters frames that do decode as well\n");
+}
+
+/* a frame to cluster, where it is in the corpus edge pool */
+struct learn_pick {
+	size_t off;
+	uint16_t len;
+	uint16_t elapsed;
+};
+
+int learn_file(int argc, char *argv[])
+{
+	struct cluster_cfg cfg = CLUSTER_DEFAULTS;
+	unsigned int min_frames = 2;
+	struct ir_corpus corpus;
+	struct cluster_stats st;
+	struct cluster_set *cs;
+	const char *path = NULL;
+	struct segment seg[SEGMENT_MAX];
+	struct ir_packet p, sub, *q;
+	struct ir_prot d;
+	struct learn_pick *pick = NULL, *np;
+	double secs, t;
+	int all = 0, i, s, nseg, shown;
+	size_t f, n = 0, cap = 0, frames = 0;
+
+	for (i = 0; i < argc; i++) {
+		if (strncmp(argv[i], "--tol=", 6) == 0) {
+			cfg.tol = atoi(&argv[i][6]);
+		} else if (strncmp(argv[i], "--min=", 6) == 0) {
+			min_frames = atoi(&argv[i][6]);
+		} else if (strcmp(argv[i], "--all") == 0) {
+			all = 1;
+		} else if (argv[i][0] == '-' && argv[i][1] != '\0') {
+			printf("unknown option '%s'\n", argv[i]);
+			learn_file_usage();
+			return 1;
+		} else {
+			path = argv[i];
+		}
+	}
+
+	if (path == NULL) {
+		learn_file_usage();
+		return 1;
+	}
+
+	if (ir_corpus_load(path, &corpus) < 0)
+		return 1;
+
+	if ((cs = cluster_new(&cfg)) == NULL) {
+		printf("out of memory\n");
+		ir_corpus_free(&corpus);
+		return 1;
+	}
+
+	/* decode first, so only the clustering is timed. a capture may hold
+	 * several frames back to back, each is decoded and clustered alone */
+	for (f = 0; f < corpus.count; f++) {
+		memset(&p, 0, sizeof(p));
+		p.len = corpus.len[f] > CLUSTER_MAX_EDGES ?
+			CLUSTER_MAX_EDGES : corpus.len[f];
+		memcpy(p.buf, &corpus.edges[corpus.offset[f]],
+				p.len * sizeof(p.buf[0]));
+		p.elapsed = corpus.elapsed[f];
+
+		nseg = segment_split(p.buf, p.len, seg, SEGMENT_MAX);
+		frames += nseg;
+
+		for (s = 0; s < nseg; s++) {
+			q = segment_packet(&p, &seg[s], &sub);
+			if (!all && ir_decode_packet(q, &d) != RC_PROTO_UNKNOWN)
+				continue;
+
+			if (n == cap) {
+				cap = cap ? cap * 2 : 1024;
+				if ((np = realloc(pick, cap * sizeof(*pick))) ==
+						NULL) {
+					printf("out of memory\n");
+					free(pick);
+					cluster_free(cs);
+					ir_corpus_free(&corpus);
+					return 1;
+				}
+				pick = np;
+			}
+			pick[n].off = corpus.offset[f] + seg[s].off;
+			pick[n].len = seg[s].len;
+			pick[n].elapsed = q->elapsed;
+			n++;
+		}
+	}
+
+	t = now_sec();
+	for (f = 0; f < n; f++)
+		cluster_add(cs, &corpus.edges[pick[f].off], pick[f].len,
+				pick[f].elapsed, NULL);
+	secs = now_sec() - t;
+
+	shown = cluster_print(cs, stdout, min_frames);
+	cluster_stats(cs, &st);
+
+	printf("\n");
+	printf("frames:          %zu\n", frames);
+	if (corpus.truncated)
+		printf("lines too long:  %zu, left out\n", corpus.truncated);
+	printf("clustered:       %zu%s\n", n,
+			all ? "" : ", those that didn't decode");
+	printf("clusters:        %llu, %d with at least %u frames\n",
+			(unsigned long long)(st.created - st.merged -
+				st.evicted), shown, min_frames);
+	printf("ignored:         %llu\n", (unsigned long long)st.ignored);
+	printf("merged:          %llu\n", (unsigned long long)st.merged);
+	printf("evicted:         %llu\n", (unsigned long long)st.evicted);
+	printf("dropped:         %llu\n", (unsigned long long)st.dropped);
+	printf("frames/sec:      %.0f\n", secs > 0 ? n / secs : 0);
+
+	free(pick);
+	cluster_free(cs);
+	ir_corpus_free(&corpus);
+
+	return 0;
+}
@@ -0,0 +1,174 @@
+/**
+ * COPYRIGHT 2024 Flirc, Inc. All rights reserved.
+ *
+ * This copyright notice is Copyright Management Information under 17 USC 1202
+ * and is included to protect this work and deter copyright infringement.
+ * Removal or alteration of this Copyright Management Information without
+ * the express written permission of Flirc, Inc. is prohibited, and any
+ * such unauthorized removal or alteration will be a violation of federal law.
+ */
+
+#ifndef I__CLUSTER_H__
+#define I__CLUSTER_H__
+
+#include <stdint.h>
+#include <stdio.h>
+
+/**
+ * Groups raw frames that libir couldn't decode by the button that sent them.
+ *
+ * Pressing each button of an unknown remote a few times, in any order,
+ * leaves one cluster per button, and each cluster's averaged waveform is a
+ * cleaner copy of the button than any single capture.
+ *
+ * Frames are compared by shape. Every edge is quantized onto a log scale,
+ * CLUSTER_STEP percent a step, so a tolerance of a few steps is the same
+ * proportion of a 560 us bit as of a 9 ms header. Only frames with the
+ * same number of edges can match, so each edge count has its own bucket.
+ * A frame joins the cluster in its bucket whose average it is nearest to,
+ * provided no edge is further off than the tolerance. Two buttons on one
+ * remote can differ in a single bit, so one edge out is enough to keep
+ * them apart. Two clusters whose averages come within the tolerance of
+ * each other are merged.
+ *
+ * A frame is compared a byte an edge against the clusters in its bucket,
+ * giving up on each at the first edge out, so it costs little more than
+ * a pass over the clusters of the same length.
+ */
+
+/* log scale step, percent */
+#define CLUSTER_STEP		(6)
+
+/* edges a frame may have, as struct ir_packet */
+#define CLUSTER_MAX_EDGES	(256)
+
+/**
+ * struct cluster_cfg
+ *
+ * @max_clusters:   clusters held, when full a new shape replaces the
+ *                  stalest cluster that only ever saw one frame
+ * @tol:            steps an edge may be from the cluster average
+ * @min_edges:      shorter frames are ignored, a lone mark is usually
+ *                  ambient light rather than a remote
+ */
+struct cluster_cfg {
+	unsigned int max_clusters;
+	unsigned int tol;
+	unsigned int min_edges;
+};
+
+/* 4 steps is about 27%, past a receiver's usual mark stretch and well short
+ * of the 3:1 between a NEC 0 and 1 */
+#define CLUSTER_DEFAULTS	{ 128, 4, 4 }
+
+/**
+ * struct cluster_info - one cluster's canonical frame
+ *
+ * @buf:        average of every frame in the cluster, us, mark first
+ * @len:        edges in buf
+ * @elapsed:    average struct ir_packet elapsed
+ * @frames:     frames that joined
+ * @confidence: 0 to 100, how far the cluster can be trusted to be a real
+ *              button. it grows with the frames seen, 3 give 50 and 9
+ *              give 80, and shrinks as their average distance from the
+ *              canonical frame approaches the tolerance
+ */
+struct cluster_info {
+	uint16_t buf[CLUSTER_MAX_EDGES];
+	uint16_t len;
+	uint16_t elapsed;
+	uint32_t frames;
+	unsigned int confidence;
+};
+
+/**
+ * struct cluster_stats - counters since cluster_new()
+ *
+ * @frames:     frames passed to cluster_add()
+ * @ignored:    frames too short or too long to cluster
+ * @created:    clusters started
+ * @merged:     clusters folded into another started by the same button
+ * @evicted:    clusters replaced when the set was full
+ * @dropped:    frames that matched nothing with no room for a new cluster
+ */
+struct cluster_stats {
+	uint64_t frames;
+	uint64_t ignored;
+	uint64_t created;
+	uint64_t merged;
+	uint64_t evicted;
+	uint64_t dropped;
+};
+
+struct cluster_set;
+
+/**
+ * cluster_new() - Creates an empty set of clusters.
+ *
+ * @param *cfg  - settings, NULL for CLUSTER_DEFAULTS
+ *
+ * @return      - the set, NULL if out of memory
+ */
+struct cluster_set *cluster_new(const struct cluster_cfg *cfg);
+
+void cluster_free(struct cluster_set *cs);
+
+/**
+ * cluster_add() - Places a frame in the cluster it belongs to, starting a
+ * new one if it's like nothing seen so far.
+ *
+ * @param *buf      - edges, us, mark first
+ * @param len       - number of edges
+ * @param elapsed   - struct ir_packet elapsed, averaged like the edges
+ * @param *created  - set to 1 if the frame started a new cluster, else 0,
+ *                    may be NULL
+ *
+ * @return          - the cluster id, which may be one the frame's cluster
+ *                    was just merged into, -1 if the frame was ignored or
+ *                    dropped
+ */
+int cluster_add(struct cluster_set *cs, const uint16_t *buf, uint16_t len,
+		uint16_t elapsed, int *created);
+
+/**
+ * cluster_count() - Number of cluster ids handed out, ids run from 0 to
+ * one less than this. An evicted or merged cluster's id is reused.
+ */
+int cluster_count(const struct cluster_set *cs);
+
+/**
+ * cluster_get() - Canonical frame of a cluster.
+ *
+ * @param id    - cluster id
+ * @param *ci   - filled in
+ *
+ * @return      - 0, or -1 if there is no such cluster, or it was merged
+ *                into another
+ */
+int cluster_get(const struct cluster_set *cs, int id, struct cluster_info *ci);
+
+void cluster_stats(const struct cluster_set *cs, struct cluster_stats *st);
+
+/**
+ * cluster_print() - Lists the clusters, most frames first, each with its
+ * canonical frame in the `ir decode` format.
+ *
+ * @param *fp          - where to
+ * @param min_frames   - clusters with fewer frames are left out
+ *
+ * @return             - clusters listed
+ */
+int cluster_print(const struct cluster_set *cs, FILE *fp,
+		unsigned int min_frames);
+
+/**
+ * learn_file() - Entry point for `ir learn <capture>`, clusters the
+ * frames of a capture file that don't decode.
+ *
+ * usage: ir learn [--tol=N] [--min=N] [--all] <capture>
+ *
+ * @return         - 0 on success, 1 on error
+ */
+int learn_file(int argc, char *argv[]);
+
+#endif /* I__CLUSTER_H__ */
@@ -0,0 +1,651 @@
+/**
+ * COPYRIGHT 2024 Flirc, Inc. All rights reserved.
+ *
+ * This copyright notice is Copyright Management Information under 17 USC 1202
+ * and is included to protect this work and deter copyright infringement.
+ * Removal or alteration of this Copyright Management Information without
+ * the express written permission of Flirc, Inc. is prohibited, and any
+ * such unauthorized removal or alteration will be a violation of federal law.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/types.h>
+#ifndef __HOST_WIN__
+#include <sys/wait.h>
+#endif
+
+#include <ir/ir.h>
+
+#include "decode_file.h"
+#include "frame.h"
+#include "segment.h"
+
+#ifndef ARRAY_SIZE
+#define ARRAY_SIZE(array)	(sizeof((array))/sizeof((array)[0]))
+#endif
+
+/* every value of enum rc_proto, RC_PROTO_GAP is the last entry */
+#define IR_PROTO_COUNT		(RC_PROTO_GAP + 1)
+
+/* upper bound on forked decoders */
+#define MAX_WORKERS		(64)
+
+enum output_fmt {
+	OUTPUT_TEXT = 0,
+	OUTPUT_CSV,
+	OUTPUT_JSON,
+};
+
+/**
+ * struct decode_tally - results from a single worker
+ *
+ * This is written as-is through a pipe from a worker back to the parent, so
+ * it must not contain pointers.
+ */
+struct decode_tally {
+	uint64_t frames;
+	uint64_t failures;
+	uint64_t split;
+	uint64_t truncated;
+	uint64_t proto[IR_PROTO_COUNT];
+};
+
+static double now_sec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int corpus_reserve(struct ir_corpus *c, size_t edges)
+{
+	if (c->count == c->frames_cap) {
+		size_t cap = c->frames_cap ? c->frames_cap * 2 : 1024;
+		void *o = realloc(c->offset, cap * sizeof(c->offset[0]));
+		void *l = o ? realloc(c->len, cap * sizeof(c->len[0])) : NULL;
+		void *e = l ? realloc(c->elapsed,
+				cap * sizeof(c->elapsed[0])) : NULL;
+
+		if (o)
+			c->offset = o;
+		if (l)
+			c->len = l;
+		if (e == NULL)
+			return -1;
+		c->elapsed = e;
+		c->frames_cap = cap;
+	}
+
+	if (c->count) {
+		edges += c->offset[c->count - 1] + c->len[c->count - 1];
+	}
+
+	if (edges > c->edges_cap) {
+		size_t cap = c->edges_cap ? c->edges_cap : 64 * 1024;
+		void *p;
+
+		while (cap < edges)
+			cap *= 2;
+
+		if ((p = realloc(c->edges, cap * sizeof(c->edges[0]))) == NULL)
+			return -1;
+		c->edges = p;
+		c->edges_cap = cap;
+	}
+
+	return 0;
+}
+
+static int corpus_add(struct ir_corpus *c, const uint16_t *buf,
+		uint16_t len, uint16_t elapsed)
+{
+	size_t off = 0;
+
+	/* if we lead with zero, toss it, same as `ir decode` */
+	if (len && buf[0] == 0) {
+		buf++;
+		len--;
+	}
+
+	if (len == 0)
+		return 0;
+
+	if (len > MAX_EDGES)
+		len = MAX_EDGES;
+
+	if (corpus_reserve(c, len) < 0)
+		return -1;
+
+	if (c->count)
+		off = c->offset[c->count - 1] + c->len[c->count - 1];
+
+	memcpy(&c->edges[off], buf, len * sizeof(buf[0]));
+	c->offset[c->count] = off;
+	c->len[c->count] = len;
+	c->elapsed[c->count] = elapsed;
+	c->count++;
+
+	return 0;
+}
+
+void ir_corpus_free(struct ir_corpus *corpus)
+{
+	free(corpus->edges);
+	free(corpus->offset);
+	free(corpus->len);
+	free(corpus->elapsed);
+	memset(corpus, 0, sizeof(*corpus));
+}
+
+/**
+ * Slurp the whole file, captures are read once and then only walked in
+ * memory. Works on pipes as well as regular files, the len bytes at head
+ * were already read from it and start the buffer.
+ */
+static char *read_file(FILE *fp, const char *head, size_t len, size_t *size)
+{
+	size_t cap = 1 << 20;
+	size_t n;
+	char *buf = malloc(cap + 1);
+
+	if (buf == NULL)
+		return NULL;
+
+	memcpy(buf, head, len);
+
+	while ((n = fread(&buf[len], 1, cap - len, fp)) > 0) {
+		len += n;
+		if (len == cap) {
+			char *p = realloc(buf, cap * 2 + 1);
+			if (p == NULL) {
+				free(buf);
+				return NULL;
+			}
+			buf = p;
+			cap *= 2;
+		}
+	}
+
+	/* terminate so the text parser can't run off the end */
+	buf[len] = '\0';
+	*size = len;
+
+	return buf;
+}
+
+/* records are struct ir_frame, read one at a time past the magic */
+static int parse_binary(FILE *fp, struct ir_corpus *c)
+{
+	uint16_t buf[IR_FRAME_MAX / sizeof(uint16_t)];
+	struct ir_frame *f = (struct ir_frame *)buf;
+	size_t at = IRCAP_MAGIC_LEN;
+	int rq;
+
+	while ((rq = ir_frame_read(fp, f, MAX_EDGES)) == 1) {
+		at += IR_FRAME_SIZE(f->len);
+
+		if (corpus_add(c, f->buf, f->len, f->elapsed) < 0)
+			return -1;
+	}
+
+	if (rq < 0) {
+		printf("truncated or corrupt record at offset %lu\n",
+				(unsigned long)at);
+		return -1;
+	}
+
+	return 0;
+}
+
+static int parse_text(char *data, struct ir_corpus *c)
+{
+	uint16_t buf[MAX_EDGES + 1];
+	char *line = data;
+
+	while (*line) {
+		char *end = line + strcspn(line, "\r\n");
+		char *s = line;
+		char next = *end;
+		uint16_t len = 0;
+		size_t values = 0;
+
+		*end = '\0';
+
+		while (*s == ' ' || *s == '\t')
+			s++;
+
+		if (*s != '#') {
+			while (*s) {
+				char *stop;
+				long v;
+
+				/* anything that isn't a digit is a delimiter */
+				if (*s < '0' || *s > '9') {
+					s++;
+					continue;
+				}
+
+				/* counted past the end, to tell a long frame
+				 * from one that just fits */
+				v = strtol(s, &stop, 10);
+				if (len < ARRAY_SIZE(buf))
+					buf[len++] = v > UINT16_MAX ?
+						UINT16_MAX : v;
+				values++;
+				s = stop;
+			}
+
+			/* a leading zero is dropped by corpus_add */
+			if (values - (len && buf[0] == 0) > MAX_EDGES)
+				c->truncated++;
+			else if (corpus_add(c, buf, len, 0) < 0)
+				return -1;
+		}
+
+		line = next ? end + 1 : end;
+	}
+
+	return 0;
+}
+
+int ir_corpus_load(const char *path, struct ir_corpus *corpus)
+{
+	FILE *fp = stdin;
+	char head[IRCAP_MAGIC_LEN];
+	char *data;
+	size_t size, n;
+	int rq;
+
+	memset(corpus, 0, sizeof(*corpus));
+
+	if (strcmp(path, "-") != 0) {
+		if ((fp = fopen(path, "rb")) == NULL) {
+			perror("could not open capture file");
+			return -1;
+		}
+	}
+
+	/* stdin can't be rewound, a text file is read on from the head */
+	n = fread(head, 1, sizeof(head), fp);
+	if (n == IRCAP_MAGIC_LEN &&
+			memcmp(head, IRCAP_MAGIC, IRCAP_MAGIC_LEN) == 0) {
+		rq = parse_binary(fp, corpus);
+	} else if ((data = read_file(fp, head, n, &size)) != NULL) {
+		rq = parse_text(data, corpus);
+		free(data);
+	} else {
+		printf("could not read capture file\n");
+		rq = -1;
+	}
+
+	if (fp != stdin)
+		fclose(fp);
+
+	if (rq < 0) {
+		ir_corpus_free(corpus);
+		return -1;
+	}
+
+	return (int)corpus->count;
+}
+
+FILE *ir_capture_create(const char *path)
+{
+	FILE *fp;
+
+	if ((fp = fopen(path, "wb")) == NULL) {
+		perror("could not create capture file");
+		return NULL;
+	}
+
+	if (fwrite(IRCAP_MAGIC, 1, IRCAP_MAGIC_LEN, fp) != IRCAP_MAGIC_LEN) {
+		perror("could not write capture file");
+		fclose(fp);
+		return NULL;
+	}
+
+	return fp;
+}
+
+/**
+ * Decode every n'th frame of the corpus starting at frame w.
+ */
+static void decode_stride(const struct ir_corpus *c, size_t w, size_t n,
+		struct decode_tally *t)
+{
+	struct segment seg[SEGMENT_MAX];
+	struct ir_packet p, sub, *q;
+	struct ir_prot d;
+	size_t i;
+	int nseg, s;
+
+	memset(t, 0, sizeof(*t));
+
+	for (i = w; i < c->count; i += n) {
+		memcpy(p.buf, &c->edges[c->offset[i]],
+				c->len[i] * sizeof(p.buf[0]));
+		p.len = c->len[i];
+		p.elapsed = c->elapsed[i];
+
+		/* a capture may hold several frames back to back */
+		nseg = segment_split(p.buf, p.len, seg, SEGMENT_MAX);
+		t->split += nseg > 1 ? nseg - 1 : 0;
+
+		for (s = 0; s < nseg; s++) {
+			enum rc_proto proto;
+
+			q = segment_packet(&p, &seg[s], &sub);
+			proto = ir_decode_packet(q, &d);
+
+			if ((unsigned)proto >= IR_PROTO_COUNT)
+				proto = RC_PROTO_UNKNOWN;
+
+			if (proto == RC_PROTO_UNKNOWN ||
+					proto == RC_PROTO_INVALID)
+				t->failures++;
+
+			t->proto[proto]++;
+			t->frames++;
+		}
+	}
+}
+
+static void tally_add(struct decode_tally *sum, const struct decode_tally *t)
+{
+	int i;
+
+	sum->frames += t->frames;
+	sum->failures += t->failures;
+	sum->split += t->split;
+
+	for (i = 0; i < IR_PROTO_COUNT; i++)
+		sum->proto[i] += t->proto[i];
+}
+
+#ifndef __HOST_WIN__
+static int write_all(int fd, const void *buf, size_t len)
+{
+	const char *p = buf;
+	ssize_t n;
+
+	while (len) {
+		if ((n = write(fd, p, len)) <= 0)
+			return -1;
+		p += n;
+		len -= n;
+	}
+
+	return 0;
+}
+
+static int read_all(int fd, void *buf, size_t len)
+{
+	char *p = buf;
+	ssize_t n;
+
+	while (len) {
+		if ((n = read(fd, p, len)) <= 0)
+			return -1;
+		p += n;
+		len -= n;
+	}
+
+	return 0;
+}
+
+/**
+ * libir keeps decoder state in static storage, so decoding from several
+ * threads at once is not safe. Each worker is a forked process instead; it
+ * inherits the loaded corpus copy-on-write, decodes its share of the frames
+ * and writes its tally back through a pipe.
+ */
+static int decode_parallel(const struct ir_corpus *c, int workers,
+		struct decode_tally *sum)
+{
+	int fds[MAX_WORKERS];
+	pid_t pids[MAX_WORKERS];
+	int status = 0;
+	int i;
+
+	/* stdio buffers would otherwise be flushed once per child */
+	fflush(stdout);
+	fflush(stderr);
+
+	for (i = 0; i < workers; i++) {
+		int p[2];
+
+		if (pipe(p) < 0) {
+			perror("pipe");
+			workers = i;
+			status = -1;
+			break;
+		}
+
+		if ((pids[i] = fork()) < 0) {
+			perror("fork");
+			close(p[0]);
+			close(p[1]);
+			workers = i;
+			status = -1;
+			break;
+		}
+
+		if (pids[i] == 0) {
+			struct decode_tally t;
+
+			close(p[0]);
+			decode_stride(c, i, workers, &t);
+			_exit(write_all(p[1], &t, sizeof(t)) < 0);
+		}
+
+		close(p[1]);
+		fds[i] = p[0];
+	}
+
+	for (i = 0; i < workers; i++) {
+		struct decode_tally t;
+		int wstatus;
+
+		if (read_all(fds[i], &t, sizeof(t)) < 0) {
+			printf("worker %d failed\n", i);
+			status = -1;
+		} else {
+			tally_add(sum, &t);
+		}
+
+		close(fds[i]);
+		waitpid(pids[i], &wstatus, 0);
+	}
+
+	return status;
+}
+#endif
+
+static int default_workers(void)
+{
+#ifdef _SC_NPROCESSORS_ONLN
+	long n = sysconf(_SC_NPROCESSORS_ONLN);
+	if (n > 0)
+		return n > MAX_WORKERS ? MAX_WORKERS : (int)n;
+#endif
+	return 1;
+}
+
+static void print_text(const struct decode_tally *t, double secs, int workers)
+{
+	int i;
+
+	printf("%-16s %10s %8s\n", "protocol", "frames", "share");
+
+	for (i = 0; i < IR_PROTO_COUNT; i++) {
+		if (t->proto[i] == 0)
+			continue;
+		printf("%-16s %10llu %7.2f%%\n", enum_to_str(i),
+				(unsigned long long)t->proto[i],
+				100.0 * t->proto[i] / t->frames);
+	}
+
+	printf("\n");
+	printf("%-20s %llu\n", "frames:", (unsigned long long)t->frames);
+	printf("%-20s %llu (%.2f%%)\n", "decode failures:",
+			(unsigned long long)t->failures,
+			t->frames ? 100.0 * t->failures / t->frames : 0.0);
+	printf("%-20s %llu\n", "frames split:",
+			(unsigned long long)t->split);
+	printf("%-20s %llu\n", "lines too long:",
+			(unsigned long long)t->truncated);
+	printf("%-20s %d\n", "workers:", workers);
+	printf("%-20s %.3f s\n", "elapsed:", secs);
+	printf("%-20s %.0f\n", "frames/sec:", secs > 0 ? t->frames / secs : 0);
+}
+
+static void print_csv(const struct decode_tally *t, double secs, int workers)
+{
+	int i;
+
+	printf("protocol,frames\n");
+
+	for (i = 0; i < IR_PROTO_COUNT; i++) {
+		if (t->proto[i] == 0)
+			continue;
+		printf("%s,%llu\n", enum_to_str(i),
+				(unsigned long long)t->proto[i]);
+	}
+
+	printf("\n");
+	printf("frames,failures,failure_rate,workers,seconds,frames_per_sec,"
+			"split,truncated\n");
+	printf("%llu,%llu,%.6f,%d,%.6f,%.0f,%llu,%llu\n",
+			(unsigned long long)t->frames,
+			(unsigned long long)t->failures,
+			t->frames ? (double)t->failures / t->frames : 0.0,
+			workers, secs, secs > 0 ? t->frames / secs : 0,
+			(unsigned long long)t->split,
+			(unsigned long long)t->truncated);
+}
+
+static void print_json(const struct decode_tally *t, double secs, int workers)
+{
+	const char *sep = "";
+	int i;
+
+	printf("{\n");
+	printf("  \"frames\": %llu,\n", (unsigned long long)t->frames);
+	printf("  \"failures\": %llu,\n", (unsigned long long)t->failures);
+	printf("  \"failure_rate\": %.6f,\n",
+			t->frames ? (double)t->failures / t->frames : 0.0);
+	printf("  \"split\": %llu,\n", (unsigned long long)t->split);
+	printf("  \"truncated\": %llu,\n", (unsigned long long)t->truncated);
+	printf("  \"workers\": %d,\n", workers);
+	printf("  \"seconds\": %.6f,\n", secs);
+	printf("  \"frames_per_sec\": %.0f,\n",
+			secs > 0 ? t->frames / secs : 0);
+	printf("  \"protocols\": {");
+
+	for (i = 0; i < IR_PROTO_COUNT; i++) {
+		if (t->proto[i] == 0)
+			continue;
+		printf("%s\n    \"%s\": %llu", sep, enum_to_str(i),
+				(unsigned long long)t->proto[i]);
+		sep = ",";
+	}
+
+	printf("\n  }\n");
+	printf("}\n");
+}
+
+static void decode_file_usage(void)
+{
+	printf("usage: ir decode-file [--workers=N] [--csv|--json] <capture>\n");
+	printf("     - capture is a text file with one raw frame per line, or\n");
+	printf("       a binary capture starting with '%s'. '-' is stdin\n",
+			IRCAP_MAGIC);
+}
+
+int decode_file(int argc, char *argv[])
+{
+	enum output_fmt fmt = OUTPUT_TEXT;
+	struct ir_corpus corpus;
+	struct decode_tally sum;
+	const char *path = NULL;
+	int workers = default_workers();
+	double start, secs;
+	int status = 0;
+	int i;
+
+	for (i = 0; i < argc; i++) {
+		if (strncmp(argv[i], "--workers=", 10) == 0) {
+			workers = atoi(&argv[i][10]);
+		} else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+			workers = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "--csv") == 0) {
+			fmt = OUTPUT_CSV;
+		} else if (strcmp(argv[i], "--json") == 0) {
+			fmt = OUTPUT_JSON;
+		} else if (argv[i][0] == '-' && argv[i][1] != '\0') {
+			printf("unknown option '%s'\n", argv[i]);
+			decode_file_usage();
+			return 1;
+		} else {
+			path = argv[i];
+		}
+	}
+
+	if (path == NULL) {
+		decode_file_usage();
+		return 1;
+	}
+
+	if (workers < 1)
+		workers = 1;
+	if (workers > MAX_WORKERS)
+		workers = MAX_WORKERS;
+
+	if (ir_corpus_load(path, &corpus) < 0)
+		return 1;
+
+	/* no point forking more workers than there are frames */
+	if ((size_t)workers > corpus.count)
+		workers = corpus.count ? (int)corpus.count : 1;
+
+	memset(&sum, 0, sizeof(sum));
+	start = now_sec();
+
+#ifndef __HOST_WIN__
+	if (workers > 1) {
+		status = decode_parallel(&corpus, workers, &sum);
+	} else
+#endif
+	{
+		workers = 1;
+		decode_stride(&corpus, 0, 1, &sum);
+	}
+
+	secs = now_sec() - start;
+	sum.truncated = corpus.truncated;
+
+	switch (fmt) {
+	case (OUTPUT_CSV):
+		print_csv(&sum, secs, workers);
+		break;
+	case (OUTPUT_JSON):
+		print_json(&sum, secs, workers);
+		break;
+	default:
+		print_text(&sum, secs, workers);
+		break;
+	}
+
+	ir_corpus_free(&corpus);
+
+	return status < 0 ? 1 : 0;
+}
@@ -0,0 +1,95 @@
+/**
+ * COPYRIGHT 2024 Flirc, Inc. All rights reserved.
+ *
+ * This copyright notice is Copyright Management Information under 17 USC 1202
+ * and is included to protect this work and deter copyright infringement.
+ * Removal or alteration of this Copyright Management Information without
+ * the express written permission of Flirc, Inc. is prohibited, and any
+ * such unauthorized removal or alteration will be a violation of federal law.
+ */
+
+#ifndef I__DECODE_FILE_H__
+#define I__DECODE_FILE_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+
+/**
+ * Binary capture files start with this 8 byte magic, followed by a list of
+ * records in host byte order:
+ *
+ *     uint16_t len;
+ *     uint16_t elapsed;
+ *     uint16_t buf[len];
+ *
+ * which is struct ir_frame (frame.h).
+ *
+ * Any file not starting with the magic is treated as text, one frame per
+ * line in the same format accepted by `ir decode`, i.e. "+9000 -4500 +560"
+ * or "9000,4500,560". Blank lines and lines starting with '#' are skipped.
+ */
+#define IRCAP_MAGIC		"IRCAP001"
+#define IRCAP_MAGIC_LEN		(8)
+
+/**
+ * struct ir_corpus - a capture corpus loaded into memory
+ *
+ * Frames are stored back to back in a single edge pool instead of an array
+ * of struct ir_packet, a typical 68 edge frame costs 136 bytes rather than
+ * 516.
+ *
+ * @edges:     edge pool for every frame in the corpus
+ * @offset:    start of each frame within @edges
+ * @len:       number of edges in each frame
+ * @elapsed:   elapsed time recorded with each frame, 0 for text captures
+ * @count:     number of frames
+ * @truncated: text lines with more than MAX_EDGES edges, left out rather
+ *             than decoded cut short
+ */
+struct ir_corpus {
+	uint16_t *edges;
+	size_t *offset;
+	uint16_t *len;
+	uint16_t *elapsed;
+	size_t count;
+	size_t truncated;
+
+	/* allocation sizes, private */
+	size_t edges_cap;
+	size_t frames_cap;
+};
+
+/**
+ * ir_corpus_load() - Loads a text or binary capture file into memory.
+ *
+ * @param *path    - file to load, "-" reads from stdin
+ * @param *corpus  - corpus to fill, release with ir_corpus_free()
+ *
+ * @return         - number of frames loaded, negative on error
+ */
+int ir_corpus_load(const char *path, struct ir_corpus *corpus);
+
+/**
+ * ir_corpus_free() - Releases memory held by a corpus.
+ */
+void ir_corpus_free(struct ir_corpus *corpus);
+
+/**
+ * ir_capture_create() - Creates a binary capture file, ready for
+ * ir_frame_write() (frame.h). Close it with fclose().
+ *
+ * @return         - the file, NULL on error
+ */
+FILE *ir_capture_create(const char *path);
+
+/**
+ * decode_file() - Entry point for `ir decode-file`.
+ *
+ * usage: ir decode-file [--workers=N] [--csv|--json] <capture>
+ *
+ * @return         - 0 on success, 1 on error
+ */
+int decode_file(int argc, char *argv[]);
+
+#endif /* I__DECODE_FILE_H__ */
@@ -0,0 +1,98 @@
+/**
+ * COPYRIGHT 2024 Flirc, Inc. All rights reserved.
+ *
+ * This copyright notice is Copyright Management Information under 17 USC 1202
+ * and is included to protect this work and deter copyright infringement.
+ * Removal or alteration of this Copyright Management Information without
+ * the express written permission of Flirc, Inc. is prohibited, and any
+ * such unauthorized removal or alteration will be a violation of federal law.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <ir/ir.h>
+
+#include "frame.h"
+
+size_t ir_frame_pack(struct ir_frame *f, const struct ir_packet *p)
+{
+	uint16_t len = p->len > MAX_EDGES ? MAX_EDGES : p->len;
+
+	f->len = len;
+	f->elapsed = p->elapsed;
+	memcpy(f->buf, p->buf, len * sizeof(f->buf[0]));
+
+	return IR_FRAME_SIZE(len);
+}
+
+void ir_frame_unpack(const struct ir_frame *f, struct ir_packet *p)
+{
+	p->len = f->len > MAX_EDGES ? MAX_EDGES : f->len;
+	p->elapsed = f->elapsed;
+	memcpy(p->buf, f->buf, p->len * sizeof(p->buf[0]));
+}
+
+enum rc_proto ir_frame_decode(const struct ir_frame *f, struct ir_result *r,
+		size_t max)
+{
+	struct ir_packet p;
+	struct ir_prot d;
+	enum rc_proto got;
+
+	ir_frame_unpack(f, &p);
+	got = ir_decode_packet(&p, &d);
+
+	r->protocol = d.protocol;
+	r->scancode = d.scancode;
+	r->hash = d.hash;
+	r->repeat = d.repeat;
+	r->len = 0;
+	r->pronto_len = 0;
+
+	if (IR_RESULT_SIZE(d.len, d.pronto_len) <= max) {
+		r->len = d.len;
+		r->pronto_len = d.pronto_len;
+		memcpy(r->data, d.buf, d.len * sizeof(r->data[0]));
+		memcpy(&r->data[d.len], d.pronto,
+				d.pronto_len * sizeof(r->data[0]));
+	}
+
+	return got;
+}
+
+int ir_frame_encode(enum rc_proto protocol, uint32_t scancode,
+		struct ir_frame *f, uint16_t max)
+{
+	struct ir_packet p;
+
+	memset(&p, 0, sizeof(p));
+	if (ir_encode(protocol, scancode, &p) < 0 || p.len > max)
+		return -1;
+
+	ir_frame_pack(f, &p);
+
+	return f->len;
+}
+
+int ir_frame_write(FILE *fp, const struct ir_frame *f)
+{
+	return fwrite(f, IR_FRAME_SIZE(f->len), 1, fp) == 1 ? 0 : -1;
+}
+
+int ir_frame_read(FILE *fp, struct ir_frame *f, uint16_t max)
+{
+	size_t n;
+
+	if ((n = fread(f, 1, sizeof(*f), fp)) == 0)
+		return 0;
+	if (n != sizeof(*f) || f->len > max)
+		return -1;
+
+	if (fread(f->buf, sizeof(f->buf[0]), f->len, fp) != f->len)
+		return -1;
+
+	return 1;
+}
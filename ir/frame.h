@@ -0,0 +1,139 @@
+/**
+ * COPYRIGHT 2024 Flirc, Inc. All rights reserved.
+ *
+ * This copyright notice is Copyright Management Information under 17 USC 1202
+ * and is included to protect this work and deter copyright infringement.
+ * Removal or alteration of this Copyright Management Information without
+ * the express written permission of Flirc, Inc. is prohibited, and any
+ * such unauthorized removal or alteration will be a violation of federal law.
+ */
+
+#ifndef I__FRAME_H__
+#define I__FRAME_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <ir/ir.h>
+
+/**
+ * Frames and decode results the size of what's in them.
+ *
+ * struct ir_packet holds 256 edges and struct ir_prot two buffers of
+ * MAX_EDGES, though a frame is usually 34 to 68 edges. Stored or queued as
+ * they are, 80 to 90 percent of what's moved is unused. struct ir_frame
+ * and struct ir_result end in a flexible array sized to the frame, so a
+ * 68 edge NEC frame is 140 bytes rather than 516.
+ *
+ * struct ir_frame is laid out like a record of a binary capture file
+ * (decode_file.h), so a frame is written or read in one go.
+ *
+ * libir itself only takes the fixed types, and may write to the packet it
+ * decodes, so ir_frame_decode() copies the edges there is into one on the
+ * stack. What it saves is in storage and queues.
+ */
+
+/**
+ * struct ir_frame
+ *
+ * @len:        edges in buf
+ * @elapsed:    as struct ir_packet
+ * @buf:        edges, us, mark first
+ */
+struct ir_frame {
+	uint16_t len;
+	uint16_t elapsed;
+	uint16_t buf[];
+};
+
+/* bytes for a frame of n edges, and for the longest */
+#define IR_FRAME_SIZE(n)	(sizeof(struct ir_frame) + (n) * sizeof(uint16_t))
+#define IR_FRAME_MAX		IR_FRAME_SIZE(MAX_EDGES)
+
+/**
+ * struct ir_result - struct ir_prot without the fixed buffers
+ *
+ * @protocol:   as struct ir_prot
+ * @scancode:   as struct ir_prot
+ * @hash:       as struct ir_prot
+ * @repeat:     as struct ir_prot
+ * @len:        edges of the ideal frame at the start of data
+ * @pronto_len: pronto words after them
+ * @data:       ideal frame, then pronto
+ */
+struct ir_result {
+	enum rc_proto protocol;
+	uint32_t scancode;
+	uint32_t hash;
+	uint8_t repeat;
+	uint16_t len;
+	uint16_t pronto_len;
+	uint16_t data[];
+};
+
+#define IR_RESULT_SIZE(len, pronto_len) \
+	(sizeof(struct ir_result) + ((len) + (pronto_len)) * sizeof(uint16_t))
+#define IR_RESULT_MAX		IR_RESULT_SIZE(MAX_EDGES, MAX_EDGES)
+
+static inline const uint16_t *ir_result_pronto(const struct ir_result *r)
+{
+	return &r->data[r->len];
+}
+
+/**
+ * ir_frame_pack() - Copies the edges a packet has into a frame.
+ *
+ * @param *f    - room for IR_FRAME_SIZE(p->len)
+ *
+ * @return      - bytes used
+ */
+size_t ir_frame_pack(struct ir_frame *f, const struct ir_packet *p);
+
+void ir_frame_unpack(const struct ir_frame *f, struct ir_packet *p);
+
+/**
+ * ir_frame_decode() - ir_decode_packet() for a frame.
+ *
+ * @param *f    - frame
+ * @param *r    - filled in
+ * @param max   - bytes at r. the ideal frame and pronto are left out, len
+ *                and pronto_len 0, if they don't fit, so a caller only
+ *                after the scancode can pass sizeof(struct ir_result)
+ *
+ * @return      - as ir_decode_packet()
+ */
+enum rc_proto ir_frame_decode(const struct ir_frame *f, struct ir_result *r,
+		size_t max);
+
+/**
+ * ir_frame_encode() - ir_encode() into a frame.
+ *
+ * @param *f    - filled in
+ * @param max   - edges there is room for
+ *
+ * @return      - edges, -1 if libir can't encode it or it doesn't fit
+ */
+int ir_frame_encode(enum rc_proto protocol, uint32_t scancode,
+		struct ir_frame *f, uint16_t max);
+
+/**
+ * ir_frame_write() - Appends a frame to a binary capture file, see
+ * ir_capture_create().
+ *
+ * @return      - 0, -1 on a write error
+ */
+int ir_frame_write(FILE *fp, const struct ir_frame *f);
+
+/**
+ * ir_frame_read() - Reads the next frame of a binary capture file, past
+ * its magic.
+ *
+ * @param max   - edges there is room for
+ *
+ * @return      - 1 for a frame, 0 at the end of the file, -1 if the file
+ *                is cut short or a frame is longer than max
+ */
+int ir_frame_read(FILE *fp, struct ir_frame *f, uint16_t max);
+
+#endif /* I__FRAME_H__ */
@@ -0,0 +1,401 @@
+/**
+ * COPYRIGHT 2024 Flirc, Inc. All rights reserved.
+ *
+ * This copyright notice is Copyright Management Information under 17 USC 1202
+ * and is included to protect this work and deter copyright infringement.
+ * Removal or alteration of this Copyright Management Information without
+ * the express written permission of Flirc, Inc. is prohibited, and any
+ * such unauthorized removal or alteration will be a violation of federal law.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <ir/ir.h>
+
+#include "keymap.h"
+
+#define KEYMAP_MIN_SLOTS	(8)
+#define KEYMAP_CACHELINE	(64)
+
+/* how long publish sleeps between checks on a reader still in the old table */
+#define KEYMAP_WAIT_NS		(50 * 1000)
+
+/**
+ * struct keymap_slot - one slot of the table
+ *
+ * @psl:    probe sequence length, 1 in the home slot, 0 for an empty slot
+ */
+struct keymap_slot {
+	uint64_t key;
+	uint32_t action;
+	uint32_t psl;
+};
+
+struct keymap {
+	struct keymap_slot *slots;
+	uint32_t mask;
+	size_t entries;
+	unsigned int max_probe;
+
+	/* keymap_load() only, names point into text */
+	char *text;
+	const char **names;
+	uint32_t nnames;
+
+	void *mem;
+};
+
+static uint32_t keymap_home(const struct keymap *km, uint64_t key)
+{
+	/* fibonacci hashing, the high bits of the product are well mixed
+	 * even for small sequential scancodes */
+	return (uint32_t)((key * 0x9E3779B97F4A7C15ull) >> 32) & km->mask;
+}
+
+static struct keymap *keymap_alloc(size_t n)
+{
+	struct keymap *km;
+	uintptr_t p;
+	size_t slots = KEYMAP_MIN_SLOTS;
+
+	/* stay under 3/4 full, probes stay short well past that */
+	while (slots * 3 < n * 4)
+		slots <<= 1;
+
+	if ((km = calloc(1, sizeof(*km))) == NULL)
+		return NULL;
+
+	if ((km->mem = calloc(1, slots * sizeof(struct keymap_slot) +
+					KEYMAP_CACHELINE)) == NULL) {
+		free(km);
+		return NULL;
+	}
+
+	p = ((uintptr_t)km->mem + KEYMAP_CACHELINE - 1) &
+		~(uintptr_t)(KEYMAP_CACHELINE - 1);
+	km->slots = (struct keymap_slot *)p;
+	km->mask = slots - 1;
+
+	return km;
+}
+
+static void keymap_insert(struct keymap *km, uint64_t key, uint32_t action)
+{
+	struct keymap_slot s = { key, action, 1 };
+	struct keymap_slot tmp;
+	uint32_t i = keymap_home(km, key);
+
+	for (;;) {
+		struct keymap_slot *t = &km->slots[i];
+
+		if (!t->psl) {
+			*t = s;
+			km->entries++;
+			if (s.psl > km->max_probe)
+				km->max_probe = s.psl;
+			return;
+		}
+
+		/* a key already present is always met before the first swap */
+		if (t->key == s.key) {
+			t->action = s.action;
+			return;
+		}
+
+		/* take from the rich: whoever is closer to home moves on */
+		if (t->psl < s.psl) {
+			tmp = *t;
+			*t = s;
+			s = tmp;
+			if (t->psl > km->max_probe)
+				km->max_probe = t->psl;
+		}
+
+		i = (i + 1) & km->mask;
+		s.psl++;
+	}
+}
+
+struct keymap *keymap_build(const struct keymap_entry *e, size_t n)
+{
+	struct keymap *km;
+	size_t i;
+
+	if ((km = keymap_alloc(n)) == NULL)
+		return NULL;
+
+	for (i = 0; i < n; i++) {
+		if (e[i].key)
+			keymap_insert(km, e[i].key, e[i].action);
+	}
+
+	return km;
+}
+
+static char *read_file(const char *path)
+{
+	FILE *fp;
+	char *buf;
+	long len;
+
+	if ((fp = fopen(path, "rb")) == NULL)
+		return NULL;
+
+	if (fseek(fp, 0, SEEK_END) < 0 || (len = ftell(fp)) < 0 ||
+			fseek(fp, 0, SEEK_SET) < 0 ||
+			(buf = malloc(len + 1)) == NULL) {
+		fclose(fp);
+		return NULL;
+	}
+
+	if (fread(buf, 1, len, fp) != (size_t)len) {
+		free(buf);
+		fclose(fp);
+		return NULL;
+	}
+	buf[len] = '\0';
+	fclose(fp);
+
+	return buf;
+}
+
+static char *skip_space(char *p)
+{
+	while (*p == ' ' || *p == '\t')
+		p++;
+	return p;
+}
+
+static char *next_word(char *p)
+{
+	while (*p && !isspace((unsigned char)*p))
+		p++;
+	return p;
+}
+
+/* parses one line in place, returns 1 for a button, 0 for a blank or
+ * comment line and -1 if it doesn't parse */
+static int parse_line(char *line, uint64_t *key, const char **name)
+{
+	char *p = skip_space(line), *end, *word;
+	unsigned long v;
+
+	if (*p == '\0' || *p == '#')
+		return 0;
+
+	if (isdigit((unsigned char)*p)) {
+		v = strtoul(p, &end, 0);
+		if (end == p || !isspace((unsigned char)*end) || !v ||
+				v > UINT32_MAX)
+			return -1;
+		*key = keymap_key_hash(v);
+	} else {
+		enum rc_proto proto;
+		char c;
+
+		word = p;
+		p = next_word(p);
+		c = *p;
+		*p = '\0';
+		proto = str_to_enum(word);
+		*p = c;
+		if (proto == RC_PROTO_UNKNOWN || proto == RC_PROTO_INVALID)
+			return -1;
+
+		p = skip_space(p);
+		v = strtoul(p, &end, 0);
+		if (end == p || !isspace((unsigned char)*end) ||
+				v > UINT32_MAX)
+			return -1;
+		*key = keymap_key_code(proto, v);
+	}
+
+	p = skip_space(end);
+	if (*p == '\0' || *p == '#')
+		return -1;
+
+	/* the action is the rest of the line, less any comment and trailing
+	 * space */
+	if ((end = strchr(p, '#')) == NULL)
+		end = p + strlen(p);
+	while (end > p && isspace((unsigned char)end[-1]))
+		end--;
+	*end = '\0';
+	*name = p;
+
+	return 1;
+}
+
+struct keymap *keymap_load(const char *path, int *badline)
+{
+	struct keymap_entry *e = NULL;
+	const char **names = NULL;
+	struct keymap *km = NULL;
+	char *text, *line, *nl;
+	size_t lines = 1, n = 0;
+	int lineno = 0;
+
+	*badline = 0;
+
+	if ((text = read_file(path)) == NULL)
+		return NULL;
+
+	for (line = text; (line = strchr(line, '\n')) != NULL; line++)
+		lines++;
+
+	if ((e = malloc(lines * sizeof(*e))) == NULL ||
+			(names = malloc(lines * sizeof(*names))) == NULL)
+		goto out;
+
+	for (line = text; line; line = nl) {
+		const char *name;
+		uint64_t key;
+		int rc;
+
+		if ((nl = strchr(line, '\n')) != NULL)
+			*nl++ = '\0';
+		lineno++;
+
+		if ((rc = parse_line(line, &key, &name)) < 0) {
+			*badline = lineno;
+			goto out;
+		}
+		if (rc == 0)
+			continue;
+
+		e[n].key = key;
+		e[n].action = n;
+		names[n++] = name;
+	}
+
+	if ((km = keymap_build(e, n)) == NULL)
+		goto out;
+
+	km->text = text;
+	km->names = names;
+	km->nnames = n;
+	free(e);
+
+	return km;
+
+out:
+	free(names);
+	free(e);
+	free(text);
+	return NULL;
+}
+
+void keymap_free(struct keymap *km)
+{
+	if (!km)
+		return;
+
+	free(km->names);
+	free(km->text);
+	free(km->mem);
+	free(km);
+}
+
+uint32_t keymap_lookup(const struct keymap *km, uint64_t key)
+{
+	uint32_t i = keymap_home(km, key);
+	uint32_t d;
+
+	/* an empty slot, or one closer to its home than we are to ours,
+	 * ends the search */
+	for (d = 1; ; d++) {
+		const struct keymap_slot *t = &km->slots[i];
+
+		if (t->psl < d)
+			return KEYMAP_NO_ACTION;
+		if (t->key == key)
+			return t->action;
+
+		i = (i + 1) & km->mask;
+	}
+}
+
+uint32_t keymap_match(const struct keymap *km, const struct ir_prot *d)
+{
+	uint32_t a = KEYMAP_NO_ACTION;
+
+	if (d->protocol != RC_PROTO_UNKNOWN && d->protocol != RC_PROTO_INVALID)
+		a = keymap_lookup(km, keymap_key_code(d->protocol,
+					d->scancode));
+
+	if (a == KEYMAP_NO_ACTION && d->hash)
+		a = keymap_lookup(km, keymap_key_hash(d->hash));
+
+	return a;
+}
+
+const char *keymap_action_name(const struct keymap *km, uint32_t action)
+{
+	if (!km->names || action >= km->nnames)
+		return NULL;
+
+	return km->names[action];
+}
+
+void keymap_stats(const struct keymap *km, size_t *entries, size_t *slots,
+		unsigned int *max_probe)
+{
+	*entries = km->entries;
+	*slots = (size_t)km->mask + 1;
+	*max_probe = km->max_probe;
+}
+
+int keymap_reader_add(struct keymap_live *l)
+{
+	if (l->readers >= KEYMAP_MAX_READERS)
+		return -1;
+
+	return l->readers++;
+}
+
+const struct keymap *keymap_enter(struct keymap_live *l, int id)
+{
+	/* announce the read before looking at cur, publish does the
+	 * opposite, so one of us always sees the other */
+	__atomic_add_fetch(&l->reader[id].seq, 1, __ATOMIC_SEQ_CST);
+
+	return __atomic_load_n(&l->cur, __ATOMIC_SEQ_CST);
+}
+
+void keymap_exit(struct keymap_live *l, int id)
+{
+	__atomic_add_fetch(&l->reader[id].seq, 1, __ATOMIC_RELEASE);
+}
+
+void keymap_publish(struct keymap_live *l, struct keymap *km)
+{
+	struct timespec wait = { 0, KEYMAP_WAIT_NS };
+	struct keymap *old;
+	int i;
+
+	old = __atomic_exchange_n(&l->cur, km, __ATOMIC_SEQ_CST);
+	if (!old)
+		return;
+
+	/* a reader inside a read may hold old, any change to its sequence
+	 * means that read is over and the next one will see km */
+	for (i = 0; i < l->readers; i++) {
+		uint64_t s = __atomic_load_n(&l->reader[i].seq,
+				__ATOMIC_SEQ_CST);
+
+		if (!(s & 1))
+			continue;
+		while (__atomic_load_n(&l->reader[i].seq,
+					__ATOMIC_ACQUIRE) == s)
+			nanosleep(&wait, NULL);
+	}
+
+	keymap_free(old);
+}
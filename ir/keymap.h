@@ -0,0 +1,161 @@
+/**
+ * COPYRIGHT 2024 Flirc, Inc. All rights reserved.
+ *
+ * This copyright notice is Copyright Management Information under 17 USC 1202
+ * and is included to protect this work and deter copyright infringement.
+ * Removal or alteration of this Copyright Management Information without
+ * the express written permission of Flirc, Inc. is prohibited, and any
+ * such unauthorized removal or alteration will be a violation of federal law.
+ */
+
+#ifndef I__KEYMAP_H__
+#define I__KEYMAP_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <ir/ir.h>
+
+/**
+ * Button to action lookup for decoded frames.
+ *
+ * A keymap is an immutable Robin Hood hash table of 16 byte slots, four to a
+ * cache line, aligned so a lookup that stays within its home line touches
+ * one line. Entries are keyed either by the 32 bit button hash libir puts
+ * in ir_prot.hash (and fl_last_hash() returns), or by protocol and
+ * scancode; keymap_match() tries both.
+ *
+ * To change a keymap, build a new one and keymap_publish() it. Readers go
+ * through keymap_enter()/keymap_exit() and never block or take a lock;
+ * publishing waits until no reader can still hold the old table, then
+ * frees it.
+ */
+
+/* readers that can be registered on one keymap_live */
+#define KEYMAP_MAX_READERS	(8)
+
+/* action returned for a button that isn't mapped */
+#define KEYMAP_NO_ACTION	(0xFFFFFFFFu)
+
+/* key for a button hash */
+static inline uint64_t keymap_key_hash(uint32_t hash)
+{
+	return hash;
+}
+
+/* key for a protocol and scancode, never collides with a hash key since
+ * RC_PROTO_UNKNOWN is zero */
+static inline uint64_t keymap_key_code(enum rc_proto proto, uint32_t scancode)
+{
+	return ((uint64_t)proto << 32) | scancode;
+}
+
+struct keymap_entry {
+	uint64_t key;
+	uint32_t action;
+};
+
+struct keymap;
+
+/**
+ * keymap_build() - Bulk loads a table.
+ *
+ * A key given twice keeps the later action. Zero keys are skipped.
+ *
+ * @param *e    - entries
+ * @param n     - number of entries
+ *
+ * @return      - the table, NULL if out of memory
+ */
+struct keymap *keymap_build(const struct keymap_entry *e, size_t n);
+
+/**
+ * keymap_load() - Builds a table from a text export.
+ *
+ * One button per line, either a button hash or a protocol name and a
+ * scancode, then the action name. '#' starts a comment.
+ *
+ *     0x4A2C91F0       volume_up
+ *     NEC 0x04FB       power
+ *
+ * @param *path     - file to read
+ * @param *badline  - set to the first line that didn't parse, 0 otherwise
+ *
+ * @return          - the table, NULL if the file can't be read or parsed
+ */
+struct keymap *keymap_load(const char *path, int *badline);
+
+void keymap_free(struct keymap *km);
+
+/**
+ * keymap_lookup() - Finds the action for a key.
+ *
+ * @return      - the action, or KEYMAP_NO_ACTION
+ */
+uint32_t keymap_lookup(const struct keymap *km, uint64_t key);
+
+/**
+ * keymap_match() - Finds the action for a decoded frame, by protocol and
+ * scancode first and then by button hash.
+ *
+ * @return      - the action, or KEYMAP_NO_ACTION
+ */
+uint32_t keymap_match(const struct keymap *km, const struct ir_prot *d);
+
+/**
+ * keymap_action_name() - Name of an action in a table from keymap_load().
+ *
+ * @return      - the name, NULL for a built table or an unknown action
+ */
+const char *keymap_action_name(const struct keymap *km, uint32_t action);
+
+/**
+ * keymap_stats() - Shape of the table, for checking lookups stay short.
+ *
+ * @param *entries      - buttons mapped
+ * @param *slots        - table size
+ * @param *max_probe    - longest probe sequence, 1 if every button is in
+ *                        its home slot
+ */
+void keymap_stats(const struct keymap *km, size_t *entries, size_t *slots,
+		unsigned int *max_probe);
+
+/**
+ * struct keymap_live - the current keymap, swappable under readers
+ *
+ * Zero initialize. One thread publishes at a time.
+ */
+struct keymap_live {
+	struct keymap *cur;
+	int readers;
+
+	/* odd while the reader is between enter and exit */
+	struct {
+		uint64_t seq;
+		char _pad[64 - sizeof(uint64_t)];
+	} reader[KEYMAP_MAX_READERS];
+};
+
+/**
+ * keymap_reader_add() - Registers a reader thread, before it reads.
+ *
+ * @return      - the reader id, -1 if there are too many
+ */
+int keymap_reader_add(struct keymap_live *l);
+
+/**
+ * keymap_enter() - Starts a read, the table stays valid until keymap_exit().
+ *
+ * @return      - the current table, NULL if none has been published
+ */
+const struct keymap *keymap_enter(struct keymap_live *l, int id);
+
+void keymap_exit(struct keymap_live *l, int id);
+
+/**
+ * keymap_publish() - Makes @km current, waits out readers of the previous
+ * table and frees it. @km may be NULL to unpublish.
+ */
+void keymap_publish(struct keymap_live *l, struct keymap *km);
+
+#endif /* I__KEYMAP_H__ */
@@ -0,0 +1,224 @@
+/**
+ * COPYRIGHT 2024 Flirc, Inc. All rights reserved.
+ *
+ * This copyright notice is Copyright Management Information under 17 USC 1202
+ * and is included to protect this work and deter copyright infringement.
+ * Removal or alteration of this Copyright Management Information without
+ * the express written permission of Flirc, Inc. is prohibited, and any
+ * such unauthorized removal or alteration will be a violation of federal law.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include <ir/ir.h>
+
+#include "keytrack.h"
+
+#define NSEC_PER_MSEC		(1000000ull)
+
+void keytrack_init(struct keytrack *kt, const struct keytrack_cfg *cfg)
+{
+	static const struct keytrack_cfg defaults = KEYTRACK_DEFAULTS;
+
+	memset(kt, 0, sizeof(*kt));
+	kt->cfg = cfg ? *cfg : defaults;
+}
+
+static int emit(struct keytrack_event *ev, int n, enum keytrack_type type,
+		const struct keytrack_slot *s, uint64_t now)
+{
+	ev[n].type = type;
+	ev[n].protocol = s->protocol;
+	ev[n].scancode = s->scancode;
+	ev[n].hash = s->hash;
+	ev[n].count = s->count;
+	ev[n].held_ns = now - s->pressed;
+
+	return n + 1;
+}
+
+static int release(struct keytrack *kt, struct keytrack_slot *s, uint64_t now,
+		struct keytrack_event *ev, int n)
+{
+	n = emit(ev, n, KEY_RELEASE, s, now);
+
+	s->state = KEYTRACK_DEBOUNCE;
+	s->seen = now;
+	if (kt->last == s)
+		kt->last = NULL;
+
+	return n;
+}
+
+int keytrack_tick(struct keytrack *kt, uint64_t now,
+		struct keytrack_event *ev)
+{
+	const struct keytrack_cfg *c = &kt->cfg;
+	int i, n = 0;
+
+	if (now < kt->now)
+		now = kt->now;
+	kt->now = now;
+
+	for (i = 0; i < KEYTRACK_SLOTS; i++) {
+		struct keytrack_slot *s = &kt->slot[i];
+
+		switch (s->state) {
+		case KEYTRACK_HELD:
+			if (now - s->seen >= c->release * NSEC_PER_MSEC) {
+				n = release(kt, s, now, ev, n);
+			} else if (c->repeat && now >= s->next_repeat) {
+				s->count++;
+				n = emit(ev, n, KEY_HOLD, s, now);
+
+				/* a late tick gets one repeat, not a burst */
+				s->next_repeat += c->repeat * NSEC_PER_MSEC;
+				if (s->next_repeat <= now)
+					s->next_repeat = now +
+						c->repeat * NSEC_PER_MSEC;
+			}
+			break;
+		case KEYTRACK_DEBOUNCE:
+			if (now - s->seen >= c->debounce * NSEC_PER_MSEC)
+				s->state = KEYTRACK_FREE;
+			break;
+		case KEYTRACK_FREE:
+			break;
+		}
+	}
+
+	return n;
+}
+
+/* a free slot, else the one released longest ago, else the button heard
+ * from least recently, which is released to make room */
+static struct keytrack_slot *claim(struct keytrack *kt, uint64_t now,
+		struct keytrack_event *ev, int *n)
+{
+	struct keytrack_slot *debounce = NULL, *held = NULL;
+	int i;
+
+	for (i = 0; i < KEYTRACK_SLOTS; i++) {
+		struct keytrack_slot *s = &kt->slot[i];
+
+		if (s->state == KEYTRACK_FREE)
+			return s;
+		if (s->state == KEYTRACK_DEBOUNCE &&
+				(!debounce || s->seen < debounce->seen))
+			debounce = s;
+		if (s->state == KEYTRACK_HELD && (!held || s->seen < held->seen))
+			held = s;
+	}
+
+	if (debounce)
+		return debounce;
+
+	*n = release(kt, held, now, ev, *n);
+
+	return held;
+}
+
+int keytrack_frame(struct keytrack *kt, const struct ir_prot *d, uint64_t now,
+		struct keytrack_event *ev)
+{
+	struct keytrack_slot *s = NULL;
+	int i, n;
+
+	n = keytrack_tick(kt, now, ev);
+	now = kt->now;
+
+	if (d->protocol == RC_PROTO_UNKNOWN || d->protocol == RC_PROTO_INVALID)
+		return n;
+
+	/* a bare repeat frame carries no code, it's whatever was last held */
+	if (d->protocol == RC_PROTO_NEC_REPEAT) {
+		if (kt->last && kt->last->state == KEYTRACK_HELD)
+			kt->last->seen = now;
+		return n;
+	}
+
+	for (i = 0; i < KEYTRACK_SLOTS; i++) {
+		struct keytrack_slot *t = &kt->slot[i];
+
+		if (t->state != KEYTRACK_FREE && t->protocol == d->protocol &&
+				t->scancode == d->scancode) {
+			s = t;
+			break;
+		}
+	}
+
+	if (s && s->state == KEYTRACK_HELD) {
+		s->seen = now;
+		kt->last = s;
+		return n;
+	}
+
+	/* let go of and pressed again too quickly to be real */
+	if (s && s->state == KEYTRACK_DEBOUNCE)
+		return n;
+
+	/* one button at a time per remote, a new one means the old one is up */
+	for (i = 0; i < KEYTRACK_SLOTS; i++) {
+		struct keytrack_slot *t = &kt->slot[i];
+
+		if (t->state == KEYTRACK_HELD && t->protocol == d->protocol)
+			n = release(kt, t, now, ev, n);
+	}
+
+	s = claim(kt, now, ev, &n);
+	s->state = KEYTRACK_HELD;
+	s->protocol = d->protocol;
+	s->scancode = d->scancode;
+	s->hash = d->hash;
+	s->count = 0;
+	s->pressed = now;
+	s->seen = now;
+	s->next_repeat = now + kt->cfg.repeat_delay * NSEC_PER_MSEC;
+	kt->last = s;
+
+	return emit(ev, n, KEY_PRESS, s, now);
+}
+
+uint64_t keytrack_deadline(const struct keytrack *kt)
+{
+	const struct keytrack_cfg *c = &kt->cfg;
+	uint64_t next = 0, t;
+	int i;
+
+	for (i = 0; i < KEYTRACK_SLOTS; i++) {
+		const struct keytrack_slot *s = &kt->slot[i];
+
+		switch (s->state) {
+		case KEYTRACK_HELD:
+			t = s->seen + c->release * NSEC_PER_MSEC;
+			if (c->repeat && s->next_repeat < t)
+				t = s->next_repeat;
+			break;
+		case KEYTRACK_DEBOUNCE:
+			t = s->seen + c->debounce * NSEC_PER_MSEC;
+			break;
+		default:
+			continue;
+		}
+
+		if (!next || t < next)
+			next = t;
+	}
+
+	return next;
+}
+
+const char *keytrack_type_str(enum keytrack_type type)
+{
+	switch (type) {
+	case KEY_PRESS:
+		return "press";
+	case KEY_HOLD:
+		return "hold";
+	case KEY_RELEASE:
+		return "release";
+	}
+
+	return "?";
+}
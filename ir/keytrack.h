@@ -0,0 +1,150 @@
+/**
+ * COPYRIGHT 2024 Flirc, Inc. All rights reserved.
+ *
+ * This copyright notice is Copyright Management Information under 17 USC 1202
+ * and is included to protect this work and deter copyright infringement.
+ * Removal or alteration of this Copyright Management Information without
+ * the express written permission of Flirc, Inc. is prohibited, and any
+ * such unauthorized removal or alteration will be a violation of federal law.
+ */
+
+#ifndef I__KEYTRACK_H__
+#define I__KEYTRACK_H__
+
+#include <stdint.h>
+
+#include <ir/ir.h>
+
+/**
+ * Turns a stream of decoded frames into press, hold and release events.
+ *
+ * A remote keeps sending while a button is down, either the whole frame
+ * again or a short repeat frame (RC_PROTO_NEC_REPEAT), and simply stops when
+ * it's let go. So a button is pressed on its first frame and released when
+ * its frames stop for release_ms, or straight away when a different button
+ * on the same protocol shows up, since a remote only sends one at a time.
+ *
+ * Everything lives in struct keytrack, nothing is allocated, and each
+ * button being tracked is one fixed size slot. The caller supplies the time
+ * with each call, and calls keytrack_tick() when no frames arrive so
+ * releases and auto-repeats are still reported; keytrack_deadline() says
+ * when the next one is due.
+ */
+
+/* buttons tracked at once, held or inside their debounce window */
+#define KEYTRACK_SLOTS		(4)
+
+/* events a single call can produce: a hold and a release per slot, and a
+ * press */
+#define KEYTRACK_MAX_EVENTS	(2 * KEYTRACK_SLOTS + 1)
+
+/**
+ * struct keytrack_cfg - timings, all in milliseconds
+ *
+ * @release:        silence after which a held button is released, a bit
+ *                  more than the remote's repeat interval
+ * @debounce:       frames for a button this soon after its release are
+ *                  dropped rather than pressing it again
+ * @repeat_delay:   hold time before the first auto-repeat
+ * @repeat:         interval between auto-repeats, 0 for none
+ */
+struct keytrack_cfg {
+	unsigned int release;
+	unsigned int debounce;
+	unsigned int repeat_delay;
+	unsigned int repeat;
+};
+
+/* NEC repeats every 108 ms, RC5 and RC6 every 114 ms */
+#define KEYTRACK_DEFAULTS	{ 150, 60, 500, 100 }
+
+enum keytrack_type {
+	KEY_PRESS,
+	KEY_HOLD,
+	KEY_RELEASE,
+};
+
+/**
+ * struct keytrack_event
+ *
+ * @type:       what happened
+ * @protocol:   button's protocol
+ * @scancode:   button's scancode
+ * @hash:       button's libir hash
+ * @count:      auto-repeats so far, for KEY_HOLD and KEY_RELEASE
+ * @held_ns:    time since the press
+ */
+struct keytrack_event {
+	enum keytrack_type type;
+	enum rc_proto protocol;
+	uint32_t scancode;
+	uint32_t hash;
+	unsigned int count;
+	uint64_t held_ns;
+};
+
+struct keytrack_slot {
+	enum { KEYTRACK_FREE, KEYTRACK_HELD, KEYTRACK_DEBOUNCE } state;
+	enum rc_proto protocol;
+	uint32_t scancode;
+	uint32_t hash;
+	unsigned int count;
+	uint64_t pressed;
+	uint64_t seen;
+	uint64_t next_repeat;
+};
+
+struct keytrack {
+	struct keytrack_cfg cfg;
+	struct keytrack_slot slot[KEYTRACK_SLOTS];
+
+	/* slot last refreshed, what a bare repeat frame belongs to */
+	struct keytrack_slot *last;
+
+	/* latest time passed in, frames queued before a tick can arrive
+	 * with an earlier one */
+	uint64_t now;
+};
+
+/**
+ * keytrack_init() - Resets the tracker.
+ *
+ * @param *cfg  - timings, NULL for KEYTRACK_DEFAULTS
+ */
+void keytrack_init(struct keytrack *kt, const struct keytrack_cfg *cfg);
+
+/**
+ * keytrack_frame() - Feeds one decode result.
+ *
+ * Frames that didn't decode are ignored, apart from also ticking.
+ *
+ * @param *d    - what ir_decode_packet() returned
+ * @param now   - receive time, ns, from any monotonic clock
+ * @param *ev   - room for KEYTRACK_MAX_EVENTS events
+ *
+ * @return      - number of events written
+ */
+int keytrack_frame(struct keytrack *kt, const struct ir_prot *d, uint64_t now,
+		struct keytrack_event *ev);
+
+/**
+ * keytrack_tick() - Reports releases and auto-repeats that are due.
+ *
+ * @param now   - ns, same clock as keytrack_frame()
+ * @param *ev   - room for KEYTRACK_MAX_EVENTS events
+ *
+ * @return      - number of events written
+ */
+int keytrack_tick(struct keytrack *kt, uint64_t now,
+		struct keytrack_event *ev);
+
+/**
+ * keytrack_deadline() - When keytrack_tick() next has something to do.
+ *
+ * @return      - ns on the caller's clock, 0 if nothing is pending
+ */
+uint64_t keytrack_deadline(const struct keytrack *kt);
+
+const char *keytrack_type_str(enum keytrack_type type);
+
+#endif /* I__KEYTRACK_H__ */
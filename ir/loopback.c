@@ -0,0 +1,318 @@
+/**
+ * COPYRIGHT 2024 Flirc, Inc. All rights reserved.
+ *
+ * This copyright notice is Copyright Management Information under 17 USC 1202
+ * and is included to protect this work and deter copyright infringement.
+ * Removal or alteration of this Copyright Management Information without
+ * the express written permission of Flirc, Inc. is prohibited, and any
+ * such unauthorized removal or alteration will be a violation of federal law.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <ir/ir.h>
+
+#include <histogram.h>
+#include <monotime.h>
+
+#include "frame.h"
+#include "loopback.h"
+#include "noise.h"
+#include "ring.h"
+
+#define NSEC_PER_MSEC		(1000000ull)
+
+/* scancodes are used to match decoded frames back to their transmit,
+ * libir decodes a zero scancode as invalid so tags start at one */
+#define TEST_TAG_MASK		(0xFFFF)
+
+#define TEST_DEFAULT_FRAMES	(10000)
+#define TEST_DEFAULT_SEED	(0x1F1C)
+
+/* a record in the ring is due_ns, then the frame with only its edges */
+#define LOOPBACK_REC(n)		(sizeof(uint64_t) + IR_FRAME_SIZE(n))
+
+static inline struct ir_frame *rec_frame(uint64_t *due_ns)
+{
+	return (struct ir_frame *)(due_ns + 1);
+}
+
+/**
+ * The transmit side owns rng, last_ns and the sent, lost and overflow
+ * counters; the poll side owns received. The ring is the only thing they
+ * share.
+ */
+static struct {
+	struct spsc_vring ring;
+	struct loopback_cfg cfg;
+	uint64_t rng;
+	uint64_t last_ns;
+	struct loopback_stats st;
+	int open;
+} lb;
+
+int loopback_open(const struct loopback_cfg *cfg)
+{
+	if (lb.open)
+		loopback_close();
+
+	memset(&lb, 0, sizeof(lb));
+	if (cfg)
+		lb.cfg = *cfg;
+	lb.rng = lb.cfg.seed;
+
+	if (spsc_vring_init(&lb.ring, LOOPBACK_BYTES) < 0)
+		return -1;
+
+	lb.open = 1;
+
+	return 0;
+}
+
+void loopback_close(void)
+{
+	if (!lb.open)
+		return;
+
+	spsc_vring_free(&lb.ring);
+	lb.open = 0;
+}
+
+int loopback_tx(uint16_t *buf, uint16_t len, uint16_t ik, uint8_t repeat)
+{
+	struct ir_packet p;
+	uint64_t *due_ns;
+	uint64_t now = mono_now_ns();
+	uint64_t gap_ms;
+
+	(void)repeat;
+
+	if (len > NOISE_MAX_EDGES)
+		len = NOISE_MAX_EDGES;
+
+	/* the decoder uses the gap to spot repeats, never report less than
+	 * the inter key delay even if we're transmitting faster than that */
+	gap_ms = lb.last_ns ? (now - lb.last_ns) / NSEC_PER_MSEC : UINT16_MAX;
+	if (gap_ms < ik)
+		gap_ms = ik;
+	lb.last_ns = now;
+
+	lb.st.sent++;
+
+	if (noise_rng(&lb.rng) % 100 < lb.cfg.loss) {
+		lb.st.lost++;
+		return 0;
+	}
+
+	/* noise may add edges, so it's applied before the size is known */
+	memcpy(p.buf, buf, len * sizeof(buf[0]));
+	p.len = len;
+	p.elapsed = gap_ms > UINT16_MAX ? UINT16_MAX : (uint16_t)gap_ms;
+	noise_apply(&p, &lb.rng, &lb.cfg.noise);
+
+	due_ns = spsc_vring_claim(&lb.ring, LOOPBACK_REC(p.len));
+	if (due_ns == NULL) {
+		lb.st.overflow++;
+		return 0;
+	}
+
+	*due_ns = now + lb.cfg.latency_us * 1000ull;
+	ir_frame_pack(rec_frame(due_ns), &p);
+
+	spsc_vring_publish(&lb.ring);
+
+	return 0;
+}
+
+int loopback_poll(struct ir_packet *ir)
+{
+	uint64_t *due_ns;
+
+	if ((due_ns = spsc_vring_peek(&lb.ring, NULL)) == NULL)
+		return 0;
+
+	if (mono_now_ns() < *due_ns)
+		return 0;
+
+	ir_frame_unpack(rec_frame(due_ns), ir);
+	spsc_vring_release(&lb.ring);
+	lb.st.received++;
+
+	return 1;
+}
+
+unsigned int loopback_pending(void)
+{
+	return spsc_vring_count(&lb.ring);
+}
+
+int loopback_full(void)
+{
+	uint32_t used = __atomic_load_n(&lb.ring.head, __ATOMIC_ACQUIRE) -
+		__atomic_load_n(&lb.ring.tail, __ATOMIC_ACQUIRE);
+
+	/* the longest record, and what a wrap may skip before it */
+	return LOOPBACK_BYTES - used <
+		2 * VRING_REC(LOOPBACK_REC(NOISE_MAX_EDGES));
+}
+
+void loopback_get_stats(struct loopback_stats *st)
+{
+	*st = lb.st;
+}
+
+static unsigned long opt_value(const char *arg, const char *name)
+{
+	size_t n = strlen(name);
+
+	if (strncmp(arg, name, n) == 0 && arg[n] == '=')
+		return strtoul(&arg[n + 1], NULL, 0);
+
+	return (unsigned long)-1;
+}
+
+static void test_usage(void)
+{
+	printf("usage: ir loopback [--frames=N] [--rate=HZ] [--proto=NAME]\n"
+	       "                   [--jitter=PCT] [--bias=US] [--glitch=PCT]\n"
+	       "                   [--loss=PCT] [--latency=US] [--seed=N]\n");
+}
+
+/**
+ * Encodes scancode 1, 2, 3, ... into the loopback and decodes whatever
+ * comes out, on one thread since libir keeps its encoder and decoder state
+ * in static storage. ir_tx() isn't used, it sleeps out the frame after each
+ * transmit and would cap the test at a few frames a second. The scancode
+ * tags the frame so a decoded frame can be matched to its transmit time
+ * even with frames lost in between.
+ */
+int loopback_test(int argc, char *argv[])
+{
+	struct loopback_cfg cfg = {
+		{ 0, 0, 0 }, 0, 0, TEST_DEFAULT_SEED,
+	};
+	struct histogram lat = HISTOGRAM_INIT("tx->decode");
+	enum rc_proto proto = RC_PROTO_NEC;
+	unsigned long frames = TEST_DEFAULT_FRAMES, rate = 0, v;
+	uint64_t decoded = 0, wrong = 0, undecoded = 0, sent = 0;
+	uint64_t *txtime, t0, next_tx, now;
+	struct loopback_stats st;
+	struct ir_packet p;
+	struct ir_prot d;
+	int i;
+
+	for (i = 0; i < argc; i++) {
+		const char *a = argv[i];
+
+		if (strncmp(a, "--proto=", 8) == 0) {
+			proto = str_to_enum(&a[8]);
+		} else if ((v = opt_value(a, "--frames")) != -1ul) {
+			frames = v;
+		} else if ((v = opt_value(a, "--rate")) != -1ul) {
+			rate = v;
+		} else if ((v = opt_value(a, "--jitter")) != -1ul) {
+			cfg.noise.jitter = v;
+		} else if ((v = opt_value(a, "--bias")) != -1ul) {
+			cfg.noise.bias = v;
+		} else if ((v = opt_value(a, "--glitch")) != -1ul) {
+			cfg.noise.glitch = v;
+		} else if ((v = opt_value(a, "--loss")) != -1ul) {
+			cfg.loss = v;
+		} else if ((v = opt_value(a, "--latency")) != -1ul) {
+			cfg.latency_us = v;
+		} else if ((v = opt_value(a, "--seed")) != -1ul) {
+			cfg.seed = v;
+		} else {
+			test_usage();
+			return 1;
+		}
+	}
+
+	if ((txtime = calloc(TEST_TAG_MASK + 1, sizeof(*txtime))) == NULL ||
+			loopback_open(&cfg) < 0) {
+		printf("out of memory\n");
+		free(txtime);
+		return 1;
+	}
+
+	printf("loopback: %s, %lu frames, rate %lu/s, jitter %u%%, bias %u us, "
+			"glitch %u%%, loss %u%%, latency %u us\n",
+			enum_to_str(proto), frames, rate,
+			cfg.noise.jitter, cfg.noise.bias, cfg.noise.glitch,
+			cfg.loss, cfg.latency_us);
+
+	t0 = next_tx = mono_now_ns();
+
+	while (sent < frames || loopback_pending()) {
+		int busy = 0;
+
+		now = mono_now_ns();
+
+		/* keep headroom in the ring so nothing is lost to overflow */
+		if (sent < frames && now >= next_tx && !loopback_full()) {
+			uint32_t sc = sent % TEST_TAG_MASK + 1;
+			uint16_t buf[IR_FRAME_MAX / sizeof(uint16_t)];
+			struct ir_frame *tx = (struct ir_frame *)buf;
+
+			if (ir_frame_encode(proto, sc, tx, MAX_EDGES) < 0) {
+				printf("can't encode %s\n", enum_to_str(proto));
+				break;
+			}
+
+			txtime[sc] = now;
+			loopback_tx(tx->buf, tx->len, tx->elapsed, 0);
+			sent++;
+			busy = 1;
+
+			if (rate)
+				next_tx += 1000000000ull / rate;
+		}
+
+		while (loopback_poll(&p) == 1) {
+			enum rc_proto got = ir_decode_packet(&p, &d);
+			uint32_t tag = d.scancode & TEST_TAG_MASK;
+
+			busy = 1;
+			if (got == RC_PROTO_UNKNOWN || got == RC_PROTO_INVALID) {
+				undecoded++;
+			} else if (d.scancode <= TEST_TAG_MASK && txtime[tag]) {
+				hist_record(&lat, mono_now_ns() - txtime[tag]);
+				txtime[tag] = 0;
+				decoded++;
+			} else {
+				wrong++;
+			}
+		}
+
+		if (!busy)
+			mono_sleep_us(10);
+	}
+
+	now = mono_now_ns();
+	loopback_get_stats(&st);
+
+	printf("sent:        %llu\n", (unsigned long long)st.sent);
+	printf("lost:        %llu\n", (unsigned long long)st.lost);
+	printf("overflow:    %llu\n", (unsigned long long)st.overflow);
+	printf("received:    %llu\n", (unsigned long long)st.received);
+	printf("decoded:     %llu (%.2f%% of received)\n",
+			(unsigned long long)decoded,
+			st.received ? 100.0 * decoded / st.received : 0.0);
+	printf("wrong:       %llu\n", (unsigned long long)wrong);
+	printf("undecoded:   %llu\n", (unsigned long long)undecoded);
+	printf("throughput:  %.0f frames/sec\n\n",
+			st.sent * 1e9 / (double)(now - t0));
+
+	hist_print_header(stdout, "us");
+	hist_print(&lat, stdout, 1000.0);
+
+	loopback_close();
+	free(txtime);
+
+	return (wrong || undecoded) ? 1 : 0;
+}
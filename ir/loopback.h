@@ -0,0 +1,128 @@
+/**
+ * COPYRIGHT 2024 Flirc, Inc. All rights reserved.
+ *
+ * This copyright notice is Copyright Management Information under 17 USC 1202
+ * and is included to protect this work and deter copyright infringement.
+ * Removal or alteration of this Copyright Management Information without
+ * the express written permission of Flirc, Inc. is prohibited, and any
+ * such unauthorized removal or alteration will be a violation of federal law.
+ */
+
+#ifndef I__LOOPBACK_H__
+#define I__LOOPBACK_H__
+
+#include <stdint.h>
+
+#include <ir/ir.h>
+
+#include "noise.h"
+
+/**
+ * A software stand-in for a Flirc, for exercising the transmit, receive and
+ * decode path without hardware.
+ *
+ * loopback_tx() has the signature ir_register_tx() expects and
+ * loopback_poll() behaves like fl_ir_packet_poll(), so code written against
+ * the device can be pointed at the loopback unchanged. Every transmitted
+ * frame comes back out of the poll side after a delay, distorted the way a
+ * real receiver would distort it, unless it is lost on the way.
+ *
+ * One thread may transmit while another polls.
+ */
+
+/* bytes of frames in flight, power of two. frames take the edges they
+ * have, 1024 NEC frames at 160 bytes each rather than 528 */
+#define LOOPBACK_BYTES		(256 * 1024)
+
+/**
+ * struct loopback_cfg - how the virtual link behaves
+ *
+ * @noise:       distortion applied to each frame
+ * @loss:        percent of frames silently dropped
+ * @latency_us:  delay from transmit until the frame can be polled
+ * @seed:        random seed, the same seed replays the same distortion
+ */
+struct loopback_cfg {
+	struct ir_noise noise;
+	unsigned int loss;
+	unsigned int latency_us;
+	uint64_t seed;
+};
+
+/**
+ * struct loopback_stats - counters since loopback_open()
+ *
+ * @sent:       frames handed to loopback_tx()
+ * @lost:       frames dropped by the configured loss
+ * @overflow:   frames dropped because the poll side fell behind
+ * @received:   frames returned by loopback_poll()
+ */
+struct loopback_stats {
+	uint64_t sent;
+	uint64_t lost;
+	uint64_t overflow;
+	uint64_t received;
+};
+
+/**
+ * loopback_open() - Starts the virtual device.
+ *
+ * @param *cfg  - link behaviour, NULL for a perfect link
+ *
+ * @return      - 0 on success, -1 if out of memory
+ */
+int loopback_open(const struct loopback_cfg *cfg);
+
+/**
+ * loopback_close() - Stops the virtual device and drops frames in flight.
+ */
+void loopback_close(void);
+
+/**
+ * loopback_tx() - Transmit callback, see ir_register_tx().
+ *
+ * Queues one frame. Its elapsed time is the gap since the previous
+ * transmit, but never less than @ik. @repeat is accepted for the callback
+ * signature and otherwise ignored, ir_tx() sends repeat frames itself.
+ *
+ * @return      - 0, a lost frame is not an error to the transmitter
+ */
+int loopback_tx(uint16_t *buf, uint16_t len, uint16_t ik, uint8_t repeat);
+
+/**
+ * loopback_poll() - Receive side, same contract as fl_ir_packet_poll().
+ *
+ * @return 0    - no frame is due yet
+ * @return 1    - frame copied to @ir
+ */
+int loopback_poll(struct ir_packet *ir);
+
+/**
+ * loopback_pending() - Frames queued but not polled yet.
+ */
+unsigned int loopback_pending(void);
+
+/**
+ * loopback_full() - Whether a frame of the longest might not fit, for a
+ * transmitter wanting no overflow.
+ */
+int loopback_full(void);
+
+/**
+ * loopback_get_stats() - Copies out the counters.
+ */
+void loopback_get_stats(struct loopback_stats *st);
+
+/**
+ * loopback_test() - Entry point for `ir loopback`, a transmit to decode
+ * load test over the virtual device.
+ *
+ * usage: ir loopback [--frames=N] [--rate=HZ] [--proto=NAME] [--jitter=PCT]
+ *                    [--bias=US] [--glitch=PCT] [--loss=PCT]
+ *                    [--latency=US] [--seed=N]
+ *
+ * @return      - 0 if every frame that wasn't lost decoded correctly
+ */
+int loopback_test(int argc, char *argv[]);
+
+#endif /* I__LOOPBACK_H__ */
@@ -8,16 +8,35 @@
  * such unauthorized removal or alteration will be a violation of federal law.
  */
 
+#define _POSIX_C_SOURCE 200809L
+
 #include <stdio.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 #include <signal.h>
+#include <time.h>
+#include <pthread.h>
 
 #include <flirc/flirc.h>
 #include <ir/ir.h>
 
+#include <histogram.h>
+#include <monotime.h>
+#include <tx_stats.h>
+
+#include "candidate.h"
+#include "cluster.h"
+#include "decode_file.h"
+#include "frame.h"
+#include "keymap.h"
+#include "keytrack.h"
+#include "loopback.h"
+#include "pool.h"
+#include "ring.h"
+#include "segment.h"
+
 #ifndef FRAME
 #define FRAME			(1)
 #endif
@@ -45,6 +64,104 @@ void ex_program(int sig)
 	exit(1);
 }
 
+/* worst case for one frame: header plus raw, pronto and cleaned lines */
+#define FRAME_TEXT_MAX		(8 * 1024)
+
+/* frames buffered between the capture and format threads, power of two */
+#define LISTEN_RING_SLOTS	(256)
+
+/* a full ring each for the output and record threads, plus the one being
+ * polled into and the one each thread is working on */
+#define LISTEN_POOL_FRAMES	(2 * LISTEN_RING_SLOTS + 3)
+
+/* decode candidates shown per frame */
+#define LISTEN_CANDIDATES	(3)
+
+/**
+ * Formatting helpers. A frame is printed as roughly 800 numbers; doing that
+ * with one printf per number is slow enough that a slow terminal or pipe
+ * stalls the poll loop. These render straight into a buffer which is then
+ * written out in one go.
+ */
+static char *fmt_uint(char *p, unsigned int v)
+{
+	char tmp[10];
+	int n = 0;
+
+	do {
+		tmp[n++] = '0' + (v % 10);
+		v /= 10;
+	} while (v);
+
+	while (n)
+		*p++ = tmp[--n];
+
+	return p;
+}
+
+static char *fmt_hex4(char *p, uint16_t v)
+{
+	static const char hex[] = "0123456789ABCDEF";
+
+	*p++ = hex[(v >> 12) & 0xF];
+	*p++ = hex[(v >> 8) & 0xF];
+	*p++ = hex[(v >> 4) & 0xF];
+	*p++ = hex[v & 0xF];
+
+	return p;
+}
+
+/* "+9000 -4500 +560 ...\n" */
+static char *fmt_edges(char *p, const uint16_t *buf, int len)
+{
+	int i;
+
+	for (i = 0; i < len; i++) {
+		*p++ = IS_EVEN(i) ? '+' : '-';
+		p = fmt_uint(p, buf[i]);
+		*p++ = ' ';
+	}
+	*p++ = '\n';
+
+	return p;
+}
+
+/* "0000 006D 0022 ...\n" */
+static char *fmt_pronto(char *p, const uint16_t *buf, int len)
+{
+	int i;
+
+	for (i = 0; i < len; i++) {
+		p = fmt_hex4(p, buf[i]);
+		*p++ = ' ';
+	}
+	*p++ = '\n';
+
+	return p;
+}
+
+/* "candidates: NEC 12/140 96%, SAMSUNG32 ...\n", rms and worst error */
+static char *fmt_candidates(char *p, const struct candidate *c, int n)
+{
+	int i;
+
+	p += sprintf(p, "candidates:");
+	for (i = 0; i < n; i++)
+		p += sprintf(p, "%s %s%s %u/%u %u%%", i ? "," : "",
+				c[i].name, c[i].decoded ? "*" : "",
+				c[i].error, c[i].worst, c[i].confidence);
+	if (!n)
+		p += sprintf(p, " none");
+	*p++ = '\n';
+
+	return p;
+}
+
+static void write_out(const char *buf, const char *end)
+{
+	fwrite(buf, 1, end - buf, stdout);
+}
+
 /**
  * All IR Captures have some loss. Edges are not clean, light bounces .The 
  * timing markers will vary for each signal captured, even if it's the same
@@ -57,17 +174,13 @@ void ex_program(int sig)
  */
 static void print_cleaned(struct ir_prot *p)
 {
-	int i;
+	char buf[FRAME_TEXT_MAX];
 
 #ifdef PRINT_ELAPSED
 	printf("+%d\n", p->elapsed*1000);
 #endif
 
-	for (i = 0; i < p->len; i++) {
-		IS_EVEN(i) ? printf("+") : printf("-");
-		printf("%d ", p->buf[i]);
-	}
-	printf("\n");
+	write_out(buf, fmt_edges(buf, p->buf, p->len));
 }
 
 /**
@@ -82,16 +195,13 @@ static void print_cleaned(struct ir_prot *p)
  */
 static void print_pronto(struct ir_prot *p)
 {
-	int i;
+	char buf[FRAME_TEXT_MAX];
 
 #ifdef PRINT_ELAPSED
 	printf("+%d\n", p->elapsed*1000);
 #endif
 
-	for (i = 0; i < p->pronto_len; i++) {
-		printf("%04X ", p->pronto[i]);
-	}
-	printf("\n");
+	write_out(buf, fmt_pronto(buf, p->pronto, p->pronto_len));
 }
 
 /**
@@ -100,60 +210,572 @@ static void print_pronto(struct ir_prot *p)
  */
 static void print_raw(struct ir_packet *p)
 {
-	int i;
+	char buf[FRAME_TEXT_MAX];
 
 #ifdef PRINT_ELAPSED
 	printf("+%d\n", p->elapsed*1000);
 #endif
 
-	for (i = 0; i < p->len; i++) {
-		IS_EVEN(i) ? printf("+") : printf("-");
-		printf("%d ", p->buf[i]);
+	write_out(buf, fmt_edges(buf, p->buf, p->len));
+}
+
+/**
+ * Listening is split in two so that printing can never make us miss a frame.
+ * The main thread only polls the device and drops each frame straight into a
+ * lock-free ring. A second thread takes frames off the ring, decodes them and
+ * renders the whole report into one buffer which goes out in a single write.
+ *
+ * If the output falls far enough behind that the ring fills up, frames are
+ * dropped at capture time and counted; the totals are shown on exit.
+ *
+ * Every frame is also timed through each stage of the receive path, and the
+ * latency distribution of each stage is printed on exit:
+ *
+ *   poll    - the fl_ir_packet_poll() call that returned the frame, i.e. the
+ *             usb transfer and the library's handling of it
+ *   queue   - poll returning to the output thread picking the frame up
+ *   decode  - ir_decode_packet()
+ *   action  - what the application does with the result, here rendering
+ *             and writing the report
+ *   total   - poll returning to the action completing
+ *
+ * `ir stats` runs the same pipeline without printing frames, so the numbers
+ * aren't dominated by the terminal.
+ *
+ * With --keymap=<file> the action is also looking the button up in a keymap
+ * (keymap.h) and printing what it maps to. SIGHUP reloads the file; the
+ * capture thread swaps the new table in while the output thread carries on
+ * reading without a lock.
+ *
+ * A packet holding several frames back to back, a repeat that followed too
+ * closely or a second remote, is split at the gaps between them (segment.h)
+ * and each frame is decoded and acted on in turn.
+ *
+ * Each printed frame also lists the likely protocols (candidate.h) with
+ * their rms and worst edge timing error in permille and a confidence, the
+ * one libir decoded marked with a '*'.
+ *
+ * Frames come out of a pool (pool.h) and the ring carries pointers to them.
+ * With --record=<file> the same frame is also queued to a third thread that
+ * appends it to a binary capture (decode_file.h), each thread holding a
+ * reference rather than a copy, and the frame goes back to the pool once
+ * both are done with it. A recorder that falls behind loses frames from the
+ * capture, never from the output.
+ *
+ * `ir keys` runs it quietly too, but feeds every decode result to a held key
+ * tracker (keytrack.h) and prints the press, hold and release events.
+ *
+ * `ir learn` is for remotes libir doesn't know. Every frame that decodes as
+ * RC_PROTO_UNKNOWN goes to a cluster set (cluster.h), so pressing each
+ * button a few times is enough to learn them all, and a canonical frame
+ * for each is printed on exit.
+ */
+struct listen_frame {
+	struct ir_packet p;
+	uint64_t rx_ns;
+};
+
+struct listen_state {
+	struct pool *frames;
+	struct spsc_ring ring;
+	volatile sig_atomic_t stop;
+	int quiet;
+	uint64_t captured;
+	uint64_t dropped;
+	uint64_t printed;
+	uint64_t recovered;
+	uint64_t poll_errors;
+
+	/* written by the capture thread, read by the output thread */
+	struct keymap_live keymap;
+	const char *keymap_path;
+	int keymap_reader;
+	volatile sig_atomic_t reload;
+	uint64_t mapped;
+
+	/* the capture thread queues, the record thread writes */
+	struct spsc_ring record_ring;
+	FILE *record;
+	uint64_t recorded;
+	uint64_t record_dropped;
+	int record_errors;
+
+	/* output thread only */
+	int keys;
+	struct keytrack keytrack;
+	struct cluster_set *clusters;
+
+	/* the poll histogram is written by the capture thread, the rest by
+	 * the output thread; only read once both are done */
+	struct histogram poll;
+	struct histogram queue;
+	struct histogram decode;
+	struct histogram action;
+	struct histogram total;
+};
+
+static struct listen_state listener = {
+	.poll	= HISTOGRAM_INIT("rx.poll"),
+	.queue	= HISTOGRAM_INIT("rx.queue"),
+	.decode	= HISTOGRAM_INIT("rx.decode"),
+	.action	= HISTOGRAM_INIT("rx.action"),
+	.total	= HISTOGRAM_INIT("rx.total"),
+};
+
+static void stop_listen(int sig)
+{
+	listener.stop = 1;
+}
+
+static void reload_keymap(int sig)
+{
+	listener.reload = 1;
+}
+
+static int load_keymap(struct listen_state *ls)
+{
+	struct keymap *km;
+	size_t entries, slots;
+	unsigned int probe;
+	int badline;
+
+	if ((km = keymap_load(ls->keymap_path, &badline)) == NULL) {
+		if (badline)
+			printf("%s:%d: expected <hash> or <protocol> "
+					"<scancode>, then an action\n",
+					ls->keymap_path, badline);
+		else
+			printf("unable to read %s\n", ls->keymap_path);
+		return -1;
+	}
+
+	keymap_stats(km, &entries, &slots, &probe);
+	printf("keymap %s: %zu buttons, %zu slots, longest probe %u\n",
+			ls->keymap_path, entries, slots, probe);
+
+	keymap_publish(&ls->keymap, km);
+
+	return 0;
+}
+
+/* looks the button up, the name is copied out since the table can be
+ * swapped as soon as we leave it */
+static int dispatch(struct listen_state *ls, struct ir_prot *d,
+		char *action, size_t size)
+{
+	const struct keymap *km;
+	const char *name = NULL;
+	uint32_t a;
+
+	km = keymap_enter(&ls->keymap, ls->keymap_reader);
+	if (km && (a = keymap_match(km, d)) != KEYMAP_NO_ACTION)
+		name = keymap_action_name(km, a);
+	if (name)
+		snprintf(action, size, "%s", name);
+	keymap_exit(&ls->keymap, ls->keymap_reader);
+
+	if (!name)
+		return 0;
+
+	ls->mapped++;
+
+	return 1;
+}
+
+static void print_keys(const struct keytrack_event *ev, int n,
+		const char *action)
+{
+	int i;
+
+	for (i = 0; i < n; i++) {
+		const struct keytrack_event *e = &ev[i];
+
+		printf("%-7s %s 0x%08X", keytrack_type_str(e->type),
+				enum_to_str(e->protocol), e->scancode);
+		if (e->type != KEY_PRESS)
+			printf(" after %llu ms, %u repeats",
+					(unsigned long long)e->held_ns / 1000000,
+					e->count);
+		else if (action)
+			printf(" %s", action);
+		printf("\n");
+	}
+
+	if (n)
+		fflush(stdout);
+}
+
+static void learn_frame(struct listen_state *ls, const struct ir_packet *p)
+{
+	int id, created;
+
+	id = cluster_add(ls->clusters, p->buf, p->len, p->elapsed, &created);
+	if (created) {
+		printf("new button #%d, %u edges\n", id, p->len);
+		fflush(stdout);
 	}
-	printf("\n");
 }
 
-static void _listen(void) __attribute__ ((noreturn));
-static void _listen(void)
+static void *listen_output(void *arg)
 {
+	struct listen_state *ls = arg;
+	static char out[FRAME_TEXT_MAX];
+	struct timespec idle = { 0, 500 * 1000 };
+	struct listen_frame **slot, *f;
+	struct segment seg[SEGMENT_MAX];
+	struct ir_packet *p, *q, sub;
 	struct ir_prot d;
-	struct ir_packet p;
+	uint64_t rx, t0, t1, t2;
+	struct keytrack_event ev[KEYTRACK_MAX_EVENTS];
+	struct candidate cand[LISTEN_CANDIDATES];
+	char action[64];
+	int mapped, ncand = 0, nseg, i;
+
+	while (1) {
+		if ((slot = spsc_ring_peek(&ls->ring)) == NULL) {
+			/* drain everything that was captured before quitting */
+			if (ls->stop)
+				break;
+			/* releases are noticed by the absence of frames */
+			if (ls->keys)
+				print_keys(ev, keytrack_tick(&ls->keytrack,
+							mono_now_ns(), ev), NULL);
+			nanosleep(&idle, NULL);
+			continue;
+		}
+		f = *slot;
+		spsc_ring_release(&ls->ring);
+		p = &f->p;
+		rx = f->rx_ns;
+
+		/* frames that arrived back to back are handled one by one */
+		nseg = segment_split(p->buf, p->len, seg, SEGMENT_MAX);
+		ls->recovered += nseg > 1 ? nseg - 1 : 0;
+
+		for (i = 0; i < nseg; i++) {
+			char *o = out;
+			int last = i == nseg - 1;
+
+			q = segment_packet(p, &seg[i], &sub);
+
+			/* the quiet modes time the decode alone */
+			t0 = mono_now_ns();
+			if (ls->quiet)
+				ir_decode_packet(q, &d);
+			else
+				ncand = candidate_decode(q, &d, cand,
+						LISTEN_CANDIDATES);
+			t1 = mono_now_ns();
+
+			if (i == 0)
+				hist_record(&ls->queue, t0 - rx);
+			hist_record(&ls->decode, t1 - t0);
+
+			mapped = ls->keymap_path &&
+				dispatch(ls, &d, action, sizeof(action));
+
+			if (ls->keys)
+				print_keys(ev, keytrack_frame(&ls->keytrack,
+							&d, rx, ev),
+						mapped ? action : NULL);
+
+			if (ls->clusters && d.protocol == RC_PROTO_UNKNOWN)
+				learn_frame(ls, q);
+
+			if (ls->quiet) {
+				if (last)
+					pool_put(ls->frames, f);
+				t2 = mono_now_ns();
+				if (ls->keymap_path || ls->clusters)
+					hist_record(&ls->action, t2 - t1);
+				if (last)
+					hist_record(&ls->total, t2 - rx);
+				continue;
+			}
+
+			o += snprintf(o, 256, "----------------\n"
+					"0x%08X - %s : %d : hash: 0x%08X\n",
+					d.scancode, d.desc, d.protocol, d.hash);
+			if (nseg > 1)
+				o += snprintf(o, 64, "frame %d of %d\n",
+						i + 1, nseg);
+			if (mapped)
+				o += snprintf(o, 128, "action: %s\n", action);
+			o = fmt_candidates(o, cand, ncand);
+			/* the timing we received */
+			o = fmt_edges(o, q->buf, q->len);
+
+			/* done with the raw frame, let the capture side
+			 * reuse it */
+			if (last)
+				pool_put(ls->frames, f);
+
+			/* the pronto version of what we received */
+			o = fmt_pronto(o, d.pronto, d.pronto_len);
+			/* an idealized waveform based on protocol */
+			o = fmt_edges(o, d.buf, d.len);
+			memcpy(o, "----------------\n", 17);
+			o += 17;
+
+			write_out(out, o);
+			fflush(stdout);
+			ls->printed++;
+
+			t2 = mono_now_ns();
+			hist_record(&ls->action, t2 - t1);
+			if (last)
+				hist_record(&ls->total, t2 - rx);
+		}
+	}
+
+	return NULL;
+}
+
+static void *listen_record(void *arg)
+{
+	struct listen_state *ls = arg;
+	struct timespec idle = { 0, 1000 * 1000 };
+	uint16_t buf[IR_FRAME_MAX / sizeof(uint16_t)];
+	struct ir_frame *rec = (struct ir_frame *)buf;
+	struct listen_frame **slot, *f;
+
+	while (1) {
+		if ((slot = spsc_ring_peek(&ls->record_ring)) == NULL) {
+			if (ls->stop)
+				break;
+			nanosleep(&idle, NULL);
+			continue;
+		}
+		f = *slot;
+		spsc_ring_release(&ls->record_ring);
+
+		/* the frame goes back to the pool before the write blocks */
+		ir_frame_pack(rec, &f->p);
+		pool_put(ls->frames, f);
+
+		if (ir_frame_write(ls->record, rec) < 0)
+			ls->record_errors++;
+		else
+			ls->recorded++;
+	}
+
+	return NULL;
+}
+
+/**
+ * listen_queue() - Hands a captured frame to the output thread, and the
+ * record thread if there is one, each with its own reference.
+ */
+static void listen_queue(struct listen_state *ls, struct listen_frame *f)
+{
+	struct listen_frame **slot;
+
+	if (ls->record) {
+		if ((slot = spsc_ring_claim(&ls->record_ring)) != NULL) {
+			pool_ref(ls->frames, f);
+			*slot = f;
+			spsc_ring_publish(&ls->record_ring);
+		} else {
+			ls->record_dropped++;
+		}
+	}
+
+	if ((slot = spsc_ring_claim(&ls->ring)) == NULL) {
+		ls->dropped++;
+		pool_put(ls->frames, f);
+		return;
+	}
+	*slot = f;
+	spsc_ring_publish(&ls->ring);
+}
+
+static void _listen(int quiet, int keys, int learn, const char *keymap,
+		const char *record) __attribute__ ((noreturn));
+static void _listen(int quiet, int keys, int learn, const char *keymap,
+		const char *record)
+{
+	struct listen_state *ls = &listener;
+	struct listen_frame scratch;
+	struct listen_frame *f = NULL;
+	uint64_t t0, t1;
+	pthread_t output, recorder;
+
+	ls->quiet = quiet;
+	ls->keys = keys;
+	keytrack_init(&ls->keytrack, NULL);
+
+	if (learn && (ls->clusters = cluster_new(NULL)) == NULL) {
+		printf("unable to allocate clusters\n");
+		ex_program(0);
+	}
+
+	if (keymap) {
+		ls->keymap_path = keymap;
+		ls->keymap_reader = keymap_reader_add(&ls->keymap);
+		if (load_keymap(ls) < 0)
+			ex_program(0);
+#ifdef SIGHUP
+		(void) signal(SIGHUP, reload_keymap);
+#endif
+	}
+
+	hist_register(&ls->poll);
+	hist_register(&ls->queue);
+	hist_register(&ls->decode);
+	hist_register(&ls->action);
+	hist_register(&ls->total);
+
+	if ((ls->frames = pool_new(sizeof(struct listen_frame),
+					LISTEN_POOL_FRAMES)) == NULL ||
+			spsc_ring_init(&ls->ring, LISTEN_RING_SLOTS,
+				sizeof(struct listen_frame *)) < 0) {
+		printf("unable to allocate capture ring\n");
+		ex_program(0);
+	}
+
+	if (record) {
+		if ((ls->record = ir_capture_create(record)) == NULL)
+			ex_program(0);
+		if (spsc_ring_init(&ls->record_ring, LISTEN_RING_SLOTS,
+					sizeof(struct listen_frame *)) < 0) {
+			printf("unable to allocate record ring\n");
+			ex_program(0);
+		}
+		if (pthread_create(&recorder, NULL, listen_record, ls) != 0) {
+			printf("unable to start record thread\n");
+			ex_program(0);
+		}
+	}
+
+	if (pthread_create(&output, NULL, listen_output, ls) != 0) {
+		printf("unable to start output thread\n");
+		ex_program(0);
+	}
+
+	/* quit through the normal path so we can report and drain */
+	(void) signal(SIGINT, stop_listen);
+
+	if (keys)
+		printf("press buttons, Ctrl-C to quit\n");
+	else if (learn)
+		printf("press each button a few times, Ctrl-C when done\n");
+	else if (quiet)
+		printf("collecting receive latencies, Ctrl-C to report\n");
 
 	/**
 	 * Stay here and poll the device. Once a complete packet is
-	 * received, decode and print, and repeat. User must force
+	 * received, hand it off and poll again. User must force
 	 * quit the app
 	 */
-	while (1) {
-		switch (fl_ir_packet_poll(&p)) {
+	while (!ls->stop) {
+		/* a bad file keeps the keymap we have */
+		if (ls->reload) {
+			ls->reload = 0;
+			load_keymap(ls);
+		}
+
+		/* poll straight into a pooled frame, or somewhere harmless if
+		 * every one is still held */
+		if (f == NULL && (f = pool_get(ls->frames)) == NULL)
+			f = &scratch;
+
+		t0 = mono_now_ns();
+		switch (fl_ir_packet_poll(&f->p)) {
 		/**
-		 * Packet received, print useful info and poll again
+		 * Packet received, queue it for decode and poll again
 		 */
 		case (FRAME):
-			printf("----------------\n");
-			ir_decode_packet(&p, &d);
-
-			printf("0x%08X - %s : %d : hash: 0x%08X\n",
-					d.scancode, d.desc, d.protocol, d.hash);
-			/* print the timing we received */
-			print_raw(&p);
-			/* the pronto version of what we received */
-			print_pronto(&d);
-			/* an idealized waveform based on protocol */
-			print_cleaned(&d);
-			printf("----------------\n");
-			fflush(stdout);
+			t1 = mono_now_ns();
+			hist_record(&ls->poll, t1 - t0);
+			f->rx_ns = t1;
+			ls->captured++;
+			if (f == &scratch)
+				ls->dropped++;
+			else
+				listen_queue(ls, f);
+			f = NULL;
 			break;
 		case (NOFRAME):
 			break;
 		case (-1):
+			ls->poll_errors++;
 			printf("error, disconnecting\n");
 			break;
 		default:
+			ls->poll_errors++;
 			printf("UNKNOWN ERROR\n");
 			break;
 		}
 	}
+
+	if (f && f != &scratch)
+		pool_put(ls->frames, f);
+
+	pthread_join(output, NULL);
+	spsc_ring_free(&ls->ring);
+	keymap_publish(&ls->keymap, NULL);
+
+	if (ls->record) {
+		pthread_join(recorder, NULL);
+		spsc_ring_free(&ls->record_ring);
+		if (fclose(ls->record) != 0)
+			ls->record_errors++;
+	}
+
+	printf("\n");
+	printf("frames captured: %llu\n", (unsigned long long)ls->captured);
+	printf("frames printed:  %llu\n", (unsigned long long)ls->printed);
+	printf("frames dropped:  %llu\n", (unsigned long long)ls->dropped);
+	printf("frames split:    %llu\n", (unsigned long long)ls->recovered);
+	if (ls->keymap_path)
+		printf("frames mapped:   %llu\n",
+				(unsigned long long)ls->mapped);
+	printf("poll errors:     %llu\n", (unsigned long long)ls->poll_errors);
+	if (ls->record) {
+		printf("frames recorded: %llu to %s\n",
+				(unsigned long long)ls->recorded, record);
+		printf("record dropped:  %llu\n",
+				(unsigned long long)ls->record_dropped);
+		if (ls->record_errors)
+			printf("record errors:   %d\n", ls->record_errors);
+	}
+
+	if (ls->clusters) {
+		printf("\nbuttons seen more than once:\n");
+		if (!cluster_print(ls->clusters, stdout, 2))
+			printf("none\n");
+		cluster_free(ls->clusters);
+	}
+
+	if (ls->captured) {
+		printf("\n");
+		hist_print_all(stdout, "us", 1000.0);
+	}
+
+	ex_program(0);
+}
+
+/**
+ * ir_tx() encodes and then calls the registered transmit function. Noting
+ * when ir_tx() was entered lets the callback split the time between the two.
+ */
+static uint64_t tx_start;
+
+static int tx_timed(uint16_t *buf, uint16_t len, uint16_t ik, uint8_t repeat)
+{
+	tx_stats_encode(mono_now_ns() - tx_start);
+	return tx_raw(buf, len, ik, repeat);
+}
+
+static void transmit(enum rc_proto protocol, uint32_t scancode, uint8_t repeat)
+{
+	tx_start = mono_now_ns();
+	ir_tx(protocol, scancode, repeat);
+
+	if (tx_stats_print(stdout)) {
+		printf("\n");
+		hist_print_all(stdout, "us", 1000.0);
+	}
 }
 
 /**
@@ -193,18 +815,31 @@ static void retransmit(void)
 
 	/* ensure we flush the interface of pending packets */
 	fl_dev_flush();
-	ir_tx(d.protocol, d.scancode, 1);
+	transmit(d.protocol, d.scancode, 1);
 }
 
 static void usage(void)
 {
 	printf("usage:\n");
-	printf("ir listen\n");
+	printf("ir listen [--keymap=<file>] [--record=<file>]\n");
 	printf("     - This will poll the device, decode, and print the results\n");
+	printf("     - --record also writes every frame to a capture for decode-file\n");
 	printf("ir transmit\n");
 	printf("     - Specify Protocol and Scancode; NEC32 0x37511\n");
 	printf("ir retransmit\n");
 	printf("     - This will wait for a packet, decode, and retransmit the packet\n");
+	printf("ir stats [--keymap=<file>] [--record=<file>]\n");
+	printf("     - Time each stage of the receive path and print percentiles on Ctrl-C\n");
+	printf("ir keys [--keymap=<file>]\n");
+	printf("     - Print press, hold and release events as buttons are used\n");
+	printf("ir learn\n");
+	printf("     - Group frames that don't decode by button and print one averaged frame each\n");
+	printf("ir learn [--tol=N] [--min=N] [--all] <capture>\n");
+	printf("     - The same over a capture file, no device needed\n");
+	printf("ir decode-file [--workers=N] [--csv|--json] <capture>\n");
+	printf("     - Decode a capture corpus offline and print a protocol histogram\n");
+	printf("ir loopback [--frames=N] [--rate=HZ] [--proto=NAME] [--loss=PCT] ...\n");
+	printf("     - Transmit and decode through a virtual device, no hardware needed\n");
 
 }
 
@@ -235,7 +870,11 @@ static void decode_raw(const char *line)
 	int i = 0;
 
 	struct ir_prot d;
-	struct ir_packet p;
+	struct ir_packet p, sub, *q;
+	struct candidate cand[CANDIDATE_MAX];
+	struct segment seg[SEGMENT_MAX];
+	char out[512];
+	int n, nseg;
 
 	memset(buf, 0, sizeof(buf[0]) * ARRAY_SIZE(buf));
 
@@ -265,16 +904,26 @@ static void decode_raw(const char *line)
 
 	print_raw(&p);
 
-	/* decode packet received */
-	ir_decode_packet(&p, &d);
-	printf("0x%08X - %s : %d\n", d.scancode, d.desc, d.protocol);
-	printf("%s\n", enum_to_str(d.protocol));
-	/* print the timing we received */
-	print_raw(&p);
-	/* the pronto version of what we received */
-	print_pronto(&d);
-	/* an idealized waveform based on protocol */
-	print_cleaned(&d);
+	nseg = segment_split(p.buf, p.len, seg, SEGMENT_MAX);
+
+	for (i = 0; i < nseg; i++) {
+		q = segment_packet(&p, &seg[i], &sub);
+
+		if (nseg > 1)
+			printf("frame %d of %d\n", i + 1, nseg);
+
+		/* decode packet received, and what else it could have been */
+		n = candidate_decode(q, &d, cand, CANDIDATE_MAX);
+		printf("0x%08X - %s : %d\n", d.scancode, d.desc, d.protocol);
+		printf("%s\n", enum_to_str(d.protocol));
+		write_out(out, fmt_candidates(out, cand, n));
+		/* print the timing we received */
+		print_raw(q);
+		/* the pronto version of what we received */
+		print_pronto(&d);
+		/* an idealized waveform based on protocol */
+		print_cleaned(&d);
+	}
 }
 
 static int fl_transmit_fake(uint16_t *buf, uint16_t len, uint16_t ik, uint8_t repeat)
@@ -293,6 +942,14 @@ static int fl_transmit_fake(uint16_t *buf, uint16_t len, uint16_t ik, uint8_t re
 
 int main(int argc, char *argv[])
 {
+	/* offline decoding doesn't need a device, keep stdout clean for csv */
+	if (argc > 1 && strcmp(argv[1], "decode-file") == 0)
+		return decode_file(argc - 2, &argv[2]);
+	if (argc > 1 && strcmp(argv[1], "loopback") == 0)
+		return loopback_test(argc - 2, &argv[2]);
+	if (argc > 2 && strcmp(argv[1], "learn") == 0)
+		return learn_file(argc - 2, &argv[2]);
+
 	/* catch our control-C so we can cleanly exit and close the device */
 	(void) signal(SIGINT, ex_program);
 
@@ -316,13 +973,29 @@ int main(int argc, char *argv[])
 		 * Only necessary if you want to transmit. Purpose of libir is to
 		 * support any transmitter.
 		 */
-		ir_register_tx(fl_transmit_raw);
+		ir_register_tx(tx_timed);
 	}
 
 	/* check for argument */
 	if (argc > 1) {
+		const char *keymap = NULL, *record = NULL;
+		int i;
+
+		for (i = 2; i < argc; i++) {
+			if (strncmp(argv[i], "--keymap=", 9) == 0)
+				keymap = &argv[i][9];
+			else if (strncmp(argv[i], "--record=", 9) == 0)
+				record = &argv[i][9];
+		}
+
 		if (strcmp(argv[1], "listen") == 0) {
-			_listen();
+			_listen(0, 0, 0, keymap, record);
+		} else if (strcmp(argv[1], "stats") == 0) {
+			_listen(1, 0, 0, keymap, record);
+		} else if (strcmp(argv[1], "keys") == 0) {
+			_listen(1, 1, 0, keymap, record);
+		} else if (strcmp(argv[1], "learn") == 0) {
+			_listen(1, 0, 1, NULL, NULL);
 		} else if (strcmp(argv[1], "transmit") == 0) {
 			if (argc < 3) {
 				printf("invalid arguments\n");
@@ -331,7 +1004,7 @@ int main(int argc, char *argv[])
 			}
 			enum rc_proto protocol = str_to_enum(argv[2]);
 			uint32_t scancode = strtol(argv[3], NULL, 16);
-			ir_tx(protocol, scancode, 10);
+			transmit(protocol, scancode, 10);
 			return 0;
 		} else if (strcmp(argv[1], "retransmit") == 0) {
 			retransmit();
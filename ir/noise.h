@@ -0,0 +1,102 @@
+/**
+ * COPYRIGHT 2024 Flirc, Inc. All rights reserved.
+ *
+ * This copyright notice is Copyright Management Information under 17 USC 1202
+ * and is included to protect this work and deter copyright infringement.
+ * Removal or alteration of this Copyright Management Information without
+ * the express written permission of Flirc, Inc. is prohibited, and any
+ * such unauthorized removal or alteration will be a violation of federal law.
+ */
+
+#ifndef I__NOISE_H__
+#define I__NOISE_H__
+
+#include <stdint.h>
+#include <string.h>
+
+#include <ir/ir.h>
+
+/**
+ * Distortion applied to clean frames to make them look received.
+ *
+ * A demodulating IR receiver stretches marks and shortens spaces by a
+ * roughly fixed amount, and every edge wanders a little on top. Now and
+ * then ambient light puts a short spurious mark in the middle of a space.
+ *
+ * @jitter:    random error on each edge, percent of its length
+ * @bias:      microseconds added to marks and taken off spaces
+ * @glitch:    percent of frames that get a spurious mark
+ */
+struct ir_noise {
+	unsigned int jitter;
+	unsigned int bias;
+	unsigned int glitch;
+};
+
+#define NOISE_GLITCH_US		(80)
+#define NOISE_EDGE_MIN_US	(10)
+#define NOISE_MAX_EDGES		(256)
+
+/**
+ * noise_rng() - splitmix64, the same sequence on every platform for a given
+ * seed so a noisy corpus can be regenerated exactly.
+ */
+static inline uint64_t noise_rng(uint64_t *s)
+{
+	uint64_t z = (*s += 0x9E3779B97F4A7C15ull);
+
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+
+	return z ^ (z >> 31);
+}
+
+/* uniform in [-1, 1] */
+static inline double noise_unit(uint64_t *s)
+{
+	return (double)(noise_rng(s) >> 11) / (double)(1ull << 52) - 1.0;
+}
+
+/**
+ * noise_apply() - Distorts a frame in place.
+ *
+ * @param *p    - frame, even entries are marks and odd ones spaces
+ * @param *rng  - random state, advanced
+ * @param *n    - how much to distort
+ */
+static inline void noise_apply(struct ir_packet *p, uint64_t *rng,
+		const struct ir_noise *n)
+{
+	int i;
+
+	for (i = 0; i < p->len; i++) {
+		double v = p->buf[i];
+
+		v += (i & 1) ? -(double)n->bias : (double)n->bias;
+		v += v * n->jitter / 100.0 * noise_unit(rng);
+
+		if (v < NOISE_EDGE_MIN_US)
+			v = NOISE_EDGE_MIN_US;
+		else if (v > UINT16_MAX)
+			v = UINT16_MAX;
+		p->buf[i] = (uint16_t)v;
+	}
+
+	/* split a space with a short spurious mark */
+	if (noise_rng(rng) % 100 < n->glitch && p->len >= 3 &&
+			p->len + 2 <= NOISE_MAX_EDGES) {
+		int s = 1 + 2 * (int)(noise_rng(rng) % (p->len / 2));
+		uint16_t space = p->buf[s];
+
+		if (space > 3 * NOISE_GLITCH_US) {
+			memmove(&p->buf[s + 2], &p->buf[s],
+					(p->len - s) * sizeof(p->buf[0]));
+			p->buf[s] = (space - NOISE_GLITCH_US) / 2;
+			p->buf[s + 1] = NOISE_GLITCH_US;
+			p->buf[s + 2] = space - NOISE_GLITCH_US - p->buf[s];
+			p->len += 2;
+		}
+	}
+}
+
+#endif /* I__NOISE_H__ */
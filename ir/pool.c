@@ -0,0 +1,168 @@
+/**
+ * COPYRIGHT 2024 Flirc, Inc. All rights reserved.
+ *
+ * This copyright notice is Copyright Management Information under 17 USC 1202
+ * and is included to protect this work and deter copyright infringement.
+ * Removal or alteration of this Copyright Management Information without
+ * the express written permission of Flirc, Inc. is prohibited, and any
+ * such unauthorized removal or alteration will be a violation of federal law.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "pool.h"
+
+#define POOL_CACHELINE		(64)
+
+/* end of the free list */
+#define POOL_NONE		(UINT32_MAX)
+
+/**
+ * struct pool_hdr - in front of every object
+ *
+ * @refs:   references held, 0 while free
+ * @next:   next free object, while free
+ * @index:  the object's place in the pool, so a pointer needn't be divided
+ *          back into one
+ *
+ * Padded to 16 bytes so the object after it is as aligned as malloc's.
+ */
+struct pool_hdr {
+	uint32_t refs;
+	uint32_t next;
+	uint32_t index;
+	uint32_t pad;
+};
+
+/**
+ * struct pool
+ *
+ * @head:   index of the first free object in the low 32 bits, and a count
+ *          of the changes to the list in the high 32, apart on its own
+ *          line as every thread writes it
+ */
+struct pool {
+	uint64_t head;
+	char _pad0[POOL_CACHELINE - sizeof(uint64_t)];
+	uint64_t empty;
+	unsigned char *mem;
+	unsigned char *slab;
+	size_t stride;
+	uint32_t count;
+};
+
+static inline struct pool_hdr *slot(const struct pool *p, uint32_t i)
+{
+	return (struct pool_hdr *)(p->slab + (size_t)i * p->stride);
+}
+
+static inline struct pool_hdr *hdr(void *obj)
+{
+	return (struct pool_hdr *)obj - 1;
+}
+
+struct pool *pool_new(size_t size, uint32_t count)
+{
+	struct pool *p;
+	uint32_t i;
+
+	if (count == 0 || count == POOL_NONE)
+		return NULL;
+
+	if ((p = calloc(1, sizeof(*p))) == NULL)
+		return NULL;
+
+	p->stride = (sizeof(struct pool_hdr) + size + POOL_CACHELINE - 1) &
+		~(size_t)(POOL_CACHELINE - 1);
+	p->count = count;
+
+	if ((p->mem = calloc(1, count * p->stride + POOL_CACHELINE)) == NULL) {
+		free(p);
+		return NULL;
+	}
+	p->slab = p->mem + (POOL_CACHELINE -
+			(uintptr_t)p->mem % POOL_CACHELINE) % POOL_CACHELINE;
+
+	for (i = 0; i < count; i++) {
+		slot(p, i)->index = i;
+		slot(p, i)->next = i + 1 < count ? i + 1 : POOL_NONE;
+	}
+	p->head = 0;
+
+	return p;
+}
+
+void pool_free(struct pool *p)
+{
+	if (!p)
+		return;
+
+	free(p->mem);
+	free(p);
+}
+
+void *pool_get(struct pool *p)
+{
+	uint64_t head, want;
+	uint32_t i, n;
+	struct pool_hdr *h;
+
+	head = __atomic_load_n(&p->head, __ATOMIC_ACQUIRE);
+	do {
+		if ((i = (uint32_t)head) == POOL_NONE) {
+			__atomic_add_fetch(&p->empty, 1, __ATOMIC_RELAXED);
+			return NULL;
+		}
+		/* may be stale if another thread took it first, the count
+		 * in head then fails the swap */
+		n = __atomic_load_n(&slot(p, i)->next, __ATOMIC_RELAXED);
+		want = ((head >> 32) + 1) << 32 | n;
+	} while (!__atomic_compare_exchange_n(&p->head, &head, want, 1,
+				__ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE));
+
+	h = slot(p, i);
+	__atomic_store_n(&h->refs, 1, __ATOMIC_RELAXED);
+
+	return h + 1;
+}
+
+void pool_ref(struct pool *p, void *obj)
+{
+	(void)p;
+	__atomic_add_fetch(&hdr(obj)->refs, 1, __ATOMIC_RELAXED);
+}
+
+void pool_put(struct pool *p, void *obj)
+{
+	struct pool_hdr *h = hdr(obj);
+	uint64_t head, want;
+
+	/* acquire and release, so every holder is done with the object
+	 * before the last one returns it */
+	if (__atomic_sub_fetch(&h->refs, 1, __ATOMIC_ACQ_REL))
+		return;
+
+	head = __atomic_load_n(&p->head, __ATOMIC_RELAXED);
+	do {
+		__atomic_store_n(&h->next, (uint32_t)head, __ATOMIC_RELAXED);
+		want = ((head >> 32) + 1) << 32 | h->index;
+	} while (!__atomic_compare_exchange_n(&p->head, &head, want, 1,
+				__ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
+
+void pool_stats(const struct pool *p, struct pool_stats *st)
+{
+	uint32_t i, free = 0;
+
+	/* counting as objects come and go would put two more atomics on
+	 * every get and put, the free list is walked instead */
+	for (i = (uint32_t)p->head; i != POOL_NONE && free < p->count;
+			i = slot(p, i)->next)
+		free++;
+
+	st->count = p->count;
+	st->in_use = p->count - free;
+	st->empty = __atomic_load_n(&p->empty, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,83 @@
+/**
+ * COPYRIGHT 2024 Flirc, Inc. All rights reserved.
+ *
+ * This copyright notice is Copyright Management Information under 17 USC 1202
+ * and is included to protect this work and deter copyright infringement.
+ * Removal or alteration of this Copyright Management Information without
+ * the express written permission of Flirc, Inc. is prohibited, and any
+ * such unauthorized removal or alteration will be a violation of federal law.
+ */
+
+#ifndef I__POOL_H__
+#define I__POOL_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Fixed size objects with a reference count, shared between threads.
+ *
+ * A struct ir_packet is 516 bytes. Handing one frame to a decoder, a
+ * recorder and whatever else wants it by copy costs 516 bytes a consumer.
+ * Taken from a pool, the frame is filled in once and each consumer gets a
+ * pointer and a reference, and the last pool_put() returns it.
+ *
+ * Every object sits in its own run of cache lines, so two consumers
+ * holding neighbouring frames never share a line. The free objects form a
+ * stack whose head carries a count of the changes made to it, so any
+ * thread can take or return an object with a single compare and swap and
+ * an object returned and taken again meanwhile can't be mistaken for the
+ * one read. Nothing is allocated after pool_new().
+ */
+
+struct pool;
+
+/**
+ * struct pool_stats
+ *
+ * @count:  objects in the pool
+ * @in_use: objects held, only exact while no thread is using the pool
+ * @empty:  pool_get() calls that found none free
+ */
+struct pool_stats {
+	uint32_t count;
+	uint32_t in_use;
+	uint64_t empty;
+};
+
+/**
+ * pool_new() - Allocates a pool.
+ *
+ * @param size  - bytes in each object
+ * @param count - objects in the pool
+ *
+ * @return      - the pool, NULL if out of memory
+ */
+struct pool *pool_new(size_t size, uint32_t count);
+
+/**
+ * pool_free() - Releases a pool, objects still held go with it.
+ */
+void pool_free(struct pool *p);
+
+/**
+ * pool_get() - Takes a free object, its contents are whatever the last
+ * holder left, with one reference.
+ *
+ * @return      - the object, NULL if all are held
+ */
+void *pool_get(struct pool *p);
+
+/**
+ * pool_ref() - Adds a reference to a held object, for another consumer.
+ */
+void pool_ref(struct pool *p, void *obj);
+
+/**
+ * pool_put() - Drops a reference, the last one returns the object.
+ */
+void pool_put(struct pool *p, void *obj);
+
+void pool_stats(const struct pool *p, struct pool_stats *st);
+
+#endif /* I__POOL_H__ */
@@ -0,0 +1,260 @@
+/**
+ * COPYRIGHT 2024 Flirc, Inc. All rights reserved.
+ *
+ * This copyright notice is Copyright Management Information under 17 USC 1202
+ * and is included to protect this work and deter copyright infringement.
+ * Removal or alteration of this Copyright Management Information without
+ * the express written permission of Flirc, Inc. is prohibited, and any
+ * such unauthorized removal or alteration will be a violation of federal law.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "quantize.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define QUANT_X86
+#include <immintrin.h>
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define QUANT_NEON
+#include <arm_neon.h>
+#endif
+
+int quant_init(struct quant_table *q, const uint16_t *nominal,
+		unsigned int count, unsigned int tol)
+{
+	unsigned int i;
+
+	if (count == 0 || count > QUANT_MAX_CLASSES)
+		return -1;
+
+	for (i = 0; i < count; i++) {
+		uint32_t d = (uint32_t)nominal[i] * tol / 100;
+		uint32_t hi = nominal[i] + d;
+
+		q->lo[i] = d > nominal[i] ? 0 : nominal[i] - d;
+		q->hi[i] = hi > UINT16_MAX ? UINT16_MAX : hi;
+	}
+	q->count = count;
+
+	return 0;
+}
+
+int quant_init_nearest(struct quant_table *q, const uint16_t *nominal,
+		unsigned int count)
+{
+	uint32_t mid, r, b;
+	unsigned int i;
+
+	if (count == 0 || count > QUANT_MAX_CLASSES)
+		return -1;
+
+	q->lo[0] = 0;
+	for (i = 0; i + 1 < count; i++) {
+		if (nominal[i] >= nominal[i + 1])
+			return -1;
+
+		/* floor of the geometric mean, the last edge nearer the
+		 * lower of the two */
+		mid = (uint32_t)nominal[i] * nominal[i + 1];
+		for (r = 0, b = 1u << 30; b; b >>= 2) {
+			if (mid >= r + b) {
+				mid -= r + b;
+				r = (r >> 1) + b;
+			} else {
+				r >>= 1;
+			}
+		}
+		q->hi[i] = r;
+		q->lo[i + 1] = r + 1;
+	}
+	q->hi[count - 1] = UINT16_MAX;
+	q->count = count;
+
+	return 0;
+}
+
+static void quant_scalar(const struct quant_table *q, const uint16_t *buf,
+		size_t n, uint8_t *sym)
+{
+	size_t i;
+	unsigned int c;
+
+	for (i = 0; i < n; i++) {
+		uint16_t v = buf[i];
+
+		sym[i] = QUANT_NONE;
+		for (c = 0; c < q->count; c++) {
+			if (v >= q->lo[c] && v <= q->hi[c]) {
+				sym[i] = c;
+				break;
+			}
+		}
+	}
+}
+
+/*
+ * The vector versions test every class against every lane and blend the
+ * class number in where it matches. Classes are applied last to first so
+ * the lowest matching class wins, as in the scalar loop. There's no
+ * unsigned 16 bit compare before AVX-512, v >= lo is max(v, lo) == v.
+ *
+ * Frames are short, a few dozen edges, so the remainder after the last
+ * whole vector is a large part of the work. It goes through the vector
+ * code too, copied into a zero padded block.
+ */
+#define QUANT_BLOCK_MAX		(16)
+
+#define QUANT_VECTOR_LOOP(block, width, q, buf, n, sym) do { \
+		uint16_t __tail[QUANT_BLOCK_MAX] = { 0 }; \
+		uint8_t __out[QUANT_BLOCK_MAX]; \
+		size_t __i = 0; \
+		for (; __i + (width) <= (n); __i += (width)) \
+			block(q, &(buf)[__i], &(sym)[__i]); \
+		if (__i < (n)) { \
+			memcpy(__tail, &(buf)[__i], \
+					((n) - __i) * sizeof(*(buf))); \
+			block(q, __tail, __out); \
+			memcpy(&(sym)[__i], __out, (n) - __i); \
+		} \
+	} while (0)
+
+#ifdef QUANT_X86
+__attribute__((target("sse4.1")))
+static inline void sse41_block(const struct quant_table *q,
+		const uint16_t *buf, uint8_t *sym)
+{
+	__m128i v = _mm_loadu_si128((const __m128i *)buf);
+	__m128i r = _mm_set1_epi16(QUANT_NONE);
+	int c;
+
+	for (c = q->count - 1; c >= 0; c--) {
+		__m128i lo = _mm_set1_epi16(q->lo[c]);
+		__m128i hi = _mm_set1_epi16(q->hi[c]);
+		__m128i m = _mm_and_si128(
+				_mm_cmpeq_epi16(_mm_max_epu16(v, lo), v),
+				_mm_cmpeq_epi16(_mm_min_epu16(v, hi), v));
+
+		r = _mm_blendv_epi8(r, _mm_set1_epi16(c), m);
+	}
+
+	_mm_storel_epi64((__m128i *)sym, _mm_packus_epi16(r, r));
+}
+
+__attribute__((target("sse4.1")))
+static void quant_sse41(const struct quant_table *q, const uint16_t *buf,
+		size_t n, uint8_t *sym)
+{
+	QUANT_VECTOR_LOOP(sse41_block, 8, q, buf, n, sym);
+}
+
+__attribute__((target("avx2")))
+static inline void avx2_block(const struct quant_table *q,
+		const uint16_t *buf, uint8_t *sym)
+{
+	__m256i v = _mm256_loadu_si256((const __m256i *)buf);
+	__m256i r = _mm256_set1_epi16(QUANT_NONE);
+	int c;
+
+	for (c = q->count - 1; c >= 0; c--) {
+		__m256i lo = _mm256_set1_epi16(q->lo[c]);
+		__m256i hi = _mm256_set1_epi16(q->hi[c]);
+		__m256i m = _mm256_and_si256(
+				_mm256_cmpeq_epi16(_mm256_max_epu16(v, lo), v),
+				_mm256_cmpeq_epi16(_mm256_min_epu16(v, hi), v));
+
+		r = _mm256_blendv_epi8(r, _mm256_set1_epi16(c), m);
+	}
+
+	/* packus works within each 128 bit lane, gather the two packed
+	 * halves into the low lane */
+	r = _mm256_permute4x64_epi64(_mm256_packus_epi16(r, r), 0x08);
+	_mm_storeu_si128((__m128i *)sym, _mm256_castsi256_si128(r));
+}
+
+__attribute__((target("avx2")))
+static void quant_avx2(const struct quant_table *q, const uint16_t *buf,
+		size_t n, uint8_t *sym)
+{
+	QUANT_VECTOR_LOOP(avx2_block, 16, q, buf, n, sym);
+}
+#endif /* QUANT_X86 */
+
+#ifdef QUANT_NEON
+static inline void neon_block(const struct quant_table *q,
+		const uint16_t *buf, uint8_t *sym)
+{
+	uint16x8_t v = vld1q_u16(buf);
+	uint16x8_t r = vdupq_n_u16(QUANT_NONE);
+	int c;
+
+	for (c = q->count - 1; c >= 0; c--) {
+		uint16x8_t m = vandq_u16(
+				vcgeq_u16(v, vdupq_n_u16(q->lo[c])),
+				vcleq_u16(v, vdupq_n_u16(q->hi[c])));
+
+		r = vbslq_u16(m, vdupq_n_u16(c), r);
+	}
+
+	vst1_u8(sym, vmovn_u16(r));
+}
+
+static void quant_neon(const struct quant_table *q, const uint16_t *buf,
+		size_t n, uint8_t *sym)
+{
+	QUANT_VECTOR_LOOP(neon_block, 8, q, buf, n, sym);
+}
+#endif /* QUANT_NEON */
+
+static struct quant_impl impls[4];
+static int nimpls;
+
+int quant_impls(const struct quant_impl **list)
+{
+	if (!nimpls) {
+		int n = 0;
+
+#ifdef QUANT_X86
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("avx2")) {
+			impls[n].name = "avx2";
+			impls[n++].fn = quant_avx2;
+		}
+		if (__builtin_cpu_supports("sse4.1")) {
+			impls[n].name = "sse4.1";
+			impls[n++].fn = quant_sse41;
+		}
+#endif
+#ifdef QUANT_NEON
+		impls[n].name = "neon";
+		impls[n++].fn = quant_neon;
+#endif
+		impls[n].name = "scalar";
+		impls[n++].fn = quant_scalar;
+
+		nimpls = n;
+	}
+
+	*list = impls;
+
+	return nimpls;
+}
+
+void quant_classify(const struct quant_table *q, const uint16_t *buf,
+		size_t n, uint8_t *sym)
+{
+	static quant_fn best;
+
+	if (!best) {
+		const struct quant_impl *list;
+
+		quant_impls(&list);
+		best = list[0].fn;
+	}
+
+	best(q, buf, n, sym);
+}
@@ -0,0 +1,104 @@
+/**
+ * COPYRIGHT 2024 Flirc, Inc. All rights reserved.
+ *
+ * This copyright notice is Copyright Management Information under 17 USC 1202
+ * and is included to protect this work and deter copyright infringement.
+ * Removal or alteration of this Copyright Management Information without
+ * the express written permission of Flirc, Inc. is prohibited, and any
+ * such unauthorized removal or alteration will be a violation of federal law.
+ */
+
+#ifndef I__QUANTIZE_H__
+#define I__QUANTIZE_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Edge classification, the first step of nearly every IR decoder.
+ *
+ * A protocol has a handful of nominal timings, NEC's 560 and 1690 us bits
+ * or RC5's 889 and 1778 us half bits, and each edge of a frame is matched
+ * against them with some tolerance, or simply to the nearest of them.
+ * quant_classify() does that for a whole frame in one pass and writes a
+ * symbol per edge, so the decoder proper only walks a small array of class
+ * numbers. candidate.c scores frames this way.
+ *
+ * The work is done eight or sixteen edges at a time with SSE4.1 or AVX2 on
+ * x86, picked at run time, and NEON on arm when the compiler targets it.
+ * Everything else gets the scalar loop, which all the others match exactly.
+ */
+
+#define QUANT_MAX_CLASSES	(8)
+
+/* symbol for an edge that matched no class */
+#define QUANT_NONE		(0xFF)
+
+/**
+ * struct quant_table - accepted range of each class
+ *
+ * @lo:     shortest edge in the class, us
+ * @hi:     longest edge in the class, us
+ * @count:  classes in use
+ */
+struct quant_table {
+	uint16_t lo[QUANT_MAX_CLASSES];
+	uint16_t hi[QUANT_MAX_CLASSES];
+	unsigned int count;
+};
+
+typedef void (*quant_fn)(const struct quant_table *q, const uint16_t *buf,
+		size_t n, uint8_t *sym);
+
+struct quant_impl {
+	const char *name;
+	quant_fn fn;
+};
+
+/**
+ * quant_init() - Builds a table from nominal timings.
+ *
+ * @param *q        - table to fill
+ * @param *nominal  - nominal length of each class, us
+ * @param count     - number of classes, at most QUANT_MAX_CLASSES
+ * @param tol       - tolerance, percent either side of nominal
+ *
+ * @return          - 0 on success, -1 if count is out of range
+ */
+int quant_init(struct quant_table *q, const uint16_t *nominal,
+		unsigned int count, unsigned int tol);
+
+/**
+ * quant_init_nearest() - Builds a table where every edge goes to the
+ * nominal timing nearest it by ratio, the classes meeting at the geometric
+ * mean of each pair, so no edge is QUANT_NONE.
+ *
+ * @param *nominal  - nominal length of each class, us, ascending
+ *
+ * @return          - 0 on success, -1 if count is out of range or the
+ *                    nominals aren't ascending
+ */
+int quant_init_nearest(struct quant_table *q, const uint16_t *nominal,
+		unsigned int count);
+
+/**
+ * quant_classify() - Maps each edge to the first class whose range holds
+ * it, or QUANT_NONE.
+ *
+ * @param *q    - classes
+ * @param *buf  - edges, us
+ * @param n     - number of edges
+ * @param *sym  - n symbols out
+ */
+void quant_classify(const struct quant_table *q, const uint16_t *buf,
+		size_t n, uint8_t *sym);
+
+/**
+ * quant_impls() - Implementations usable on this cpu, fastest first. The
+ * last is always the scalar one. For benchmarking and cross checking.
+ *
+ * @return      - number of entries in *list
+ */
+int quant_impls(const struct quant_impl **list);
+
+#endif /* I__QUANTIZE_H__ */
@@ -0,0 +1,261 @@
+/**
+ * COPYRIGHT 2024 Flirc, Inc. All rights reserved.
+ *
+ * This copyright notice is Copyright Management Information under 17 USC 1202
+ * and is included to protect this work and deter copyright infringement.
+ * Removal or alteration of this Copyright Management Information without
+ * the express written permission of Flirc, Inc. is prohibited, and any
+ * such unauthorized removal or alteration will be a violation of federal law.
+ */
+
+#ifndef I__RING_H__
+#define I__RING_H__
+
+#include <stdint.h>
+#include <stdlib.h>
+
+/**
+ * Single producer, single consumer lock-free ring of fixed size elements.
+ *
+ * The producer claims a slot, fills it in place and publishes it. The
+ * consumer peeks at the oldest slot, uses it in place and releases it. No
+ * copies are made and neither side ever blocks; a full ring is reported to
+ * the producer which decides what to drop.
+ *
+ * head is only written by the producer and tail only by the consumer. They
+ * live on separate cache lines so the two threads don't bounce a line back
+ * and forth on every frame.
+ */
+#define RING_CACHELINE		(64)
+
+struct spsc_ring {
+	uint32_t head;
+	char _pad0[RING_CACHELINE - sizeof(uint32_t)];
+	uint32_t tail;
+	char _pad1[RING_CACHELINE - sizeof(uint32_t)];
+	uint32_t mask;
+	size_t esize;
+	unsigned char *data;
+};
+
+/**
+ * spsc_ring_init() - Allocates a ring.
+ *
+ * @param *r     - ring to initialize
+ * @param count  - number of slots, must be a power of two
+ * @param esize  - size of each slot in bytes
+ *
+ * @return       - 0 on success, -1 on failure
+ */
+static inline int spsc_ring_init(struct spsc_ring *r, uint32_t count,
+		size_t esize)
+{
+	if (count == 0 || (count & (count - 1)))
+		return -1;
+
+	if ((r->data = calloc(count, esize)) == NULL)
+		return -1;
+
+	r->head = 0;
+	r->tail = 0;
+	r->mask = count - 1;
+	r->esize = esize;
+
+	return 0;
+}
+
+static inline void spsc_ring_free(struct spsc_ring *r)
+{
+	free(r->data);
+	r->data = NULL;
+}
+
+/**
+ * spsc_ring_claim() - Producer, returns the next free slot or NULL if full.
+ */
+static inline void *spsc_ring_claim(struct spsc_ring *r)
+{
+	uint32_t head = r->head;
+	uint32_t tail = __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE);
+
+	if (head - tail > r->mask)
+		return NULL;
+
+	return &r->data[(head & r->mask) * r->esize];
+}
+
+/**
+ * spsc_ring_publish() - Producer, hands the claimed slot to the consumer.
+ */
+static inline void spsc_ring_publish(struct spsc_ring *r)
+{
+	__atomic_store_n(&r->head, r->head + 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * spsc_ring_peek() - Consumer, returns the oldest slot or NULL if empty.
+ */
+static inline void *spsc_ring_peek(struct spsc_ring *r)
+{
+	uint32_t tail = r->tail;
+	uint32_t head = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+
+	if (head == tail)
+		return NULL;
+
+	return &r->data[(tail & r->mask) * r->esize];
+}
+
+/**
+ * spsc_ring_release() - Consumer, returns the peeked slot to the producer.
+ */
+static inline void spsc_ring_release(struct spsc_ring *r)
+{
+	__atomic_store_n(&r->tail, r->tail + 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * Single producer, single consumer lock-free ring of variable size records.
+ *
+ * As struct spsc_ring, but each record takes only the bytes asked for in
+ * spsc_vring_claim(), plus a small header, so a queue of frames holds the
+ * edges they have rather than the most they could. A record never wraps:
+ * one that doesn't fit before the end of the buffer leaves a marker and
+ * starts again at the front.
+ *
+ * head and tail count bytes, frames counts records published and done
+ * records consumed, so either side can tell how many are queued.
+ */
+#define VRING_ALIGN		(8)
+#define VRING_WRAP		(UINT32_MAX)
+
+/* bytes a record of n takes, header included */
+#define VRING_REC(n)		((sizeof(uint64_t) + (n) + VRING_ALIGN - 1) & \
+		~(uint32_t)(VRING_ALIGN - 1))
+
+struct spsc_vring {
+	uint32_t head;
+	uint32_t frames;
+	uint32_t next;
+	char _pad0[RING_CACHELINE - 3 * sizeof(uint32_t)];
+	uint32_t tail;
+	uint32_t done;
+	uint32_t rd;
+	char _pad1[RING_CACHELINE - 3 * sizeof(uint32_t)];
+	uint32_t mask;
+	unsigned char *data;
+};
+
+/**
+ * spsc_vring_init() - Allocates a ring.
+ *
+ * @param *r     - ring to initialize
+ * @param bytes  - size of the buffer, a power of two of at least
+ *                 VRING_ALIGN, the largest record must fit in it. malloc
+ *                 aligns at least as well as VRING_ALIGN
+ *
+ * @return       - 0 on success, -1 on failure
+ */
+static inline int spsc_vring_init(struct spsc_vring *r, uint32_t bytes)
+{
+	if (bytes < VRING_ALIGN || (bytes & (bytes - 1)))
+		return -1;
+
+	if ((r->data = malloc(bytes)) == NULL)
+		return -1;
+
+	r->head = r->frames = r->next = 0;
+	r->tail = r->done = r->rd = 0;
+	r->mask = bytes - 1;
+
+	return 0;
+}
+
+static inline void spsc_vring_free(struct spsc_vring *r)
+{
+	free(r->data);
+	r->data = NULL;
+}
+
+/**
+ * spsc_vring_claim() - Producer, returns room for a record of size bytes,
+ * aligned to VRING_ALIGN, or NULL if full.
+ */
+static inline void *spsc_vring_claim(struct spsc_vring *r, uint32_t size)
+{
+	uint32_t head = r->head;
+	uint32_t tail = __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE);
+	uint32_t need = VRING_REC(size);
+	uint32_t end = r->mask + 1 - (head & r->mask);
+	uint32_t skip = need > end ? end : 0;
+	uint32_t *hdr;
+
+	if (head + skip + need - tail > r->mask + 1)
+		return NULL;
+
+	/* records are aligned, so there's always room for the marker */
+	if (skip)
+		*(uint32_t *)&r->data[head & r->mask] = VRING_WRAP;
+
+	hdr = (uint32_t *)&r->data[(head + skip) & r->mask];
+	*hdr = size;
+	r->next = head + skip + need;
+
+	return (unsigned char *)hdr + sizeof(uint64_t);
+}
+
+/**
+ * spsc_vring_publish() - Producer, hands the claimed record to the consumer.
+ */
+static inline void spsc_vring_publish(struct spsc_vring *r)
+{
+	__atomic_store_n(&r->frames, r->frames + 1, __ATOMIC_RELAXED);
+	__atomic_store_n(&r->head, r->next, __ATOMIC_RELEASE);
+}
+
+/**
+ * spsc_vring_peek() - Consumer, returns the oldest record and its size, or
+ * NULL if empty.
+ */
+static inline void *spsc_vring_peek(struct spsc_vring *r, uint32_t *size)
+{
+	uint32_t tail = r->tail;
+	uint32_t head = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+	uint32_t *hdr;
+
+	if (head == tail)
+		return NULL;
+
+	hdr = (uint32_t *)&r->data[tail & r->mask];
+	if (*hdr == VRING_WRAP) {
+		tail += r->mask + 1 - (tail & r->mask);
+		hdr = (uint32_t *)r->data;
+	}
+
+	r->rd = tail + VRING_REC(*hdr);
+	if (size)
+		*size = *hdr;
+
+	return (unsigned char *)hdr + sizeof(uint64_t);
+}
+
+/**
+ * spsc_vring_release() - Consumer, returns the peeked record to the
+ * producer.
+ */
+static inline void spsc_vring_release(struct spsc_vring *r)
+{
+	__atomic_store_n(&r->done, r->done + 1, __ATOMIC_RELAXED);
+	__atomic_store_n(&r->tail, r->rd, __ATOMIC_RELEASE);
+}
+
+/**
+ * spsc_vring_count() - Records queued, from either side.
+ */
+static inline uint32_t spsc_vring_count(const struct spsc_vring *r)
+{
+	return __atomic_load_n(&r->frames, __ATOMIC_ACQUIRE) -
+		__atomic_load_n(&r->done, __ATOMIC_ACQUIRE);
+}
+
+#endif /* I__RING_H__ */
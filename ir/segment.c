@@ -0,0 +1,139 @@
+/**
+ * COPYRIGHT 2024 Flirc, Inc. All rights reserved.
+ *
+ * This copyright notice is Copyright Management Information under 17 USC 1202
+ * and is included to protect this work and deter copyright infringement.
+ * Removal or alteration of this Copyright Management Information without
+ * the express written permission of Flirc, Inc. is prohibited, and any
+ * such unauthorized removal or alteration will be a violation of federal law.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include <ir/ir.h>
+
+#include "segment.h"
+
+static int add(const uint16_t *buf, int start, int end, uint32_t gap,
+		struct segment *seg, int n, int max)
+{
+	uint32_t total = 0;
+	int i;
+
+	if (n >= max || end - start < SEGMENT_MIN_EDGES)
+		return n;
+
+	for (i = start; i < end; i++)
+		total += buf[i];
+	if (total < SEGMENT_MIN_US)
+		return n;
+
+	seg[n].off = start;
+	seg[n].len = end - start;
+	seg[n].gap = gap > UINT16_MAX ? UINT16_MAX : gap;
+
+	return n + 1;
+}
+
+/**
+ * Whether b is the second half of a Sharp or Denon frame whose first is a.
+ * Bits are in the spaces, a long one is a 1, told apart from a short one
+ * by the midpoint of the shortest and longest in both halves.
+ */
+static int complement(const uint16_t *buf, const struct segment *a,
+		const struct segment *b)
+{
+	const uint16_t *x = &buf[a->off], *y = &buf[b->off];
+	uint16_t lo = UINT16_MAX, hi = 0, mid;
+	int k;
+
+	if (b->gap < SEGMENT_PAIR_GAP_MIN || b->gap > SEGMENT_PAIR_GAP_MAX ||
+			a->len != 2 * SEGMENT_PAIR_BITS + 1 ||
+			b->len < 2 * SEGMENT_PAIR_BITS + 1 ||
+			b->len > 2 * SEGMENT_PAIR_BITS + 2)
+		return 0;
+
+	for (k = 0; k < SEGMENT_PAIR_BITS; k++) {
+		lo = x[2 * k + 1] < lo ? x[2 * k + 1] : lo;
+		lo = y[2 * k + 1] < lo ? y[2 * k + 1] : lo;
+		hi = x[2 * k + 1] > hi ? x[2 * k + 1] : hi;
+		hi = y[2 * k + 1] > hi ? y[2 * k + 1] : hi;
+	}
+
+	/* the inverted bits can't all be the same length */
+	if (hi < lo + lo / 2)
+		return 0;
+	mid = lo + (hi - lo) / 2;
+
+	for (k = 0; k < SEGMENT_PAIR_BITS; k++) {
+		int bx = x[2 * k + 1] > mid, by = y[2 * k + 1] > mid;
+
+		if ((k < SEGMENT_PAIR_ADDR) != (bx == by))
+			return 0;
+	}
+
+	return 1;
+}
+
+int segment_split(const uint16_t *buf, uint16_t len, struct segment *seg,
+		int max)
+{
+	uint32_t gap, before = 0;
+	int start = 0, i, j, n = 0;
+
+	if (max < 1)
+		return 0;
+
+	/* spaces are the odd edges */
+	for (i = 1; i < len; i += 2) {
+		/* a space with stray light in it is taken whole */
+		gap = buf[i];
+		for (j = i; j + 2 < len && buf[j + 1] < SEGMENT_GLITCH_US;
+				j += 2)
+			gap += buf[j + 1] + buf[j + 2];
+		if (gap < SEGMENT_GAP_US)
+			continue;
+
+		n = add(buf, start, i, before, seg, n, max);
+		before = gap;
+		start = j + 1;
+		i = j;
+	}
+
+	/* the last frame keeps a short trailing space, libir reads an RC5
+	 * frame differently without its last half bit. a trailing gap is
+	 * dropped, libir rejects a frame that ends with one */
+	n = add(buf, start, len, before, seg, n, max);
+
+	for (i = 0; i + 1 < n; i++) {
+		if (!complement(buf, &seg[i], &seg[i + 1]))
+			continue;
+		memmove(&seg[i + 1], &seg[i + 2],
+				(n - i - 2) * sizeof(seg[0]));
+		n--;
+	}
+
+	/* nothing frame like, hand it back as it came */
+	if (n == 0) {
+		seg[0].off = 0;
+		seg[0].len = len;
+		seg[0].gap = 0;
+		n = 1;
+	}
+
+	return n;
+}
+
+struct ir_packet *segment_packet(struct ir_packet *p,
+		const struct segment *s, struct ir_packet *sub)
+{
+	if (s->off == 0 && s->len == p->len)
+		return p;
+
+	memcpy(sub->buf, &p->buf[s->off], s->len * sizeof(sub->buf[0]));
+	sub->len = s->len;
+	sub->elapsed = s->off ? (s->gap + 500) / 1000 : p->elapsed;
+
+	return sub;
+}
@@ -0,0 +1,107 @@
+/**
+ * COPYRIGHT 2024 Flirc, Inc. All rights reserved.
+ *
+ * This copyright notice is Copyright Management Information under 17 USC 1202
+ * and is included to protect this work and deter copyright infringement.
+ * Removal or alteration of this Copyright Management Information without
+ * the express written permission of Flirc, Inc. is prohibited, and any
+ * such unauthorized removal or alteration will be a violation of federal law.
+ */
+
+#ifndef I__SEGMENT_H__
+#define I__SEGMENT_H__
+
+#include <stdint.h>
+
+#include <ir/ir.h>
+
+/**
+ * Splits a packet holding several frames back to back into the frames.
+ *
+ * Under heavy use a repeat, or a second remote, can land in the same
+ * struct ir_packet as the frame before it, and ir_decode_packet() only
+ * ever sees the first. The frames are separated by the protocol's gap
+ * between frames, far longer than any space inside one: the longest
+ * inside a frame is the 4.5 ms NEC header space, the shortest gap libir
+ * puts between two frames it sends is Sony's 12 ms. A space of
+ * SEGMENT_GAP_US or more ends a frame.
+ *
+ * A gap is where a receiver picks up stray light, so a mark shorter than
+ * SEGMENT_GLITCH_US is taken as part of the space it sits in, and a gap
+ * cut in two by one is still a gap. A run of edges between gaps too short
+ * to be a frame, fewer than SEGMENT_MIN_EDGES or shorter than
+ * SEGMENT_MIN_US in all, is noise and dropped.
+ *
+ * Sharp and Denon send each press as two halves about 40 ms apart, the
+ * second with the command and check bits inverted. libir decodes the first
+ * half on its own but not the two together, and the second on its own as
+ * a different button, so a half that is the complement of the one before
+ * it is dropped and the press comes out once.
+ *
+ * A packet with one frame in it, nearly every one, costs a pass comparing
+ * its spaces against SEGMENT_GAP_US.
+ */
+
+/* spaces at least this long are between frames, us */
+#define SEGMENT_GAP_US		(8000)
+
+/* marks shorter than this are stray light, us */
+#define SEGMENT_GLITCH_US	(100)
+
+/* the shortest frame kept, a NEC repeat is 3 edges and 11.8 ms */
+#define SEGMENT_MIN_EDGES	(3)
+#define SEGMENT_MIN_US		(1000)
+
+/* a Sharp or Denon half: address bits, then command, expansion and check
+ * bits inverted in the second, and the range of gaps between the halves */
+#define SEGMENT_PAIR_BITS	(15)
+#define SEGMENT_PAIR_ADDR	(5)
+#define SEGMENT_PAIR_GAP_MIN	(30000)
+#define SEGMENT_PAIR_GAP_MAX	(60000)
+
+/* most frames a packet can hold, each is at least 3 edges and a gap */
+#define SEGMENT_MAX		(64)
+
+/**
+ * struct segment - one frame within a packet
+ *
+ * @off:    first edge, a mark
+ * @len:    edges, ending on a mark, but for the last frame which runs to
+ *          the end of the packet
+ * @gap:    us of space before it, 0 if it starts the packet
+ */
+struct segment {
+	uint16_t off;
+	uint16_t len;
+	uint16_t gap;
+};
+
+/**
+ * segment_split() - Finds the frames in a packet.
+ *
+ * @param *buf  - edges, us, mark first
+ * @param len   - number of edges
+ * @param *seg  - room for max frames
+ * @param max   - most frames wanted, frames past it are left out
+ *
+ * @return      - frames found, at least 1. a packet with nothing that
+ *                looks like a frame comes back whole as one, so it can
+ *                still be decoded or reported
+ */
+int segment_split(const uint16_t *buf, uint16_t len, struct segment *seg,
+		int max);
+
+/**
+ * segment_packet() - The packet to decode for one frame.
+ *
+ * @param *p    - the packet split
+ * @param *s    - one of its frames
+ * @param *sub  - room to copy the frame into
+ *
+ * @return      - p itself if the frame is the whole packet, else sub,
+ *                with elapsed the gap before the frame in ms
+ */
+struct ir_packet *segment_packet(struct ir_packet *p,
+		const struct segment *s, struct ir_packet *sub);
+
+#endif /* I__SEGMENT_H__ */
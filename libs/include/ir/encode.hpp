@@ -0,0 +1,311 @@
+/**
+ * COPYRIGHT 2024 Flirc, Inc. All rights reserved.
+ *
+ * This copyright notice is Copyright Management Information under 17 USC 1202
+ * and is included to protect this work and deter copyright infringement.
+ * Removal or alteration of this Copyright Management Information without
+ * the express written permission of Flirc, Inc. is prohibited, and any
+ * such unauthorized removal or alteration will be a violation of federal law.
+ */
+
+#ifndef I__IR_ENCODE_HPP__
+#define I__IR_ENCODE_HPP__
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include <ir/ir.h>
+
+/**
+ * Header only, C++17, compile time version of ir_encode().
+ *
+ * For firmware that only ever sends a fixed set of buttons, the timing
+ * buffers can be worked out by the compiler and end up in .rodata, so
+ * neither libir nor any encoding at send time is needed:
+ *
+ *     static constexpr auto power = ir::code<RC_PROTO_NEC, 0x04FB>();
+ *
+ *     fl_transmit_raw(const_cast<uint16_t *>(power.buf.data()),
+ *                     power.buf.size(), power.elapsed, 0);
+ *
+ * Buffers are laid out as libir's: microseconds, alternating mark and
+ * space, starting on a mark. The scancode means what it does to
+ * ir_encode() and the result is the same, edge for edge, along with the
+ * same ir_packet.elapsed:
+ *
+ *     NEC, NECX, NEC32  all 32 bits of the scancode, lsb first
+ *     SONY12/15/20      the top 12, 15 or 20 bits, lsb first
+ *     RC5               address in bits 8-12, command in bits 0-5
+ *     RC6_0             address in bits 8-15, command in bits 0-7
+ *
+ * RC5 and RC6 carry a toggle bit that a remote flips on each new press.
+ * ir_encode() flips it on every call, here it's a parameter. For RC5, bit 13
+ * of the scancode also sets it, as it does in libir.
+ *
+ * libir can't encode JVC or Samsung. Those follow the published timings,
+ * with the scancode sent lsb first as for NEC, 16 bits for JVC and 32 for
+ * Samsung. Samsung has no rc_proto of its own, so it has its own entry
+ * points, ir::encode_samsung32() and ir::samsung32_code(), rather than a
+ * value made up in libir's enum. Neither is checked edge for edge against
+ * libir the way the others are by ir/bench/encode_check.cpp: a Samsung
+ * frame is only checked to decode as NEC with the same scancode, and JVC
+ * isn't checked at all.
+ *
+ * ir::encode() also works at run time, returning a zero length waveform
+ * for a protocol it doesn't cover.
+ */
+
+namespace ir {
+
+/* longest buffer produced, NEC's 67 edges */
+constexpr std::size_t ENCODE_MAX_EDGES = 68;
+
+/**
+ * struct waveform - an encoded frame
+ *
+ * @buf:        timings, us, mark first
+ * @len:        edges used in buf
+ * @elapsed:    ir_packet.elapsed as ir_encode() sets it, the ik to hand
+ *              to fl_transmit_raw()
+ */
+struct waveform {
+	uint16_t buf[ENCODE_MAX_EDGES];
+	uint16_t len;
+	uint16_t elapsed;
+};
+
+namespace detail {
+
+/* appends edges, merging a run of marks or of spaces into one, so the
+ * halves of a manchester coded bit can be pushed one at a time */
+struct builder {
+	waveform w{};
+
+	constexpr void edge(bool mark, uint16_t us)
+	{
+		/* a frame starts on a mark, a leading space isn't sent */
+		if (w.len == 0 && !mark)
+			return;
+
+		/* odd entries are spaces */
+		if (w.len && ((w.len - 1) % 2 == 0) == mark)
+			w.buf[w.len - 1] += us;
+		else
+			w.buf[w.len++] = us;
+	}
+
+	constexpr void mark(uint16_t us) { edge(true, us); }
+	constexpr void space(uint16_t us) { edge(false, us); }
+
+	/* a trailing space is kept. A frame whose last manchester bit ends
+	 * on its space half, an RC5 0 or an RC6 1, ends on a space, as
+	 * libir's does */
+	constexpr waveform done(uint16_t elapsed)
+	{
+		w.elapsed = elapsed;
+		return w;
+	}
+};
+
+/**
+ * struct pulse_distance - a header, then a mark per bit and a space whose
+ * length is the bit, then a stop mark
+ */
+struct pulse_distance {
+	uint16_t hdr_mark, hdr_space;
+	uint16_t bit_mark, zero_space, one_space;
+	unsigned int bits;
+	uint16_t elapsed;
+};
+
+constexpr waveform encode_pulse_distance(const pulse_distance &p,
+		uint32_t scancode)
+{
+	builder b;
+
+	b.mark(p.hdr_mark);
+	b.space(p.hdr_space);
+	for (unsigned int i = 0; i < p.bits; i++) {
+		b.mark(p.bit_mark);
+		b.space((scancode >> i) & 1 ? p.one_space : p.zero_space);
+	}
+	b.mark(p.bit_mark);
+
+	return b.done(p.elapsed);
+}
+
+/* Sony is pulse width, the mark is the bit and the frame ends on it */
+constexpr waveform encode_sony(uint32_t scancode, unsigned int bits)
+{
+	builder b;
+	uint32_t v = scancode >> (32 - bits);
+
+	b.mark(2400);
+	for (unsigned int i = 0; i < bits; i++) {
+		b.space(600);
+		b.mark((v >> i) & 1 ? 1200 : 600);
+	}
+
+	return b.done(12);
+}
+
+/* RC5 is a space then a mark for a 1, msb first */
+constexpr void rc5_bits(builder &b, uint32_t v, unsigned int bits)
+{
+	while (bits--) {
+		bool one = (v >> bits) & 1;
+
+		b.edge(!one, 889);
+		b.edge(one, 889);
+	}
+}
+
+constexpr waveform encode_rc5(uint32_t scancode, bool toggle)
+{
+	builder b;
+
+	rc5_bits(b, 0x3, 2);
+	rc5_bits(b, toggle || (scancode & 0x2000), 1);
+	rc5_bits(b, (scancode >> 8) & 0x1F, 5);
+	rc5_bits(b, scancode & 0x3F, 6);
+
+	return b.done(28);
+}
+
+/* RC6 is the other way round, a mark then a space for a 1 */
+constexpr void rc6_bits(builder &b, uint32_t v, unsigned int bits,
+		uint16_t unit)
+{
+	while (bits--) {
+		bool one = (v >> bits) & 1;
+
+		b.edge(one, unit);
+		b.edge(!one, unit);
+	}
+}
+
+constexpr waveform encode_rc6_0(uint32_t scancode, bool toggle)
+{
+	builder b;
+
+	b.mark(2664);
+	b.space(888);
+	rc6_bits(b, 0x1, 1, 444);		/* start */
+	rc6_bits(b, 0x0, 3, 444);		/* mode 0 */
+	rc6_bits(b, toggle, 1, 888);		/* trailer, twice as long */
+	rc6_bits(b, scancode & 0xFFFF, 16, 444);
+
+	return b.done(27);
+}
+
+constexpr pulse_distance nec_timing = { 9000, 4500, 560, 560, 1690, 32, 40 };
+constexpr pulse_distance jvc_timing = { 8400, 4200, 526, 526, 1574, 16, 20 };
+constexpr pulse_distance samsung_timing =
+	{ 4500, 4500, 560, 560, 1690, 32, 40 };
+
+} /* namespace detail */
+
+/**
+ * encode() - Encodes a scancode, as ir_encode() does.
+ *
+ * @param proto     - protocol
+ * @param scancode  - scancode
+ * @param toggle    - RC5 and RC6 toggle bit, ignored by the others
+ *
+ * @return          - the frame, len is 0 if the protocol isn't covered
+ */
+constexpr waveform encode(enum rc_proto proto, uint32_t scancode,
+		bool toggle = false)
+{
+	switch (proto) {
+	case RC_PROTO_NEC:
+	case RC_PROTO_NECX:
+	case RC_PROTO_NEC32:
+		return detail::encode_pulse_distance(detail::nec_timing,
+				scancode);
+	case RC_PROTO_JVC:
+		return detail::encode_pulse_distance(detail::jvc_timing,
+				scancode);
+	case RC_PROTO_SONY12:
+		return detail::encode_sony(scancode, 12);
+	case RC_PROTO_SONY15:
+		return detail::encode_sony(scancode, 15);
+	case RC_PROTO_SONY20:
+		return detail::encode_sony(scancode, 20);
+	case RC_PROTO_RC5:
+		return detail::encode_rc5(scancode, toggle);
+	case RC_PROTO_RC6_0:
+		return detail::encode_rc6_0(scancode, toggle);
+	default:
+		return waveform{};
+	}
+}
+
+/**
+ * encode_samsung32() - Encodes a Samsung 32 bit scancode, which encode()
+ * can't take as libir has no rc_proto for it.
+ *
+ * @return          - the frame
+ */
+constexpr waveform encode_samsung32(uint32_t scancode)
+{
+	return detail::encode_pulse_distance(detail::samsung_timing, scancode);
+}
+
+/**
+ * struct table - an encoded frame trimmed to its length, for .rodata
+ */
+template <std::size_t N>
+struct table {
+	std::array<uint16_t, N> buf;
+	uint16_t elapsed;
+};
+
+namespace detail {
+
+template <std::size_t N>
+constexpr table<N> trim(const waveform &w)
+{
+	table<N> t{};
+
+	for (std::size_t i = 0; i < N; i++)
+		t.buf[i] = w.buf[i];
+	t.elapsed = w.elapsed;
+
+	return t;
+}
+
+} /* namespace detail */
+
+/**
+ * code() - Encodes a button at compile time.
+ *
+ * Fails to compile for a protocol that isn't covered.
+ *
+ * @return      - the frame, exactly as long as it needs to be
+ */
+template <enum rc_proto P, uint32_t Scancode, bool Toggle = false>
+constexpr auto code()
+{
+	constexpr waveform w = encode(P, Scancode, Toggle);
+
+	static_assert(w.len != 0, "protocol not supported by ir::encode()");
+
+	return detail::trim<w.len>(w);
+}
+
+/**
+ * samsung32_code() - code() for a Samsung 32 bit button.
+ */
+template <uint32_t Scancode>
+constexpr auto samsung32_code()
+{
+	constexpr waveform w = encode_samsung32(Scancode);
+
+	return detail::trim<w.len>(w);
+}
+
+} /* namespace ir */
+
+#endif /* I__IR_ENCODE_HPP__ */